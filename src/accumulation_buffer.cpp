@@ -0,0 +1,156 @@
+#include "accumulation_buffer.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include "binary_file.h"
+
+namespace {
+	// File layout, in the host's byte order, which binary_file.h requires to be little-endian: magic, version, width,
+	// height, flags, seed count, seeds, then the per-pixel sums (3 floats each), sums of squared luminance (1 float each,
+	// only with the variance flag) and counts (1 uint32 each), each in row-major order. Version 1 had no flags and always
+	// the sums of squares.
+	const char magic[4] = { 'R', 'T', 'A', 'B' };
+	const uint32_t version = 2;
+	const uint32_t varianceFlag = 1;
+}
+
+void AccumulationBuffer::allocate(int width, int height, const AccumulationLayout& layout) {
+	m_width = width;
+	m_height = height;
+	m_layout = layout;
+	m_layout.blockSize = glm::max(1, layout.blockSize);
+	const int blockSize = m_layout.blockSize;
+	// in [0, blockSize), also for origins left of or above the image
+	m_blockShift = glm::ivec2((-layout.blockOrigin.x % blockSize + blockSize) % blockSize, (-layout.blockOrigin.y % blockSize + blockSize) % blockSize);
+	m_blocksPerRow = (width + m_blockShift.x + blockSize - 1) / blockSize;
+	const int blockRows = (height + m_blockShift.y + blockSize - 1) / blockSize;
+	// a multiple of 16 pixels is a whole number of cache lines for 4-byte channels (64 bytes) and for sums (192 bytes)
+	m_blockStride = (blockSize * blockSize + 15) / 16 * 16;
+
+	const size_t size = width > 0 && height > 0 ? static_cast<size_t>(m_blocksPerRow) * blockRows * m_blockStride : 0;
+	m_sum.assign(size, glm::vec3(0.f));
+	m_luminanceSquares.assign(m_layout.variance ? size : 0, 0.f);
+	m_count.assign(size, 0);
+}
+
+AccumulationBuffer::AccumulationBuffer(const std::string& file, const AccumulationLayout& layout) {
+	allocate(0, 0, layout);
+	std::FILE* f = std::fopen(file.c_str(), "rb");
+	if (f == nullptr) return;
+
+	char fileMagic[4];
+	uint32_t fileVersion = 0, flags = varianceFlag, seedCount = 0;
+	int32_t size[2] = { 0, 0 };
+	bool ok = readValues(f, fileMagic, 4) && std::memcmp(fileMagic, magic, 4) == 0
+		&& readValues(f, &fileVersion, 1) && (fileVersion == 1 || fileVersion == version)
+		&& readValues(f, size, 2) && size[0] >= 0 && size[1] >= 0
+		&& (fileVersion == 1 || readValues(f, &flags, 1))
+		&& readValues(f, &seedCount, 1);
+	std::vector<glm::vec3> sums;
+	std::vector<float> squares;
+	std::vector<uint32_t> counts;
+	if (ok) {
+		const size_t pixels = static_cast<size_t>(size[0]) * static_cast<size_t>(size[1]);
+		m_seeds.resize(seedCount);
+		sums.resize(pixels);
+		squares.resize((flags & varianceFlag) != 0 ? pixels : 0);
+		counts.resize(pixels);
+		ok = readValues(f, m_seeds.data(), seedCount)
+			&& readValues(f, sums.data(), pixels)
+			&& readValues(f, squares.data(), squares.size())
+			&& readValues(f, counts.data(), pixels);
+	}
+	std::fclose(f);
+
+	if (!ok) {
+		std::clog << "Not a valid accumulation buffer: " << file << '\n';
+		m_seeds.clear();
+		return;
+	}
+
+	// from row-major order into blocks; without sums of squares in the file there can be no variance
+	AccumulationLayout fileLayout = layout;
+	fileLayout.variance = layout.variance && !squares.empty();
+	allocate(size[0], size[1], fileLayout);
+	for (int y = 0, row = 0; y < m_height; ++y, row += m_width) {
+		for (int x = 0; x < m_width; ++x) {
+			const int i = idx(x, y);
+			m_sum[i] = sums[row + x];
+			if (m_layout.variance) m_luminanceSquares[i] = squares[row + x];
+			m_count[i] = counts[row + x];
+		}
+	}
+}
+
+bool AccumulationBuffer::merge(const AccumulationBuffer& other) {
+	if (other.m_width != m_width || other.m_height != m_height) {
+		std::clog << "Can't merge accumulation buffers of different sizes\n";
+		return false;
+	}
+	for (uint32_t seed : other.m_seeds) {
+		if (std::find(m_seeds.begin(), m_seeds.end(), seed) != m_seeds.end()) {
+			std::clog << "Can't merge accumulation buffers rendered with the same seed (" << seed << ")\n";
+			return false;
+		}
+	}
+
+	if (!other.m_layout.variance) {
+		m_layout.variance = false;
+		m_luminanceSquares.clear();
+	}
+	for (int y = 0; y < m_height; ++y) {
+		for (int x = 0; x < m_width; ++x) {
+			const int i = idx(x, y), j = other.idx(x, y);
+			m_sum[i] += other.m_sum[j];
+			if (m_layout.variance) m_luminanceSquares[i] += other.m_luminanceSquares[j];
+			m_count[i] += other.m_count[j];
+		}
+	}
+	m_seeds.insert(m_seeds.end(), other.m_seeds.begin(), other.m_seeds.end());
+	return true;
+}
+
+bool AccumulationBuffer::write(const std::string& file) const {
+	// gather the blocks into row-major order
+	const size_t pixels = static_cast<size_t>(m_width) * static_cast<size_t>(m_height);
+	std::vector<glm::vec3> sums(pixels);
+	std::vector<float> squares(m_layout.variance ? pixels : 0);
+	std::vector<uint32_t> counts(pixels);
+	for (int y = 0, row = 0; y < m_height; ++y, row += m_width) {
+		for (int x = 0; x < m_width; ++x) {
+			const int i = idx(x, y);
+			sums[row + x] = m_sum[i];
+			if (m_layout.variance) squares[row + x] = m_luminanceSquares[i];
+			counts[row + x] = m_count[i];
+		}
+	}
+
+	const std::string temporary = file + ".tmp";
+	std::FILE* f = std::fopen(temporary.c_str(), "wb");
+	if (f == nullptr) return false;
+
+	const int32_t size[2] = { m_width, m_height };
+	const uint32_t flags = m_layout.variance ? varianceFlag : 0;
+	const uint32_t seedCount = static_cast<uint32_t>(m_seeds.size());
+	bool ok = writeValues(f, magic, 4)
+		&& writeValues(f, &version, 1)
+		&& writeValues(f, size, 2)
+		&& writeValues(f, &flags, 1)
+		&& writeValues(f, &seedCount, 1)
+		&& writeValues(f, m_seeds.data(), seedCount)
+		&& writeValues(f, sums.data(), pixels)
+		&& writeValues(f, squares.data(), squares.size())
+		&& writeValues(f, counts.data(), pixels);
+	ok = std::fclose(f) == 0 && ok;
+	if (!ok) {
+		std::remove(temporary.c_str());
+		return false;
+	}
+
+	// the previous checkpoint stays until the new one is complete
+	if (replaceFile(temporary, file)) return true;
+	std::remove(temporary.c_str());
+	return false;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "aligned.h"
+#include "common.h"
+#include "image.h"
+#include "tiles.h"
+
+// Memory layout of an AccumulationBuffer. Pixels are stored in square blocks, each contiguous and starting on a cache
+// line in every channel, so threads rendering different tiles never write to the same line as long as the block grid matches
+// the tile grid.
+struct AccumulationLayout {
+	int blockSize = 16;
+	glm::ivec2 blockOrigin = glm::ivec2(0);	// a corner of the block grid, e.g. the corner of the area split into tiles
+	bool variance = true;	// whether to keep the sums of squares that variance() needs
+};
+
+// Running per-pixel sums of samples, for renders where pixels receive different numbers of samples or receive them over
+// several passes, resolved into an Image once the samples are in. Not thread safe: each pixel must be written by one thread
+// at a time.
+//
+// Buffers can be saved as checkpoints and read back to resume a render. Buffers of the same image rendered with different
+// sampler seeds hold independent samples and can be merged into one with more samples per pixel.
+class AccumulationBuffer {
+	int m_width = 0;
+	int m_height = 0;
+	AccumulationLayout m_layout;
+	glm::ivec2 m_blockShift = glm::ivec2(0);	// added to pixel coordinates so that blocks start at multiples of blockSize
+	int m_blocksPerRow = 0;
+	int m_blockStride = 0;	// pixels from the start of one block to the next, rounded up so that blocks start on cache lines
+	AlignedVector<glm::vec3> m_sum;
+	AlignedVector<float> m_luminanceSquares;	// sum of squared sample luminance, for variance estimates; empty without variance
+	AlignedVector<uint32_t> m_count;
+	std::vector<uint32_t> m_seeds;	// sampler seeds of the renders whose samples the buffer holds
+
+	int idx(int x, int y) const {
+		const int blockSize = m_layout.blockSize;
+		x += m_blockShift.x;
+		y += m_blockShift.y;
+		const int blockX = x / blockSize, blockY = y / blockSize;
+		return (blockY * m_blocksPerRow + blockX) * m_blockStride + (y - blockY * blockSize) * blockSize + (x - blockX * blockSize);
+	}
+	void allocate(int width, int height, const AccumulationLayout& layout);
+public:
+	AccumulationBuffer(int width, int height, const AccumulationLayout& layout = AccumulationLayout()) {
+		allocate(width, height, layout);
+	}
+	// read a checkpoint written by write() into the given layout; width and height are 0 if it can't be read
+	explicit AccumulationBuffer(const std::string& file, const AccumulationLayout& layout = AccumulationLayout());
+
+	int width() const { return m_width; }
+	int height() const { return m_height; }
+	const AccumulationLayout& layout() const { return m_layout; }
+
+	void add(int x, int y, const glm::vec3& sample) {
+		int i = idx(x, y);
+		m_sum[i] += sample;
+		if (m_layout.variance) {
+			float l = luminance(sample);
+			m_luminanceSquares[i] += l * l;
+		}
+		++m_count[i];
+	}
+
+	int count(int x, int y) const { return static_cast<int>(m_count[idx(x, y)]); }
+	glm::vec3 mean(int x, int y) const {
+		int i = idx(x, y);
+		return m_count[i] > 0 ? m_sum[i] / static_cast<float>(m_count[i]) : glm::vec3(0.f);
+	}
+	// Unbiased sample variance of the luminance of the pixel's samples; 0 with fewer than two samples or without variance
+	float variance(int x, int y) const {
+		int i = idx(x, y);
+		if (!m_layout.variance || m_count[i] < 2) return 0.f;
+		float n = static_cast<float>(m_count[i]);
+		float meanLuminance = luminance(m_sum[i]) / n;
+		return glm::max(0.f, (m_luminanceSquares[i] - n * meanLuminance * meanLuminance) / (n - 1.f));
+	}
+
+	const std::vector<uint32_t>& seeds() const { return m_seeds; }
+	// Records that samples drawn with this seed are (or will be) in the buffer
+	void addSeed(uint32_t seed) {
+		if (std::find(m_seeds.begin(), m_seeds.end(), seed) == m_seeds.end()) m_seeds.push_back(seed);
+	}
+
+	// Adds the samples of other, which must have the same size and no seed in common with this buffer (or its samples would
+	// repeat ones already here), but may have another layout; variance is kept only if both buffers have it. Returns false
+	// and leaves the buffer unchanged otherwise.
+	bool merge(const AccumulationBuffer& other);
+
+	// Writes every pixel's mean to image, which must have the same size
+	void resolve(Image& image) const {
+		resolve(image, PixelRect(glm::ivec2(0), glm::ivec2(m_width, m_height)));
+	}
+	// Only the pixels in area
+	void resolve(Image& image, const PixelRect& area) const {
+		for (int y = area.min.y; y < area.max.y; ++y) {
+			for (int x = area.min.x; x < area.max.x; ++x) {
+				image.set(x, y, mean(x, y));
+			}
+		}
+	}
+
+	// Saves the buffer in a compact binary format that doesn't depend on the layout, through a temporary file, so that a crash
+	// while writing leaves the previous checkpoint intact
+	bool write(const std::string& file) const;
+};
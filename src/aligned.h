@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+const size_t cacheLineSize = 64;
+
+// Allocator for std::vector storage that starts on an Alignment-byte boundary (a power of two), e.g. a cache line, so that
+// data split into line-sized blocks never shares a line with its neighbors. Needed because std::allocator ignores
+// over-alignment before C++17.
+template<typename T, size_t Alignment = cacheLineSize>
+class AlignedAllocator {
+public:
+	typedef T value_type;
+	template<typename U>
+	struct rebind {
+		typedef AlignedAllocator<U, Alignment> other;
+	};
+
+	AlignedAllocator() = default;
+	template<typename U>
+	AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+	T* allocate(size_t count) {
+		// room to align, plus the start of the raw block just before the aligned one, for deallocate()
+		char* raw = static_cast<char*>(::operator new(count * sizeof(T) + Alignment - 1 + sizeof(void*)));
+		uintptr_t aligned = (reinterpret_cast<uintptr_t>(raw) + sizeof(void*) + Alignment - 1) & ~static_cast<uintptr_t>(Alignment - 1);
+		reinterpret_cast<void**>(aligned)[-1] = raw;
+		return reinterpret_cast<T*>(aligned);
+	}
+	void deallocate(T* p, size_t) {
+		::operator delete(reinterpret_cast<void**>(p)[-1]);
+	}
+
+	template<typename U>
+	bool operator==(const AlignedAllocator<U, Alignment>&) const { return true; }
+	template<typename U>
+	bool operator!=(const AlignedAllocator<U, Alignment>&) const { return false; }
+};
+
+template<typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T>>;
@@ -0,0 +1,78 @@
+#include "aov.h"
+
+#include <iostream>
+
+namespace {
+	Image* ofSize(Image* image, int width, int height, const char* name) {
+		if (image == nullptr || (image->width() == width && image->height() == height)) return image;
+		std::clog << "The " << name << " output isn't the size of the image; leaving it out\n";
+		return nullptr;
+	}
+}
+
+AovImages aovImagesOfSize(const AovImages& images, int width, int height) {
+	AovImages sized;
+	sized.albedo = ofSize(images.albedo, width, height, "albedo");
+	sized.normal = ofSize(images.normal, width, height, "normal");
+	sized.depth = ofSize(images.depth, width, height, "depth");
+	sized.objectId = ofSize(images.objectId, width, height, "object ID");
+	sized.sampleCount = ofSize(images.sampleCount, width, height, "sample count");
+	sized.emission = ofSize(images.emission, width, height, "emission");
+	sized.variance = ofSize(images.variance, width, height, "variance");
+	return sized;
+}
+
+AovBuffer::AovBuffer(int width, int height, const AovImages& images, const AccumulationLayout& layout)
+	: AovBuffer(PixelRect(glm::ivec2(0), glm::ivec2(width, height)), aovImagesOfSize(images, width, height), layout) {}
+
+AovBuffer::AovBuffer(const PixelRect& area, const AovImages& images, const AccumulationLayout& layout)
+	: m_images(images), m_origin(area.min), m_albedo(0, 0), m_normal(0, 0), m_depth(0, 0), m_emission(0, 0), m_radiance(0, 0) {
+	const int width = glm::max(0, area.max.x - area.min.x), height = glm::max(0, area.max.y - area.min.y);
+	AccumulationLayout sums = layout;
+	sums.blockOrigin -= area.min;
+	sums.variance = false;
+	if (m_images.albedo) m_albedo = AccumulationBuffer(width, height, sums);
+	if (m_images.normal) m_normal = AccumulationBuffer(width, height, sums);
+	if (m_images.depth || m_images.objectId || m_images.sampleCount) m_depth = AccumulationBuffer(width, height, sums);
+	if (m_images.emission) m_emission = AccumulationBuffer(width, height, sums);
+	AccumulationLayout squares = sums;
+	squares.variance = true;
+	if (m_images.variance) m_radiance = AccumulationBuffer(width, height, squares);
+}
+
+void AovBuffer::resolve() const {
+	// every buffer in use counts the samples
+	const AccumulationBuffer& counted = m_depth.width() > 0 ? m_depth : m_albedo.width() > 0 ? m_albedo : m_normal.width() > 0 ? m_normal
+		: m_emission.width() > 0 ? m_emission : m_radiance;
+	for (int j = 0; j < counted.height(); ++j) {
+		for (int i = 0; i < counted.width(); ++i) {
+			const int count = counted.count(i, j);
+			if (count == 0) continue;
+			const int x = i + m_origin.x, y = j + m_origin.y;
+			if (m_images.albedo) m_images.albedo->set(x, y, m_albedo.mean(i, j));
+			if (m_images.normal) m_images.normal->set(x, y, m_normal.mean(i, j));
+			if (m_images.depth) m_images.depth->set(x, y, m_depth.mean(i, j));
+			if (m_images.emission) m_images.emission->set(x, y, m_emission.mean(i, j));
+			if (m_images.sampleCount) m_images.sampleCount->set(x, y, glm::vec3(static_cast<float>(count)));
+			if (m_images.variance) m_images.variance->set(x, y, glm::vec3(m_radiance.variance(i, j) / static_cast<float>(count)));
+		}
+	}
+}
+
+TiledAovBuffer::TiledAovBuffer(int width, int height, const AovImages& images, const PixelRect& area, int tileSize)
+	: m_images(aovImagesOfSize(images, width, height)), m_area(area), m_tileSize(glm::max(1, tileSize)) {
+	m_columns = glm::max(0, (area.max.x - area.min.x + m_tileSize - 1) / m_tileSize);
+	const int rows = glm::max(0, (area.max.y - area.min.y + m_tileSize - 1) / m_tileSize);
+	m_tiles.resize(static_cast<size_t>(m_columns) * rows);
+	// each tile's sums are a single block
+	m_layout.blockSize = m_tileSize;
+	m_layout.blockOrigin = area.min;
+}
+
+void TiledAovBuffer::tileDone(const PixelRect& tile) {
+	if (tile.area() <= 0) return;
+	std::unique_ptr<AovBuffer>& buffer = m_tiles[tileAt(tile.min.x, tile.min.y)];
+	if (!buffer) return;
+	buffer->resolve();
+	buffer.reset();
+}
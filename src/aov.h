@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "common.h"
+#include "accumulation_buffer.h"
+#include "hittable.h"
+#include "image.h"
+#include "material.h"
+#include "tiles.h"
+
+// Auxiliary outputs (AOVs) of a render: what the first surface seen through each pixel is like, for denoisers and
+// compositing. Each is an image of the render's size, or null for none; pixels that aren't rendered are left as they are.
+struct AovImages {
+	Image* albedo = nullptr;	// Material::albedo(), averaged over the pixel's samples
+	Image* normal = nullptr;	// world-space normal on the side seen, averaged, so shorter than unit along edges
+	Image* depth = nullptr;	// distance from the camera, averaged, in every channel
+	Image* objectId = nullptr;	// Hittable::id() hit by the pixel's first sample, in every channel
+	Image* sampleCount = nullptr;	// samples the pixel got, in every channel
+	Image* emission = nullptr;	// Material::emitted(), averaged: the part of the image that is seen straight from the lights
+	// of the luminance of the pixel's mean radiance less the emission (its samples' variance over their count), in every channel
+	Image* variance = nullptr;
+
+	bool any() const { return albedo || normal || depth || objectId || sampleCount || emission || variance; }
+};
+
+// The first surface one camera sample hits; all zero if it hits nothing
+struct AovSample {
+	glm::vec3 albedo = glm::vec3(0.f);
+	glm::vec3 normal = glm::vec3(0.f);
+	float depth = 0.f;
+	uint32_t objectId = 0;
+	glm::vec3 emission = glm::vec3(0.f);
+
+	AovSample() = default;
+	// hit on ray, with its texture differentials set
+	AovSample(const Ray& ray, const Hittable::HitRecord& hit)
+		: albedo(hit.material->albedo(hit)), normal(hit.normal), depth(hit.t * glm::length(ray.direction())), objectId(hit.objectId),
+		emission(hit.material->emitted(hit.uv, hit.point)) {}
+};
+
+// images, with those that don't have the given size left out
+AovImages aovImagesOfSize(const AovImages& images, int width, int height);
+
+// Per-pixel sums of AovSamples, for the images that are wanted, resolved into them once the samples are in. Laid out in
+// blocks like AccumulationBuffer, so that threads rendering different tiles don't share cache lines. Not thread safe: each
+// pixel must be written by one thread at a time.
+class AovBuffer {
+	AovImages m_images;
+	glm::ivec2 m_origin = glm::ivec2(0);	// of the pixels summed, in the images
+	AccumulationBuffer m_albedo;
+	AccumulationBuffer m_normal;
+	AccumulationBuffer m_depth;	// also counts the samples, for sampleCount and objectId
+	AccumulationBuffer m_emission;
+	AccumulationBuffer m_radiance;	// less the emission, for its variance
+public:
+	// images that don't have the given size are left out
+	AovBuffer(int width, int height, const AovImages& images, const AccumulationLayout& layout);
+	// for the pixels of area only, of images that aovImagesOfSize() has checked
+	AovBuffer(const PixelRect& area, const AovImages& images, const AccumulationLayout& layout);
+
+	const AovImages& images() const { return m_images; }
+
+	// sample: of a camera ray that has radiance
+	void add(int x, int y, const AovSample& sample, const glm::vec3& radiance) {
+		const int i = x - m_origin.x, j = y - m_origin.y;
+		if (m_images.variance) m_radiance.add(i, j, radiance - sample.emission);
+		if (m_images.emission) m_emission.add(i, j, sample.emission);
+		if (m_images.albedo) m_albedo.add(i, j, sample.albedo);
+		if (m_images.normal) m_normal.add(i, j, sample.normal);
+		if (m_depth.width() > 0) {
+			// written straight to the image, once
+			if (m_images.objectId && m_depth.count(i, j) == 0) m_images.objectId->set(x, y, glm::vec3(static_cast<float>(sample.objectId)));
+			m_depth.add(i, j, glm::vec3(sample.depth));
+		}
+	}
+
+	// Writes the pixels that have samples to the images
+	void resolve() const;
+};
+
+// AovBuffers for one tile at a time, for out-of-core renders, where sums over the whole image would take as much memory
+// as the image: a tile's is allocated at its first sample, and resolved and freed by tileDone(). Tiles are the cells of
+// tileSize x tileSize pixels from area's corner, as makeTiles() makes them; each must be written by one thread at a time.
+class TiledAovBuffer {
+	AovImages m_images;
+	PixelRect m_area;
+	int m_tileSize;
+	int m_columns;
+	AccumulationLayout m_layout;
+	std::vector<std::unique_ptr<AovBuffer>> m_tiles;
+
+	int tileAt(int x, int y) const { return (y - m_area.min.y) / m_tileSize * m_columns + (x - m_area.min.x) / m_tileSize; }
+public:
+	// images that don't have the given size are left out
+	TiledAovBuffer(int width, int height, const AovImages& images, const PixelRect& area, int tileSize);
+
+	const AovImages& images() const { return m_images; }
+
+	void add(int x, int y, const AovSample& sample, const glm::vec3& radiance) {
+		std::unique_ptr<AovBuffer>& tile = m_tiles[tileAt(x, y)];
+		if (!tile) {
+			const glm::ivec2 min = m_area.min + (glm::ivec2(x, y) - m_area.min) / m_tileSize * m_tileSize;
+			tile.reset(new AovBuffer(PixelRect(min, min + m_tileSize).intersect(m_area), m_images, m_layout));
+		}
+		tile->add(x, y, sample, radiance);
+	}
+
+	// Writes the samples of tile to the images and frees its sums
+	void tileDone(const PixelRect& tile);
+};
@@ -0,0 +1,317 @@
+#include "bdpt.h"
+#include "warp.h"
+
+namespace {
+	// Same offset Renderer::rayColor uses to avoid self-intersection
+	const float rayEpsilon = 1e-3f;
+
+	float remap0(float f) {
+		return f != 0.f ? f : 1.f;
+	}
+
+	bool isBlack(const glm::vec3& c) {
+		return c.x == 0.f && c.y == 0.f && c.z == 0.f;
+	}
+
+	// Converts a solid angle density at from into an area density at next
+	float convertDensity(float pdf, const BDPTIntegrator::Vertex& from, const BDPTIntegrator::Vertex& next) {
+		glm::vec3 w = next.hit.point - from.hit.point;
+		float dist2 = glm::dot(w, w);
+		if (dist2 == 0.f) return 0.f;
+		if (next.type != BDPTIntegrator::Vertex::Type::Camera) {
+			pdf *= glm::abs(glm::dot(next.hit.normal, w)) / glm::sqrt(dist2);
+		}
+		return pdf / dist2;
+	}
+}
+
+glm::vec3 BDPTIntegrator::sample(int x, int y, Sampler& sampler, SplatImage& lightImage) const {
+	std::vector<Vertex> cameraPath;
+	std::vector<Vertex> lightPath;
+	cameraPath.reserve(m_maxBounces + 2);
+	lightPath.reserve(m_maxBounces + 1);
+
+	traceCameraPath(x, y, sampler, cameraPath);
+	traceLightPath(sampler, lightPath);
+
+	glm::vec3 color = glm::vec3(0.f);
+	int cameraVertices = static_cast<int>(cameraPath.size());
+	int lightVertices = static_cast<int>(lightPath.size());
+	for (int t = 1; t <= cameraVertices; ++t) {
+		for (int s = 0; s <= lightVertices; ++s) {
+			int bounces = s + t - 2;
+			if ((s == 1 && t == 1) || bounces < 0 || bounces > m_maxBounces) continue;
+
+			glm::ivec2 pixel;
+			glm::vec3 contribution = connect(lightPath, cameraPath, s, t, pixel);
+			if (t == 1) {
+				if (!isBlack(contribution)) lightImage.add(pixel.x, pixel.y, contribution);
+			}
+			else {
+				color += contribution;
+			}
+		}
+	}
+	return color;
+}
+
+void BDPTIntegrator::traceCameraPath(int x, int y, Sampler& sampler, std::vector<Vertex>& path) const {
+	Vertex camera;
+	camera.type = Vertex::Type::Camera;
+	camera.hit.point = m_camera.frame().pos();
+	camera.beta = glm::vec3(1.f);
+	path.push_back(camera);
+
+	Ray ray = m_camera.getRay(x, y, sampler);
+	randomWalk(ray, camera.beta, m_camera.directionPdf(ray.direction()), m_maxBounces + 2, sampler, path);
+}
+
+void BDPTIntegrator::traceLightPath(Sampler& sampler, std::vector<Vertex>& path) const {
+	const std::vector<std::shared_ptr<Hittable>>& lights = m_lights.objects();
+	if (lights.empty()) return;
+
+	int lightIndex = glm::min(static_cast<int>(sampler.getLight1D() * lights.size()), static_cast<int>(lights.size()) - 1);
+	const Hittable& light = *lights[lightIndex];
+	float area = light.area();
+
+	Vertex vertex;
+	vertex.type = Vertex::Type::Light;
+	if (area <= 0.f || !light.sampleSurface(sampler.get2D(), vertex.hit)) return;
+
+	glm::vec3 emitted = vertex.hit.material->emitted(vertex.hit.uv, vertex.hit.point);
+	if (isBlack(emitted)) return;
+
+	float originPdf = 1.f / (static_cast<float>(lights.size()) * area);
+	vertex.pdfFwd = originPdf;
+	vertex.beta = emitted / originPdf;
+
+	// emit from a random side, cosine-weighted about that side's normal
+	if (sampler.get1D() < 0.5f) vertex.hit.normal = -vertex.hit.normal;
+	glm::vec3 local = cosineHemisphere(sampler.get2D());
+	glm::vec3 direction = fromLocal(local, vertex.hit.normal);
+	float cosTheta = local.z;
+	float pdfDir = 0.5f * cosTheta / pi;
+	if (pdfDir <= 0.f) return;
+
+	path.push_back(vertex);
+	randomWalk(Ray(vertex.hit.point, direction), vertex.beta * cosTheta / pdfDir, pdfDir, m_maxBounces + 1, sampler, path);
+}
+
+void BDPTIntegrator::randomWalk(Ray ray, glm::vec3 beta, float pdfDir, size_t maxVertices, Sampler& sampler, std::vector<Vertex>& path) const {
+	while (path.size() < maxVertices) {
+		Vertex vertex;
+		if (!m_world.hit(ray, Interval(rayEpsilon, infinity), vertex.hit))
+			break;
+
+		vertex.beta = beta;
+		vertex.pdfFwd = convertDensity(pdfDir, path.back(), vertex);
+		path.push_back(vertex);
+		if (path.size() >= maxVertices)
+			break;
+
+		Vertex& current = path.back();
+		Vertex& previous = path[path.size() - 2];
+		const Material& material = *current.hit.material;
+
+		glm::vec3 attenuation;
+		Ray scatteredRay;
+		if (!material.scatter(ray, current.hit, sampler, attenuation, scatteredRay))
+			break;
+		if (glm::dot(scatteredRay.direction(), scatteredRay.direction()) < 1e-12f)
+			break;
+
+		float pdfRev = 0.f;
+		if (material.isSpecular()) {
+			current.delta = true;
+			pdfDir = 0.f;
+		}
+		else {
+			glm::vec3 wo = glm::normalize(-ray.direction());
+			glm::vec3 wi = glm::normalize(scatteredRay.direction());
+			pdfDir = material.scatterPdf(current.hit, wo, wi);
+			pdfRev = material.scatterPdf(current.hit, wi, wo);
+			if (pdfDir <= 0.f)
+				break;
+		}
+		previous.pdfRev = convertDensity(pdfRev, current, previous);
+
+		// scatter() attenuation is already f * cos / pdf
+		beta *= attenuation;
+		ray = scatteredRay;
+	}
+}
+
+glm::vec3 BDPTIntegrator::connect(std::vector<Vertex>& lightPath, std::vector<Vertex>& cameraPath, int s, int t, glm::ivec2& pixel) const {
+	glm::vec3 contribution = glm::vec3(0.f);
+	const Vertex& pt = cameraPath[t - 1];
+
+	if (s == 0) {
+		// the camera subpath found an emitter by itself
+		if (pt.type != Vertex::Type::Surface) return contribution;
+		contribution = pt.beta * pt.hit.material->emitted(pt.hit.uv, pt.hit.point);
+	}
+	else if (t == 1) {
+		// connect a light subpath vertex to the camera
+		const Vertex& qs = lightPath[s - 1];
+		if (qs.delta) return contribution;
+
+		glm::vec2 imagePos;
+		if (!m_camera.project(qs.hit.point, imagePos)) return contribution;
+		pixel = glm::ivec2(glm::floor(imagePos + 0.5f));
+
+		glm::vec3 toCamera = pt.hit.point - qs.hit.point;
+		float dist2 = glm::dot(toCamera, toCamera);
+		glm::vec3 wi = toCamera / glm::sqrt(dist2);
+		float cosCamera = glm::dot(-wi, -m_camera.frame().z());
+		float importance = m_camera.importance(-toCamera);
+
+		contribution = qs.beta * f(qs, lightPath[s - 2], pt) * glm::abs(glm::dot(wi, qs.hit.normal)) * importance * cosCamera / dist2;
+		if (isBlack(contribution) || !unoccluded(qs.hit.point, pt.hit.point)) return glm::vec3(0.f);
+	}
+	else if (s == 1) {
+		// connect a camera subpath vertex to the light subpath's starting point
+		const Vertex& qs = lightPath[0];
+		if (pt.delta) return contribution;
+		contribution = qs.beta * f(pt, cameraPath[t - 2], qs) * pt.beta;
+		if (isBlack(contribution)) return contribution;
+		contribution *= geometry(qs, pt);
+	}
+	else {
+		const Vertex& qs = lightPath[s - 1];
+		if (qs.delta || pt.delta) return contribution;
+		contribution = qs.beta * f(qs, lightPath[s - 2], pt) * f(pt, cameraPath[t - 2], qs) * pt.beta;
+		if (isBlack(contribution)) return contribution;
+		contribution *= geometry(qs, pt);
+	}
+
+	if (isBlack(contribution)) return contribution;
+	return contribution * misWeight(lightPath, cameraPath, s, t);
+}
+
+float BDPTIntegrator::misWeight(std::vector<Vertex>& lightPath, std::vector<Vertex>& cameraPath, int s, int t) const {
+	if (s + t == 2) return 1.f;
+
+	Vertex* qs = s > 0 ? &lightPath[s - 1] : nullptr;
+	Vertex* pt = &cameraPath[t - 1];
+	Vertex* qsMinus = s > 1 ? &lightPath[s - 2] : nullptr;
+	Vertex* ptMinus = t > 1 ? &cameraPath[t - 2] : nullptr;
+
+	// Temporarily update the connection vertices' reverse densities and delta flags as if the path had been
+	// sampled with each other strategy; everything is restored before returning.
+	const float savedPtPdfRev = pt->pdfRev;
+	const float savedPtMinusPdfRev = ptMinus ? ptMinus->pdfRev : 0.f;
+	const float savedQsPdfRev = qs ? qs->pdfRev : 0.f;
+	const float savedQsMinusPdfRev = qsMinus ? qsMinus->pdfRev : 0.f;
+	const bool savedPtDelta = pt->delta;
+	const bool savedQsDelta = qs ? qs->delta : false;
+
+	pt->delta = false;
+	if (qs) qs->delta = false;
+
+	bool lightSampleable = true;
+	if (s == 0) {
+		pt->pdfRev = lightOriginPdf(*pt, *ptMinus);
+		ptMinus->pdfRev = lightDirectionPdf(*pt, *ptMinus);
+		// an emitter that is not in the light list can only be found by the camera subpath
+		lightSampleable = pt->pdfRev > 0.f;
+	}
+	else {
+		pt->pdfRev = pdf(*qs, qsMinus, *pt);
+		if (ptMinus) ptMinus->pdfRev = pdf(*pt, qs, *ptMinus);
+	}
+	if (qs) qs->pdfRev = pdf(*pt, ptMinus, *qs);
+	if (qsMinus) qsMinus->pdfRev = pdf(*qs, pt, *qsMinus);
+
+	float sumRi = 0.f;
+	if (lightSampleable) {
+		float ri = 1.f;
+		for (int i = t - 1; i > 0; --i) {
+			ri *= remap0(cameraPath[i].pdfRev) / remap0(cameraPath[i].pdfFwd);
+			if (!cameraPath[i].delta && !cameraPath[i - 1].delta)
+				sumRi += ri;
+		}
+
+		ri = 1.f;
+		for (int i = s - 1; i >= 0; --i) {
+			ri *= remap0(lightPath[i].pdfRev) / remap0(lightPath[i].pdfFwd);
+			bool deltaBefore = i > 0 && lightPath[i - 1].delta;
+			if (!lightPath[i].delta && !deltaBefore)
+				sumRi += ri;
+		}
+	}
+
+	pt->pdfRev = savedPtPdfRev;
+	pt->delta = savedPtDelta;
+	if (ptMinus) ptMinus->pdfRev = savedPtMinusPdfRev;
+	if (qs) {
+		qs->pdfRev = savedQsPdfRev;
+		qs->delta = savedQsDelta;
+	}
+	if (qsMinus) qsMinus->pdfRev = savedQsMinusPdfRev;
+
+	return 1.f / (1.f + sumRi);
+}
+
+glm::vec3 BDPTIntegrator::f(const Vertex& v, const Vertex& prev, const Vertex& next) const {
+	if (v.type != Vertex::Type::Surface) return glm::vec3(0.f);
+	glm::vec3 wo = glm::normalize(prev.hit.point - v.hit.point);
+	glm::vec3 wi = glm::normalize(next.hit.point - v.hit.point);
+	return v.hit.material->evaluate(v.hit, wo, wi);
+}
+
+float BDPTIntegrator::pdf(const Vertex& v, const Vertex* prev, const Vertex& next) const {
+	if (v.type == Vertex::Type::Camera)
+		return convertDensity(m_camera.directionPdf(next.hit.point - v.hit.point), v, next);
+	if (v.type == Vertex::Type::Light)
+		return lightDirectionPdf(v, next);
+	if (prev == nullptr)
+		return 0.f;
+
+	glm::vec3 wo = glm::normalize(prev->hit.point - v.hit.point);
+	glm::vec3 wi = glm::normalize(next.hit.point - v.hit.point);
+	return convertDensity(v.hit.material->scatterPdf(v.hit, wo, wi), v, next);
+}
+
+float BDPTIntegrator::lightOriginPdf(const Vertex& v, const Vertex& from) const {
+	// find which light(s) v lies on by re-tracing the segment that reached it against each light
+	const std::vector<std::shared_ptr<Hittable>>& lights = m_lights.objects();
+	Ray ray(from.hit.point, v.hit.point - from.hit.point);
+	const float tolerance = 1e-3f;
+
+	float pdf = 0.f;
+	for (const std::shared_ptr<Hittable>& light : lights) {
+		Hittable::HitRecord lightHit;
+		float area = light->area();
+		if (area > 0.f && light->hit(ray, Interval(1.f - tolerance, 1.f + tolerance), lightHit)) {
+			pdf += 1.f / (static_cast<float>(lights.size()) * area);
+		}
+	}
+	return pdf;
+}
+
+float BDPTIntegrator::lightDirectionPdf(const Vertex& v, const Vertex& next) const {
+	glm::vec3 w = glm::normalize(next.hit.point - v.hit.point);
+	float pdfDir = 0.5f * glm::abs(glm::dot(w, v.hit.normal)) / pi;
+	return convertDensity(pdfDir, v, next);
+}
+
+float BDPTIntegrator::geometry(const Vertex& a, const Vertex& b) const {
+	glm::vec3 d = b.hit.point - a.hit.point;
+	float dist2 = glm::dot(d, d);
+	if (dist2 == 0.f) return 0.f;
+	glm::vec3 w = d / glm::sqrt(dist2);
+
+	float g = 1.f / dist2;
+	if (a.type != Vertex::Type::Camera) g *= glm::abs(glm::dot(a.hit.normal, w));
+	if (b.type != Vertex::Type::Camera) g *= glm::abs(glm::dot(b.hit.normal, w));
+	if (g == 0.f || !unoccluded(a.hit.point, b.hit.point)) return 0.f;
+	return g;
+}
+
+bool BDPTIntegrator::unoccluded(const glm::vec3& a, const glm::vec3& b) const {
+	glm::vec3 d = b - a;
+	float dist = glm::length(d);
+	if (dist <= 2.f * rayEpsilon) return true;
+	Hittable::HitRecord hit;
+	return !m_world.hit(Ray(a, d / dist), Interval(rayEpsilon, dist - rayEpsilon), hit);
+}
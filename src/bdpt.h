@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vector>
+
+#include "common.h"
+#include "hittable.h"
+#include "hittable_list.h"
+#include "camera.h"
+#include "material.h"
+#include "sampler.h"
+#include "splat_image.h"
+
+// Bidirectional path tracer (Veach's thesis, structured as in pbrt-v3).
+// Each sample traces one subpath from the camera and one from a light, connects every pair of their vertices,
+// and weights each resulting strategy with the balance heuristic.
+// Strategies with only the camera vertex (light tracing) can land on any pixel, so they are splatted into a SplatImage
+// that the caller adds to the image, divided by the number of samples per pixel.
+// Lights are sampled uniformly by object, then uniformly by area, and emit from both sides like DiffuseEmissive.
+// The environment is assumed black.
+class BDPTIntegrator {
+public:
+	struct Vertex {
+		enum class Type { Camera, Light, Surface };
+
+		Type type = Type::Surface;
+		Hittable::HitRecord hit;	// camera vertices only use the point
+		glm::vec3 beta = glm::vec3(0.f);	// path throughput up to and including this vertex's endpoint factor
+		bool delta = false;	// scattered with a specular material; cannot be connected to
+		float pdfFwd = 0.f;	// area density of sampling this vertex from the previous one on its own subpath
+		float pdfRev = 0.f;	// area density of sampling this vertex from the next one, as if the path were traced the other way
+	};
+
+	BDPTIntegrator(const Hittable& world, const HittableList& lights, const Camera& camera, int maxBounces) :
+		m_world(world), m_lights(lights), m_camera(camera), m_maxBounces(maxBounces) {}
+
+	// Returns one radiance estimate for pixel (x, y); light tracing contributions go into lightImage instead
+	glm::vec3 sample(int x, int y, Sampler& sampler, SplatImage& lightImage) const;
+
+private:
+	const Hittable& m_world;
+	const HittableList& m_lights;
+	const Camera& m_camera;
+	int m_maxBounces = 10;
+
+	void traceCameraPath(int x, int y, Sampler& sampler, std::vector<Vertex>& path) const;
+	void traceLightPath(Sampler& sampler, std::vector<Vertex>& path) const;
+	void randomWalk(Ray ray, glm::vec3 beta, float pdfDir, size_t maxVertices, Sampler& sampler, std::vector<Vertex>& path) const;
+
+	// Contribution of the path made of the first s light vertices and first t camera vertices, MIS weight included.
+	// When t == 1 the contribution belongs to the pixel returned in pixel.
+	glm::vec3 connect(std::vector<Vertex>& lightPath, std::vector<Vertex>& cameraPath, int s, int t, glm::ivec2& pixel) const;
+	float misWeight(std::vector<Vertex>& lightPath, std::vector<Vertex>& cameraPath, int s, int t) const;
+
+	glm::vec3 f(const Vertex& v, const Vertex& prev, const Vertex& next) const;
+	// area density of sampling next from v, having arrived at v from prev (unused for light and camera vertices)
+	float pdf(const Vertex& v, const Vertex* prev, const Vertex& next) const;
+	// area density of the light subpath starting at v
+	float lightOriginPdf(const Vertex& v, const Vertex& from) const;
+	// area density of light emitted at v going to next
+	float lightDirectionPdf(const Vertex& v, const Vertex& next) const;
+	// geometry term between a and b, including visibility
+	float geometry(const Vertex& a, const Vertex& b) const;
+	bool unoccluded(const glm::vec3& a, const glm::vec3& b) const;
+};
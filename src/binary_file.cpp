@@ -0,0 +1,26 @@
+#include "binary_file.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+bool seek(std::FILE* f, uint64_t offset) {
+	// fseek() takes a long, which is 32 bits on Windows
+#ifdef _MSC_VER
+	return _fseeki64(f, static_cast<__int64>(offset), SEEK_SET) == 0;
+#else
+	return fseeko(f, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+}
+
+bool replaceFile(const std::string& temporary, const std::string& file) {
+#ifdef _WIN32
+	// rename() fails there if file exists
+	return MoveFileExA(temporary.c_str(), file.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+	// POSIX rename() replaces file atomically
+	return std::rename(temporary.c_str(), file.c_str()) == 0;
+#endif
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+// Reading and writing the binary files of checkpoints, tiled textures and OpenEXR images. Values are stored as they are
+// in memory, and all of these formats are little-endian, so the host must be too; MSVC only targets little-endian
+// machines, and other compilers say which they target.
+#if defined(__BYTE_ORDER__) && defined(__ORDER_LITTLE_ENDIAN__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "Binary files are written in the host's byte order, which must be little-endian"
+#endif
+
+template<typename T>
+bool writeValues(std::FILE* f, const T* values, size_t count) {
+	return std::fwrite(values, sizeof(T), count, f) == count;
+}
+
+template<typename T>
+bool readValues(std::FILE* f, T* values, size_t count) {
+	return std::fread(values, sizeof(T), count, f) == count;
+}
+
+// Moves to offset from the start of f, also past 2 GB
+bool seek(std::FILE* f, uint64_t offset);
+
+// Moves the file temporary over file in one step, so that file is always either the old one or the new one, even if
+// the process dies on the way; for files written in full to temporary first. Returns false and leaves both files if it
+// can't.
+bool replaceFile(const std::string& temporary, const std::string& file);
@@ -0,0 +1,98 @@
+#include "blue_noise.h"
+
+#include <random>
+
+namespace {
+	const int texels = BlueNoiseTile::size * BlueNoiseTile::size;
+	const int mask = BlueNoiseTile::size - 1;
+
+	// Sum of a toroidally wrapped Gaussian around every set texel
+	class EnergyField {
+		std::vector<float> m_kernel;	// indexed by wrapped offset
+		std::vector<float> m_energy;
+		std::vector<char> m_set;
+	public:
+		EnergyField() : m_kernel(texels), m_energy(texels, 0.f), m_set(texels, 0) {
+			const float sigma = 1.5f;
+			for (int y = 0; y < BlueNoiseTile::size; ++y) {
+				for (int x = 0; x < BlueNoiseTile::size; ++x) {
+					float dx = static_cast<float>(glm::min(x, BlueNoiseTile::size - x));
+					float dy = static_cast<float>(glm::min(y, BlueNoiseTile::size - y));
+					m_kernel[y * BlueNoiseTile::size + x] = glm::exp(-(dx * dx + dy * dy) / (2.f * sigma * sigma));
+				}
+			}
+		}
+
+		bool isSet(int texel) const { return m_set[texel] != 0; }
+
+		void set(int texel, bool value) {
+			if (isSet(texel) == value) return;
+			m_set[texel] = value ? 1 : 0;
+			const float sign = value ? 1.f : -1.f;
+			const int px = texel & mask, py = texel / BlueNoiseTile::size;
+			for (int y = 0; y < BlueNoiseTile::size; ++y) {
+				for (int x = 0; x < BlueNoiseTile::size; ++x) {
+					m_energy[y * BlueNoiseTile::size + x] += sign * m_kernel[((y - py) & mask) * BlueNoiseTile::size + ((x - px) & mask)];
+				}
+			}
+		}
+
+		// set texel with the highest energy
+		int tightestCluster() const {
+			int best = -1;
+			for (int texel = 0; texel < texels; ++texel) {
+				if (isSet(texel) && (best < 0 || m_energy[texel] > m_energy[best])) best = texel;
+			}
+			return best;
+		}
+		// unset texel with the lowest energy
+		int largestVoid() const {
+			int best = -1;
+			for (int texel = 0; texel < texels; ++texel) {
+				if (!isSet(texel) && (best < 0 || m_energy[texel] < m_energy[best])) best = texel;
+			}
+			return best;
+		}
+	};
+}
+
+const BlueNoiseTile& BlueNoiseTile::instance() {
+	static const BlueNoiseTile tile;
+	return tile;
+}
+
+BlueNoiseTile::BlueNoiseTile() : m_ranks(texels, 0) {
+	// initial pattern: a tenth of the texels, spread out by moving the tightest cluster into the largest void until stable
+	EnergyField initial;
+	std::mt19937 generator(1);
+	std::uniform_int_distribution<int> texel(0, texels - 1);
+	const int initialCount = texels / 10;
+	for (int count = 0; count < initialCount;) {
+		int t = texel(generator);
+		if (initial.isSet(t)) continue;
+		initial.set(t, true);
+		++count;
+	}
+	for (int iteration = 0; iteration < texels; ++iteration) {
+		int cluster = initial.tightestCluster();
+		initial.set(cluster, false);
+		int gap = initial.largestVoid();
+		initial.set(gap, true);
+		if (gap == cluster) break;
+	}
+
+	// ranks below the initial count: remove tightest clusters from a copy of the pattern
+	EnergyField removal = initial;
+	for (int rank = initialCount - 1; rank >= 0; --rank) {
+		int cluster = removal.tightestCluster();
+		removal.set(cluster, false);
+		m_ranks[cluster] = rank;
+	}
+
+	// the remaining ranks: fill the largest voids
+	for (int rank = initialCount; rank < texels; ++rank) {
+		int gap = initial.largestVoid();
+		initial.set(gap, true);
+		m_ranks[gap] = rank;
+	}
+}
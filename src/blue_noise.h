@@ -0,0 +1,28 @@
+#pragma once
+
+#include <vector>
+
+#include "common.h"
+
+// Square tile of blue noise made with the void-and-cluster method (Ulichney 1993), built on first use.
+// Every rank in [0, size * size) appears once, nearby texels have dissimilar ranks, and the tile wraps around
+// seamlessly, so it can be repeated over an image of any size.
+class BlueNoiseTile {
+public:
+	static const int size = 64;
+
+	static const BlueNoiseTile& instance();
+
+	// Coordinates wrap around
+	int rank(int x, int y) const {
+		return m_ranks[(y & (size - 1)) * size + (x & (size - 1))];
+	}
+	// Rank mapped to the center of its interval in [0, 1)
+	float value(int x, int y) const {
+		return (static_cast<float>(rank(x, y)) + 0.5f) / static_cast<float>(size * size);
+	}
+private:
+	std::vector<int> m_ranks;
+
+	BlueNoiseTile();
+};
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "cache_stats.h"
 #include "common.h"
 #include "hittable.h"
 
@@ -22,8 +23,8 @@ class BVHNode : public Hittable {
 	}
 public:
 	BVHNode(std::vector<std::shared_ptr<Hittable>> objects, size_t start, size_t end) {
-		for (const std::shared_ptr<Hittable>& obj : objects) {
-			m_bbox.expand(obj->boundingBox());
+		for (size_t i = start; i < end; ++i) {
+			m_bbox.expand(objects[i]->boundingBox());
 		}
 
 		size_t range = end - start;
@@ -46,6 +47,7 @@ public:
 	}
 
 	bool hit(const Ray& ray, Interval tRange, HitRecord& hit) const override {
+		CACHE_STATS_TOUCH(this, sizeof(*this));
 		if (!m_bbox.hit(ray, tRange)) return false;
 
 		bool leftHit = m_left != nullptr && m_left->hit(ray, tRange, hit);
@@ -55,4 +57,8 @@ public:
 	}
 
 	AABox boundingBox() const override { return m_bbox; }
+
+	bool forEachQuad(const QuadVisitor& visit) const override {
+		return (m_left == nullptr || m_left->forEachQuad(visit)) && (m_right == nullptr || m_right->forEachQuad(visit));
+	}
 };
\ No newline at end of file
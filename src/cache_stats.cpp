@@ -0,0 +1,92 @@
+#include "cache_stats.h"
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+namespace {
+	const uint64_t lineSize = 64;
+
+	// One set-associative LRU cache level; each set keeps its tags most recently used first
+	class CacheLevel {
+		uint64_t m_sets;
+		int m_ways;
+		std::vector<uint64_t> m_tags;
+	public:
+		CacheLevel(size_t bytes, int ways) : m_sets(bytes / (lineSize * ways)), m_ways(ways), m_tags(bytes / lineSize, ~uint64_t(0)) {}
+
+		// true on a hit; either way the line becomes the most recently used of its set
+		bool access(uint64_t line) {
+			uint64_t* set = &m_tags[(line % m_sets) * m_ways];
+			int way = 0;
+			while (way < m_ways - 1 && set[way] != line) ++way;
+			bool hit = set[way] == line;
+			for (; way > 0; --way) {
+				set[way] = set[way - 1];
+			}
+			set[0] = line;
+			return hit;
+		}
+
+		void clear() {
+			std::fill(m_tags.begin(), m_tags.end(), ~uint64_t(0));
+		}
+	};
+
+	std::atomic<uint64_t> g_accesses(0);
+	std::atomic<uint64_t> g_l1Misses(0);
+	std::atomic<uint64_t> g_l2Misses(0);
+
+	// A thread's caches and counters; the counters are added to the global ones when the thread exits
+	struct ThreadCaches {
+		CacheLevel l1 = CacheLevel(32 * 1024, 8);
+		CacheLevel l2 = CacheLevel(1024 * 1024, 16);
+		CacheStats stats;
+
+		void flush() {
+			g_accesses += stats.accesses;
+			g_l1Misses += stats.l1Misses;
+			g_l2Misses += stats.l2Misses;
+			stats = CacheStats();
+		}
+		~ThreadCaches() { flush(); }
+	};
+
+	ThreadCaches& threadCaches() {
+		thread_local ThreadCaches caches;
+		return caches;
+	}
+}
+
+namespace cacheStats {
+	void touch(const void* address, size_t size) {
+		ThreadCaches& caches = threadCaches();
+		const uint64_t first = reinterpret_cast<uintptr_t>(address) / lineSize;
+		const uint64_t last = (reinterpret_cast<uintptr_t>(address) + (size > 0 ? size - 1 : 0)) / lineSize;
+		for (uint64_t line = first; line <= last; ++line) {
+			++caches.stats.accesses;
+			if (caches.l1.access(line)) continue;
+			++caches.stats.l1Misses;
+			if (!caches.l2.access(line)) ++caches.stats.l2Misses;
+		}
+	}
+
+	void reset() {
+		ThreadCaches& caches = threadCaches();
+		caches.l1.clear();
+		caches.l2.clear();
+		caches.stats = CacheStats();
+		g_accesses = 0;
+		g_l1Misses = 0;
+		g_l2Misses = 0;
+	}
+
+	CacheStats collect() {
+		threadCaches().flush();
+		CacheStats stats;
+		stats.accesses = g_accesses;
+		stats.l1Misses = g_l1Misses;
+		stats.l2Misses = g_l2Misses;
+		return stats;
+	}
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Cache-miss counters for the renderer's memory accesses, from a software model of a two-level data cache: 64-byte lines,
+// 32 KiB 8-way L1 and 1 MiB 16-way L2, both LRU, one pair per thread as on a core with private caches. Only the accesses
+// marked with CACHE_STATS_TOUCH are modelled (BVH nodes and texels), so the counts compare traversal orders rather than
+// predicting what hardware counters would report.
+//
+// The counters are compiled in only when RAYTRACER_CACHE_STATS is defined; otherwise CACHE_STATS_TOUCH does nothing.
+struct CacheStats {
+	uint64_t accesses = 0;
+	uint64_t l1Misses = 0;
+	uint64_t l2Misses = 0;
+
+	float l1MissRate() const { return accesses > 0 ? static_cast<float>(l1Misses) / static_cast<float>(accesses) : 0.f; }
+	float l2MissRate() const { return accesses > 0 ? static_cast<float>(l2Misses) / static_cast<float>(accesses) : 0.f; }
+};
+
+namespace cacheStats {
+	// Records an access to size bytes at address, by the calling thread
+	void touch(const void* address, size_t size);
+	// Zeroes the counters and empties the calling thread's caches
+	void reset();
+	// Counters of every thread that has exited since reset(), plus the calling thread's
+	CacheStats collect();
+}
+
+#ifdef RAYTRACER_CACHE_STATS
+#define CACHE_STATS_TOUCH(address, size) cacheStats::touch(address, size)
+#else
+#define CACHE_STATS_TOUCH(address, size) ((void)0)
+#endif
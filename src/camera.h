@@ -1,6 +1,8 @@
 #pragma once
 
 #include "common.h"
+#include "ray_differential.h"
+#include "sampler.h"
 
 class Camera {
 public:
@@ -50,18 +52,76 @@ public:
 		m_pixelDeltaY = viewportDown / projection.imageSize().y;
 		glm::vec3 viewportUpperLeft = frame.pos() + viewportForward - 0.5f * (viewportRight + viewportDown);
 		m_pixelUpperLeft = viewportUpperLeft + 0.5f * (m_pixelDeltaX + m_pixelDeltaY);
+		m_unitFilmArea = viewportWidth * viewportHeight / (projection.focalLength() * projection.focalLength());
 	}
 
+	const Frame& frame() const { return m_frame; }
+	const Projection& projection() const { return m_projection; }
+
 	// Return ray through pixel (x, y) (from top left) in world coordinates
 	// Returned ray direction is exact, not necessarily unit vector
 	Ray getRay(int x, int y, bool jitter = false) const {
+		if (jitter) {
+			IndependentSampler sampler;
+			return getRay(x, y, sampler);
+		}
+		return getRay(glm::vec2(x, y));
+	}
+
+	// Jittered ray through pixel (x, y), with the offset drawn from sampler
+	Ray getRay(int x, int y, Sampler& sampler) const {
 		// random offset in [-0.5, -0.5] to [0.5, 0.5]
-		glm::vec2 offset = jitter ?
-			glm::vec2(random() - 0.5f, random() - 0.5f) :
-			glm::vec2(0.f);
-		glm::vec3 pixel = m_pixelUpperLeft + m_pixelDeltaX * (static_cast<float>(x) + offset.x) + m_pixelDeltaY * (static_cast<float>(y) + offset.y);
+		glm::vec2 offset = sampler.getPixel2D() - 0.5f;
+		return getRay(glm::vec2(x, y) + offset);
+	}
+
+	// The same, with the differential of the ray: rays through the same point of the pixels to the right and below
+	Ray getRay(int x, int y, Sampler& sampler, RayDifferential& differential) const {
+		glm::vec2 pixelPos = glm::vec2(x, y) + sampler.getPixel2D() - 0.5f;
+		differential.valid = true;
+		differential.dx = getRay(pixelPos + glm::vec2(1.f, 0.f));
+		differential.dy = getRay(pixelPos + glm::vec2(0.f, 1.f));
+		return getRay(pixelPos);
+	}
+
+	// Ray through continuous pixel coordinates (see project())
+	Ray getRay(const glm::vec2& pixelPos) const {
+		glm::vec3 pixel = m_pixelUpperLeft + m_pixelDeltaX * pixelPos.x + m_pixelDeltaY * pixelPos.y;
 		return Ray(m_frame.pos(), pixel - m_frame.pos());
 	}
+
+	// Inverse of getRay: continuous pixel coordinates of world point p, where pixel (x, y) covers [x - 0.5, x + 0.5) x [y - 0.5, y + 0.5).
+	// Returns false if p is behind the camera or projects outside the image.
+	bool project(const glm::vec3& p, glm::vec2& pixel) const {
+		glm::vec3 offset = p - m_frame.pos();
+		float depth = glm::dot(offset, -m_frame.z());
+		if (depth <= 0.f) return false;
+
+		glm::vec3 onViewport = m_frame.pos() + offset * (m_projection.focalLength() / depth);
+		glm::vec3 fromFirstPixel = onViewport - m_pixelUpperLeft;
+		pixel.x = glm::dot(fromFirstPixel, m_pixelDeltaX) / glm::dot(m_pixelDeltaX, m_pixelDeltaX);
+		pixel.y = glm::dot(fromFirstPixel, m_pixelDeltaY) / glm::dot(m_pixelDeltaY, m_pixelDeltaY);
+
+		const glm::vec2& size = m_projection.imageSize();
+		return pixel.x >= -0.5f && pixel.x < size.x - 0.5f && pixel.y >= -0.5f && pixel.y < size.y - 0.5f;
+	}
+
+	// Solid angle density of jittered camera ray directions, taken over the whole image
+	float directionPdf(const glm::vec3& direction) const {
+		glm::vec2 pixel;
+		if (!project(m_frame.pos() + direction, pixel)) return 0.f;
+		float cosTheta = glm::dot(glm::normalize(direction), -m_frame.z());
+		return 1.f / (m_unitFilmArea * cosTheta * cosTheta * cosTheta);
+	}
+
+	// Importance carried along a direction, normalized so that each pixel measures the mean radiance over its footprint
+	// once light tracing contributions are divided by the number of samples per pixel
+	float importance(const glm::vec3& direction) const {
+		float pdf = directionPdf(direction);
+		if (pdf == 0.f) return 0.f;
+		float cosTheta = glm::dot(glm::normalize(direction), -m_frame.z());
+		return pdf / cosTheta;
+	}
 private:
 	Frame m_frame;
 	Projection m_projection;
@@ -70,4 +130,6 @@ private:
 	glm::vec3 m_pixelUpperLeft = glm::vec3(0.f);
 	glm::vec3 m_pixelDeltaX = glm::vec3(0.f);
 	glm::vec3 m_pixelDeltaY = glm::vec3(0.f);
+	// Area of the viewport scaled to unit distance from the camera
+	float m_unitFilmArea = 0.f;
 };
\ No newline at end of file
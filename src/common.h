@@ -2,6 +2,7 @@
 
 #include <limits>
 #include <random>
+#include <atomic>
 
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
@@ -17,29 +18,24 @@
 const float infinity = std::numeric_limits<float>::infinity();
 const float pi = 3.14159265f;
 
+// Each thread gets its own generator; the first thread to ask keeps the default seed
+inline std::mt19937& threadGenerator() {
+	static std::atomic<unsigned int> nextSeed(std::mt19937::default_seed);
+	static thread_local std::mt19937 generator(nextSeed++);
+	return generator;
+}
+
 inline float random() {
-	static std::uniform_real_distribution<float> distribution(0.0, 1.0);
-	static std::mt19937 generator;
-	return distribution(generator);
+	static thread_local std::uniform_real_distribution<float> distribution(0.0, 1.0);
+	return distribution(threadGenerator());
 }
 
 inline float random(float min, float max) {
 	return min + (max - min) * random();
 }
 
-inline float randomNormal() {
-	static std::normal_distribution<float> distribution(0.0, 1.0);
-	static std::mt19937 generator;
-	return distribution(generator);
-}
-
-inline glm::vec3 randomOnSphere() {
-	return glm::normalize(glm::vec3(randomNormal(), randomNormal(), randomNormal()));
-}
-
-inline glm::vec3 randomOnHemisphere(glm::vec3 normal) {
-	glm::vec3 vec = randomOnSphere();
-	return glm::sign(glm::dot(vec, normal)) * vec;
+inline float luminance(const glm::vec3& color) {
+	return 0.2126f * color.x + 0.7152f * color.y + 0.0722f * color.z;
 }
 
 inline int randomInt(int min, int max) {
@@ -0,0 +1,78 @@
+#include "compact_image.h"
+
+#include "stb_image.h"
+
+void CompactImage::allocate(int width, int height, Format format, float gamma) {
+	m_width = glm::max(0, width);
+	m_height = glm::max(0, height);
+	m_format = format;
+	m_gamma = gamma;
+	m_tilesPerRow = (m_width + tileSize - 1) / tileSize;
+	const int tileRows = (m_height + tileSize - 1) / tileSize;
+	const size_t values = static_cast<size_t>(m_tilesPerRow) * tileRows * tileSize * tileSize * channels;
+	m_texels8.assign(format == Format::Gamma8 ? values : 0, 0);
+	m_texels16.assign(format == Format::Linear16 ? values : 0, 0);
+	for (int i = 0; i < 256; ++i) {
+		m_decode[i] = glm::pow(static_cast<float>(i) / 255.f, gamma);
+	}
+	m_encode = GammaEncoder(gamma, true);
+}
+
+CompactImage::CompactImage(const std::string& file, float gamma, int threadCount) {
+	allocate(0, 0, Format::Gamma8, gamma);
+	if (stbi_is_hdr(file.c_str())) return;
+
+	int width, height, n;
+	if (stbi_is_16_bit(file.c_str())) {
+		uint16_t* rgb = stbi_load_16(file.c_str(), &width, &height, &n, channels);
+		if (rgb == nullptr) return;
+		*this = CompactImage(width, height, rgb, gamma, threadCount);
+		stbi_image_free(rgb);
+	}
+	else {
+		uint8_t* rgb = stbi_load(file.c_str(), &width, &height, &n, channels);
+		if (rgb == nullptr) return;
+		*this = CompactImage(width, height, rgb, gamma, threadCount);
+		stbi_image_free(rgb);
+	}
+}
+
+template<typename T, typename Convert>
+void CompactImage::fill(const T* rgb, AlignedVector<T>& texels, int threadCount, const Convert& convert) {
+	// one row of tiles per job, so that threads write to tiles of their own
+	T* out = texels.data();
+	convertPixels(rgb, m_width, m_height, channels, tileSize, threadCount, convert, [&](int y, const T* in, const auto& convertValue) {
+		for (int x = 0; x < m_width; ++x, in += channels) {
+			T* stored = out + idx(x, y);
+			stored[0] = convertValue(in[0]);
+			stored[1] = convertValue(in[1]);
+			stored[2] = convertValue(in[2]);
+		}
+	});
+}
+
+CompactImage::CompactImage(int width, int height, const uint8_t* rgb, float gamma, int threadCount) {
+	allocate(width, height, Format::Gamma8, gamma);
+	fill(rgb, m_texels8, threadCount, [](uint8_t value) { return value; });
+}
+
+CompactImage::CompactImage(int width, int height, const uint16_t* rgb, float gamma, int threadCount) {
+	allocate(width, height, Format::Linear16, gamma);
+	fill(rgb, m_texels16, threadCount, [gamma](uint16_t value) {
+		const float linear = glm::pow(static_cast<float>(value) / 65535.f, gamma);
+		return static_cast<uint16_t>(linear * 65535.f + 0.5f);
+	});
+}
+
+void CompactImage::set(int x, int y, const glm::vec3& val) {
+	const size_t i = idx(x, y);
+	const glm::vec3 clamped = glm::clamp(val, 0.f, 1.f);
+	for (int c = 0; c < channels; ++c) {
+		if (m_format == Format::Gamma8) {
+			m_texels8[i + c] = m_encode(clamped[c]);
+		}
+		else {
+			m_texels16[i + c] = static_cast<uint16_t>(clamped[c] * 65535.f + 0.5f);
+		}
+	}
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "aligned.h"
+#include "common.h"
+#include "parallel.h"
+#include "pixel_conversion.h"
+
+// RGB texels kept at the precision of an 8- or 16-bit image file, for textures, which are read far more than written and
+// would take 4x the memory as floats. 8-bit values stay gamma encoded and are decoded through a 256-entry table at lookup;
+// 16-bit values are linearized when loaded and kept as fixed point.
+//
+// Texels are grouped in 8x8 tiles, each contiguous (3 cache lines at 8 bits) and in Morton order within, so that lookups
+// close together in the image share cache lines in both directions, not just along rows.
+class CompactImage {
+public:
+	enum class Format {
+		Gamma8,	// 3 bytes per texel
+		Linear16,	// 6 bytes per texel
+	};
+	static const int tileSize = 8;
+	static const int channels = 3;
+private:
+	int m_width = 0;
+	int m_height = 0;
+	Format m_format = Format::Gamma8;
+	float m_gamma = 2.2f;
+	int m_tilesPerRow = 0;
+	AlignedVector<uint8_t> m_texels8;
+	AlignedVector<uint16_t> m_texels16;
+	float m_decode[256];	// 8-bit value to linear
+	GammaEncoder m_encode = GammaEncoder(2.2f, true);	// linear to the nearest 8-bit value
+
+	// first channel of texel (x, y), in units of the texel type
+	size_t idx(int x, int y) const {
+		// Morton order of the 8x8 texels of a tile: the bits of x and y interleaved
+		const int inTile = (x & 1) | ((y & 1) << 1) | ((x & 2) << 1) | ((y & 2) << 2) | ((x & 4) << 2) | ((y & 4) << 3);
+		const size_t tile = static_cast<size_t>(y / tileSize) * m_tilesPerRow + x / tileSize;
+		return (tile * tileSize * tileSize + inTile) * channels;
+	}
+	void allocate(int width, int height, Format format, float gamma);
+	// stores the row-major values rgb in texels, each converted by convert
+	template<typename T, typename Convert>
+	void fill(const T* rgb, AlignedVector<T>& texels, int threadCount, const Convert& convert);
+public:
+	// read an 8- or 16-bit image file, to be transformed into linear space using the provided gamma; width and height are 0
+	// if it can't be read, or if it is a floating point (HDR) file, which has no compact form. Large images are stored by up
+	// to threadCount threads.
+	explicit CompactImage(const std::string& file, float gamma = 2.2f, int threadCount = defaultThreadCount());
+	// from gamma-encoded RGB values in row-major order
+	CompactImage(int width, int height, const uint8_t* rgb, float gamma = 2.2f, int threadCount = defaultThreadCount());
+	CompactImage(int width, int height, const uint16_t* rgb, float gamma = 2.2f, int threadCount = defaultThreadCount());
+	// black, to be filled in with set()
+	CompactImage(int width, int height, Format format, float gamma = 2.2f) {
+		allocate(width, height, format, gamma);
+	}
+
+	int width() const { return m_width; }
+	int height() const { return m_height; }
+	Format format() const { return m_format; }
+	float gamma() const { return m_gamma; }
+	size_t bytes() const { return m_texels8.size() + m_texels16.size() * sizeof(uint16_t); }
+
+	const void* address(int x, int y) const {
+		return m_format == Format::Gamma8 ? static_cast<const void*>(&m_texels8[idx(x, y)]) : static_cast<const void*>(&m_texels16[idx(x, y)]);
+	}
+	glm::vec3 get(int x, int y) const {
+		const size_t i = idx(x, y);
+		if (m_format == Format::Gamma8) {
+			return glm::vec3(m_decode[m_texels8[i]], m_decode[m_texels8[i + 1]], m_decode[m_texels8[i + 2]]);
+		}
+		return glm::vec3(m_texels16[i], m_texels16[i + 1], m_texels16[i + 2]) * (1.f / 65535.f);
+	}
+	// mean of the 2x2 texels from (x, y), for even x and y with x + 1 and y + 1 inside the image; the four are consecutive in
+	// Morton order, so this reads them in one run
+	glm::vec3 average2x2(int x, int y) const {
+		const size_t i = idx(x, y);
+		glm::vec3 sum(0.f);
+		for (size_t t = i; t < i + 4 * channels; t += channels) {
+			if (m_format == Format::Gamma8) {
+				sum += glm::vec3(m_decode[m_texels8[t]], m_decode[m_texels8[t + 1]], m_decode[m_texels8[t + 2]]);
+			}
+			else {
+				sum += glm::vec3(m_texels16[t], m_texels16[t + 1], m_texels16[t + 2]) * (1.f / 65535.f);
+			}
+		}
+		return 0.25f * sum;
+	}
+	// stores linear value val, clamped to [0, 1]
+	void set(int x, int y, const glm::vec3& val);
+};
@@ -0,0 +1,174 @@
+#include "deflate.h"
+
+#include <algorithm>
+
+namespace {
+	// Deflate's bit order: values start at the least significant bit, Huffman codes at their most significant (see FixedCodes)
+	class BitWriter {
+		std::vector<uint8_t>& m_out;
+		uint32_t m_bits = 0;
+		int m_count = 0;
+	public:
+		explicit BitWriter(std::vector<uint8_t>& out) : m_out(out) {}
+
+		void write(uint32_t value, int count) {
+			m_bits |= value << m_count;
+			m_count += count;
+			while (m_count >= 8) {
+				m_out.push_back(static_cast<uint8_t>(m_bits));
+				m_bits >>= 8;
+				m_count -= 8;
+			}
+		}
+		// pads to a byte boundary
+		void flush() {
+			if (m_count > 0) m_out.push_back(static_cast<uint8_t>(m_bits));
+			m_bits = 0;
+			m_count = 0;
+		}
+	};
+
+	const int lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	const int lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	const int distanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073,
+		4097, 6145, 8193, 12289, 16385, 24577 };
+	const int distanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+	// Deflate's fixed Huffman code, with the bits of each code reversed to go through BitWriter::write()
+	struct FixedCodes {
+		uint16_t symbols[288];	// literal, end of block (256) or length symbol
+		uint8_t symbolLengths[288];
+		uint8_t distances[30];
+
+		static uint32_t reverse(uint32_t code, int length) {
+			uint32_t reversed = 0;
+			for (int i = 0; i < length; ++i) {
+				reversed = (reversed << 1) | ((code >> i) & 1);
+			}
+			return reversed;
+		}
+
+		FixedCodes() {
+			for (int symbol = 0; symbol < 288; ++symbol) {
+				uint32_t code;
+				int length;
+				if (symbol < 144) { code = 0x30 + symbol; length = 8; }
+				else if (symbol < 256) { code = 0x190 + symbol - 144; length = 9; }
+				else if (symbol < 280) { code = symbol - 256; length = 7; }
+				else { code = 0xc0 + symbol - 280; length = 8; }
+				symbols[symbol] = static_cast<uint16_t>(reverse(code, length));
+				symbolLengths[symbol] = static_cast<uint8_t>(length);
+			}
+			for (int d = 0; d < 30; ++d) {
+				distances[d] = static_cast<uint8_t>(reverse(d, 5));
+			}
+		}
+	};
+	const FixedCodes fixedCodes;
+
+	void writeSymbol(BitWriter& writer, int symbol) {
+		writer.write(fixedCodes.symbols[symbol], fixedCodes.symbolLengths[symbol]);
+	}
+
+	void writeMatch(BitWriter& writer, int length, int distance) {
+		int l = 28;
+		while (lengthBase[l] > length) --l;
+		writeSymbol(writer, 257 + l);
+		writer.write(length - lengthBase[l], lengthExtra[l]);
+		int d = 29;
+		while (distanceBase[d] > distance) --d;
+		writer.write(fixedCodes.distances[d], 5);
+		writer.write(distance - distanceBase[d], distanceExtra[d]);
+	}
+}
+
+void Adler32::update(const uint8_t* data, size_t size) {
+	// 5552 bytes is the most that can be summed before m_b can overflow 32 bits
+	while (size > 0) {
+		const size_t block = std::min(size, static_cast<size_t>(5552));
+		for (size_t i = 0; i < block; ++i) {
+			m_a += data[i];
+			m_b += m_a;
+		}
+		m_a %= modulus;
+		m_b %= modulus;
+		data += block;
+		size -= block;
+	}
+}
+
+void Adler32::append(const Adler32& next, size_t size) {
+	// every byte of next's adds m_a - 1 to m_b once more, on top of next's own sums
+	const uint32_t lengthTerm = static_cast<uint32_t>(size % modulus) * ((m_a + modulus - 1) % modulus) % modulus;
+	m_b = (m_b + next.m_b + lengthTerm) % modulus;
+	m_a = (m_a + next.m_a + modulus - 1) % modulus;
+}
+
+void deflate(const uint8_t* data, int size, bool final, std::vector<uint8_t>& out) {
+	const int windowSize = 32768, hashBits = 15, maxChain = 32, minMatch = 3, maxMatch = 258;
+	std::vector<int> head(1 << hashBits, -1);
+	std::vector<int> previous(windowSize, -1);	// the last position before i with the same hash, at i % windowSize
+	auto hash = [data](int i) {
+		const uint32_t bytes = (static_cast<uint32_t>(data[i]) << 16) | (static_cast<uint32_t>(data[i + 1]) << 8) | data[i + 2];
+		return (bytes * 2654435761u) >> (32 - hashBits);
+	};
+	auto insert = [&](int i) {
+		if (i + minMatch > size) return;
+		const uint32_t h = hash(i);
+		previous[i % windowSize] = head[h];
+		head[h] = i;
+	};
+
+	BitWriter writer(out);
+	writer.write(final ? 1 : 0, 1);
+	writer.write(1, 2);	// fixed Huffman code
+	int i = 0;
+	while (i < size) {
+		int bestLength = 0, bestDistance = 0;
+		if (i + minMatch <= size) {
+			const int longest = std::min(maxMatch, size - i);
+			int candidate = head[hash(i)];
+			// positions at least a window back may have had their chain entries overwritten
+			for (int chain = 0; candidate >= 0 && i - candidate < windowSize && chain < maxChain; ++chain) {
+				int length = 0;
+				while (length < longest && data[candidate + length] == data[i + length]) ++length;
+				if (length > bestLength) {
+					bestLength = length;
+					bestDistance = i - candidate;
+					if (length == longest) break;
+				}
+				candidate = previous[candidate % windowSize];
+			}
+		}
+		if (bestLength >= minMatch) {
+			writeMatch(writer, bestLength, bestDistance);
+			for (int end = i + bestLength; i < end; ++i) insert(i);
+		}
+		else {
+			writeSymbol(writer, data[i]);
+			insert(i);
+			++i;
+		}
+	}
+	writeSymbol(writer, 256);
+	if (!final) {
+		writer.write(0, 3);
+		writer.flush();
+		const uint8_t stored[4] = { 0x00, 0x00, 0xff, 0xff };
+		out.insert(out.end(), stored, stored + 4);
+	}
+	writer.flush();
+}
+
+void zlibCompress(const uint8_t* data, int size, std::vector<uint8_t>& out) {
+	// deflate with a 32K window, at the fastest level
+	out.push_back(0x78);
+	out.push_back(0x01);
+	deflate(data, size, true, out);
+	Adler32 adler;
+	adler.update(data, static_cast<size_t>(size));
+	const uint32_t checksum = adler.value();
+	for (int shift = 24; shift >= 0; shift -= 8) {
+		out.push_back(static_cast<uint8_t>(checksum >> shift));
+	}
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Adler-32 checksum, which ends every zlib stream
+class Adler32 {
+	static const uint32_t modulus = 65521;
+	uint32_t m_a = 1;
+	uint32_t m_b = 0;
+public:
+	void update(const uint8_t* data, size_t size);
+	// as if the size bytes whose checksum is next had been added to this one, so that parts can be summed in parallel
+	void append(const Adler32& next, size_t size);
+	uint32_t value() const { return (m_b << 16) | m_a; }
+};
+
+// Compresses size bytes of data into deflate blocks, with the fixed Huffman code and matches found along hash chains, and
+// appends them to out. They end on a byte boundary: with the stream's final block if final, otherwise with an empty stored
+// block, as zlib's sync flush does, so that the output for consecutive pieces of data, compressed independently, joins
+// into one stream.
+void deflate(const uint8_t* data, int size, bool final, std::vector<uint8_t>& out);
+
+// Appends a whole zlib stream of data to out: header, deflate blocks and checksum
+void zlibCompress(const uint8_t* data, int size, std::vector<uint8_t>& out);
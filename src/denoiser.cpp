@@ -0,0 +1,319 @@
+#include "denoiser.h"
+
+#include <cmath>
+
+#include "aligned.h"
+#include "tiles.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DENOISER_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+	typedef AlignedVector<float> Plane;
+
+	// cubic B-spline, the à-trous kernel in each direction
+	const float kernel[5] = { 1.f / 16.f, 1.f / 4.f, 3.f / 8.f, 1.f / 4.f, 1.f / 16.f };
+	// the filter works on tiles of this many pixels a side, one per thread at a time
+	const int tileSize = 64;
+	// Tap weights are e^-exponent, with the exponent clamped so that weights and their squares stay normal floats: they are
+	// negligible by then, and denormals are many times slower to compute with
+	const float maxExponent = 30.f;
+
+	// What is filtered: the color divided by the albedo, and the variance of its luminance; one plane per quantity, so
+	// that neighboring pixels of a row are neighbors in memory
+	struct Signal {
+		Plane r, g, b, variance;
+		explicit Signal(size_t size) : r(size), g(size), b(size), variance(size) {}
+	};
+
+	// The guides, as planes
+	struct Features {
+		int width = 0;
+		int height = 0;
+		bool normals = false;
+		bool depth = false;
+		bool variance = false;
+		Plane nx, ny, nz;
+		Plane z;
+		Plane gradientX, gradientY;	// of z, the smaller difference to the pixels on either side, so edges don't count
+	};
+
+	// Per-pass values of each pixel
+	struct Pass {
+		int step = 1;	// pixels between taps
+		Plane luminance;
+		Plane luminanceScale;	// 1 / (luminancePhi * standard deviation of the noise), 0 without variance
+	};
+
+	// divided by for depth differences at pixel p, for a tap i, j steps away: the depth change the gradient predicts there
+	// plus a little of the depth itself, so that surfaces facing the camera don't stop the filter at every change
+	struct DepthScale {
+		float x, y, offset;
+		DepthScale(const Features& f, const Pass& pass, float phi, size_t p) : x(0.f), y(0.f), offset(1.f) {
+			if (!f.depth) return;
+			x = phi * pass.step * f.gradientX[p];
+			y = phi * pass.step * f.gradientY[p];
+			offset = phi * 1e-3f * f.z[p] + 1e-6f;
+		}
+	};
+
+	void filterPixel(const Signal& in, Signal& out, const Features& f, const Pass& pass, const Denoiser::Settings& settings, int x, int y) {
+		const size_t p = static_cast<size_t>(y) * f.width + x;
+		const float lp = pass.luminance[p], ls = pass.luminanceScale[p];
+		const DepthScale depthScale(f, pass, settings.depthPhi, p);
+
+		// the pixel itself always counts, whatever the guides say
+		float weights = kernel[2] * kernel[2];
+		float r = weights * in.r[p], g = weights * in.g[p], b = weights * in.b[p];
+		float variance = weights * weights * in.variance[p];
+		for (int j = -2; j <= 2; ++j) {
+			const int qy = y + j * pass.step;
+			if (qy < 0 || qy >= f.height) continue;
+			for (int i = -2; i <= 2; ++i) {
+				const int qx = x + i * pass.step;
+				if ((i == 0 && j == 0) || qx < 0 || qx >= f.width) continue;
+				const size_t q = static_cast<size_t>(qy) * f.width + qx;
+
+				float exponent = std::abs(lp - pass.luminance[q]) * ls;
+				if (f.depth) {
+					exponent += std::abs(f.z[p] - f.z[q]) / (depthScale.x * std::abs(i) + depthScale.y * std::abs(j) + depthScale.offset);
+				}
+				if (f.normals) {
+					exponent += settings.normalPower * (1.f - (f.nx[p] * f.nx[q] + f.ny[p] * f.ny[q] + f.nz[p] * f.nz[q]));
+				}
+				const float w = kernel[i + 2] * kernel[j + 2] * std::exp(-glm::min(exponent, maxExponent));
+				weights += w;
+				r += w * in.r[q];
+				g += w * in.g[q];
+				b += w * in.b[q];
+				variance += w * w * in.variance[q];
+			}
+		}
+		out.r[p] = r / weights;
+		out.g[p] = g / weights;
+		out.b[p] = b / weights;
+		out.variance[p] = variance / (weights * weights);
+	}
+
+#ifdef DENOISER_SSE2
+	// e^x for x <= 0, to within about 2e-7 relative: 2^(x log2(e)) as a power of two times a polynomial for the rest
+	__m128 exp4(__m128 x) {
+		const __m128 t = _mm_mul_ps(_mm_max_ps(x, _mm_set1_ps(-87.f)), _mm_set1_ps(1.44269504f));
+		const __m128i n = _mm_cvtps_epi32(t);
+		const __m128 f = _mm_sub_ps(t, _mm_cvtepi32_ps(n));	// in [-0.5, 0.5]
+		__m128 poly = _mm_set1_ps(1.535336188319500e-4f);
+		poly = _mm_add_ps(_mm_mul_ps(poly, f), _mm_set1_ps(1.339887440266574e-3f));
+		poly = _mm_add_ps(_mm_mul_ps(poly, f), _mm_set1_ps(9.618437357674640e-3f));
+		poly = _mm_add_ps(_mm_mul_ps(poly, f), _mm_set1_ps(5.550332471162809e-2f));
+		poly = _mm_add_ps(_mm_mul_ps(poly, f), _mm_set1_ps(2.402264791363012e-1f));
+		poly = _mm_add_ps(_mm_mul_ps(poly, f), _mm_set1_ps(6.931472028550421e-1f));
+		poly = _mm_add_ps(_mm_mul_ps(poly, f), _mm_set1_ps(1.f));
+		const __m128 power = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(n, _mm_set1_epi32(127)), 23));
+		return _mm_mul_ps(poly, power);
+	}
+
+	__m128 abs4(__m128 x) {
+		return _mm_andnot_ps(_mm_set1_ps(-0.f), x);
+	}
+
+	// filterPixel() for pixels x to x + 3 at once, all of whose taps must be within the image's width
+	void filterPixels4(const Signal& in, Signal& out, const Features& f, const Pass& pass, const Denoiser::Settings& settings, int x, int y) {
+		const size_t p = static_cast<size_t>(y) * f.width + x;
+		const __m128 lp = _mm_loadu_ps(&pass.luminance[p]), ls = _mm_loadu_ps(&pass.luminanceScale[p]);
+		// 1 / DepthScale for each distance of a tap in steps, |i| + 3 |j|
+		__m128 zp = _mm_setzero_ps(), depthScale[9];
+		if (f.depth) {
+			const __m128 phi = _mm_set1_ps(settings.depthPhi);
+			zp = _mm_loadu_ps(&f.z[p]);
+			const __m128 depthX = _mm_mul_ps(_mm_mul_ps(phi, _mm_set1_ps(static_cast<float>(pass.step))), _mm_loadu_ps(&f.gradientX[p]));
+			const __m128 depthY = _mm_mul_ps(_mm_mul_ps(phi, _mm_set1_ps(static_cast<float>(pass.step))), _mm_loadu_ps(&f.gradientY[p]));
+			const __m128 depthOffset = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(phi, _mm_set1_ps(1e-3f)), zp), _mm_set1_ps(1e-6f));
+			for (int j = 0; j <= 2; ++j) {
+				for (int i = 0; i <= 2; ++i) {
+					const __m128 scale = _mm_add_ps(_mm_add_ps(_mm_mul_ps(depthX, _mm_set1_ps(static_cast<float>(i))),
+						_mm_mul_ps(depthY, _mm_set1_ps(static_cast<float>(j)))), depthOffset);
+					depthScale[i + 3 * j] = _mm_div_ps(_mm_set1_ps(1.f), scale);
+				}
+			}
+		}
+		__m128 nxp = _mm_setzero_ps(), nyp = nxp, nzp = nxp;
+		if (f.normals) {
+			nxp = _mm_loadu_ps(&f.nx[p]);
+			nyp = _mm_loadu_ps(&f.ny[p]);
+			nzp = _mm_loadu_ps(&f.nz[p]);
+		}
+
+		const __m128 normalPower = _mm_set1_ps(settings.normalPower);
+		const __m128 center = _mm_set1_ps(kernel[2] * kernel[2]);
+		__m128 weights = center;
+		__m128 r = _mm_mul_ps(center, _mm_loadu_ps(&in.r[p]));
+		__m128 g = _mm_mul_ps(center, _mm_loadu_ps(&in.g[p]));
+		__m128 b = _mm_mul_ps(center, _mm_loadu_ps(&in.b[p]));
+		__m128 variance = _mm_mul_ps(_mm_mul_ps(center, center), _mm_loadu_ps(&in.variance[p]));
+		for (int j = -2; j <= 2; ++j) {
+			const int qy = y + j * pass.step;
+			if (qy < 0 || qy >= f.height) continue;
+			for (int i = -2; i <= 2; ++i) {
+				if (i == 0 && j == 0) continue;
+				const size_t q = static_cast<size_t>(qy) * f.width + x + i * pass.step;
+
+				__m128 exponent = _mm_mul_ps(abs4(_mm_sub_ps(lp, _mm_loadu_ps(&pass.luminance[q]))), ls);
+				if (f.depth) {
+					const __m128 scale = depthScale[std::abs(i) + 3 * std::abs(j)];
+					exponent = _mm_add_ps(exponent, _mm_mul_ps(abs4(_mm_sub_ps(zp, _mm_loadu_ps(&f.z[q]))), scale));
+				}
+				if (f.normals) {
+					__m128 cosine = _mm_mul_ps(nxp, _mm_loadu_ps(&f.nx[q]));
+					cosine = _mm_add_ps(cosine, _mm_mul_ps(nyp, _mm_loadu_ps(&f.ny[q])));
+					cosine = _mm_add_ps(cosine, _mm_mul_ps(nzp, _mm_loadu_ps(&f.nz[q])));
+					exponent = _mm_add_ps(exponent, _mm_mul_ps(normalPower, _mm_sub_ps(_mm_set1_ps(1.f), cosine)));
+				}
+				exponent = _mm_min_ps(exponent, _mm_set1_ps(maxExponent));
+				const __m128 w = _mm_mul_ps(_mm_set1_ps(kernel[i + 2] * kernel[j + 2]), exp4(_mm_sub_ps(_mm_setzero_ps(), exponent)));
+				weights = _mm_add_ps(weights, w);
+				r = _mm_add_ps(r, _mm_mul_ps(w, _mm_loadu_ps(&in.r[q])));
+				g = _mm_add_ps(g, _mm_mul_ps(w, _mm_loadu_ps(&in.g[q])));
+				b = _mm_add_ps(b, _mm_mul_ps(w, _mm_loadu_ps(&in.b[q])));
+				variance = _mm_add_ps(variance, _mm_mul_ps(_mm_mul_ps(w, w), _mm_loadu_ps(&in.variance[q])));
+			}
+		}
+		_mm_storeu_ps(&out.r[p], _mm_div_ps(r, weights));
+		_mm_storeu_ps(&out.g[p], _mm_div_ps(g, weights));
+		_mm_storeu_ps(&out.b[p], _mm_div_ps(b, weights));
+		_mm_storeu_ps(&out.variance[p], _mm_div_ps(variance, _mm_mul_ps(weights, weights)));
+	}
+#endif
+
+	void filterTile(const Signal& in, Signal& out, const Features& f, const Pass& pass, const Denoiser::Settings& settings, const PixelRect& tile) {
+		const int reach = 2 * pass.step;
+		for (int y = tile.min.y; y < tile.max.y; ++y) {
+			int x = tile.min.x;
+#ifdef DENOISER_SSE2
+			// four at a time where every tap is inside the image, one at a time at its sides
+			for (; x < tile.max.x && x < reach; ++x) filterPixel(in, out, f, pass, settings, x, y);
+			for (; x + 4 <= tile.max.x && x + 3 + reach < f.width; x += 4) filterPixels4(in, out, f, pass, settings, x, y);
+#endif
+			for (; x < tile.max.x; ++x) filterPixel(in, out, f, pass, settings, x, y);
+		}
+	}
+
+	// The pass's luminance, and how far it may differ from a neighbor's given the noise: the variance is blurred over 3x3
+	// pixels first, as estimates from a few samples are noisy themselves
+	void preparePass(const Signal& in, const Features& f, float luminancePhi, Pass& pass, const PixelRect& tile) {
+		for (int y = tile.min.y; y < tile.max.y; ++y) {
+			for (int x = tile.min.x; x < tile.max.x; ++x) {
+				const size_t p = static_cast<size_t>(y) * f.width + x;
+				pass.luminance[p] = luminance(glm::vec3(in.r[p], in.g[p], in.b[p]));
+				if (!f.variance) {
+					pass.luminanceScale[p] = 0.f;
+					continue;
+				}
+				float variance = 0.f, weights = 0.f;
+				for (int j = -1; j <= 1; ++j) {
+					const int qy = y + j;
+					if (qy < 0 || qy >= f.height) continue;
+					for (int i = -1; i <= 1; ++i) {
+						const int qx = x + i;
+						if (qx < 0 || qx >= f.width) continue;
+						const float w = (j == 0 ? 2.f : 1.f) * (i == 0 ? 2.f : 1.f);
+						variance += w * in.variance[static_cast<size_t>(qy) * f.width + qx];
+						weights += w;
+					}
+				}
+				pass.luminanceScale[p] = 1.f / (luminancePhi * std::sqrt(glm::max(0.f, variance / weights)) + 1e-6f);
+			}
+		}
+	}
+
+	// dividing by the albedo where it isn't black, which would lose the color
+	glm::vec3 demodulation(const AovImages& guides, int x, int y) {
+		if (guides.albedo == nullptr) return glm::vec3(1.f);
+		const glm::vec3 albedo = guides.albedo->get(x, y);
+		return glm::vec3(albedo.x > 1e-3f ? albedo.x : 1.f, albedo.y > 1e-3f ? albedo.y : 1.f, albedo.z > 1e-3f ? albedo.z : 1.f);
+	}
+}
+
+bool Denoiser::denoise(const Image& color, const AovImages& guides, Image& output) const {
+	const int width = color.width(), height = color.height();
+	auto sameSize = [&](const Image* image) { return image == nullptr || (image->width() == width && image->height() == height); };
+	if (!sameSize(&output) || !sameSize(guides.albedo) || !sameSize(guides.normal) || !sameSize(guides.depth) || !sameSize(guides.emission)
+		|| !sameSize(guides.variance)) {
+		return false;
+	}
+	const size_t size = static_cast<size_t>(width) * height;
+	if (size == 0) return true;
+
+	Features f;
+	f.width = width;
+	f.height = height;
+	f.normals = guides.normal != nullptr;
+	f.depth = guides.depth != nullptr;
+	f.variance = guides.variance != nullptr;
+	f.nx.resize(f.normals ? size : 0);
+	f.ny.resize(f.normals ? size : 0);
+	f.nz.resize(f.normals ? size : 0);
+	f.z.resize(f.depth ? size : 0);
+	f.gradientX.resize(f.depth ? size : 0);
+	f.gradientY.resize(f.depth ? size : 0);
+	Signal signal(size), filtered(size);
+
+	parallelFor(height, m_threadCount, [&](int y) {
+		for (int x = 0; x < width; ++x) {
+			const size_t p = static_cast<size_t>(y) * width + x;
+			const glm::vec3 albedo = demodulation(guides, x, y);
+			const glm::vec3 emission = guides.emission ? guides.emission->get(x, y) : glm::vec3(0.f);
+			const glm::vec3 c = (color.get(x, y) - emission) / albedo;
+			signal.r[p] = c.x;
+			signal.g[p] = c.y;
+			signal.b[p] = c.z;
+			// the luminance is divided by about the albedo's luminance, and its variance by the square
+			const float scale = luminance(albedo);
+			signal.variance[p] = f.variance ? guides.variance->get(x, y).x / (scale * scale) : 0.f;
+			if (f.normals) {
+				const glm::vec3 n = guides.normal->get(x, y);
+				f.nx[p] = n.x;
+				f.ny[p] = n.y;
+				f.nz[p] = n.z;
+			}
+			if (f.depth) f.z[p] = guides.depth->get(x, y).x;
+		}
+	});
+	if (f.depth) {
+		parallelFor(height, m_threadCount, [&](int y) {
+			for (int x = 0; x < width; ++x) {
+				const size_t p = static_cast<size_t>(y) * width + x;
+				const float z = f.z[p];
+				const float left = x > 0 ? std::abs(z - f.z[p - 1]) : infinity, right = x + 1 < width ? std::abs(z - f.z[p + 1]) : infinity;
+				const float up = y > 0 ? std::abs(z - f.z[p - width]) : infinity, down = y + 1 < height ? std::abs(z - f.z[p + width]) : infinity;
+				f.gradientX[p] = width > 1 ? glm::min(left, right) : 0.f;
+				f.gradientY[p] = height > 1 ? glm::min(up, down) : 0.f;
+			}
+		});
+	}
+
+	const std::vector<PixelRect> tiles = makeTiles(PixelRect(glm::ivec2(0), glm::ivec2(width, height)), tileSize);
+	Pass pass;
+	pass.luminance.resize(size);
+	pass.luminanceScale.resize(size);
+	for (int i = 0; i < m_settings.passes; ++i) {
+		pass.step = 1 << i;
+		parallelFor(static_cast<int>(tiles.size()), m_threadCount, [&](int t) {
+			preparePass(signal, f, m_settings.luminancePhi, pass, tiles[t]);
+		});
+		parallelFor(static_cast<int>(tiles.size()), m_threadCount, [&](int t) {
+			filterTile(signal, filtered, f, pass, m_settings, tiles[t]);
+		});
+		std::swap(signal, filtered);
+	}
+
+	parallelFor(height, m_threadCount, [&](int y) {
+		for (int x = 0; x < width; ++x) {
+			const size_t p = static_cast<size_t>(y) * width + x;
+			const glm::vec3 emission = guides.emission ? guides.emission->get(x, y) : glm::vec3(0.f);
+			output.set(x, y, glm::vec3(signal.r[p], signal.g[p], signal.b[p]) * demodulation(guides, x, y) + emission);
+		}
+	});
+	return true;
+}
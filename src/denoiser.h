@@ -0,0 +1,38 @@
+#pragma once
+
+#include "common.h"
+#include "aov.h"
+#include "image.h"
+#include "parallel.h"
+
+// Edge-avoiding à-trous wavelet filter in the manner of SVGF (Schied et al. 2017), for renders at a few tens of samples
+// per pixel. Each pass blurs with a 5x5 B-spline kernel whose taps are spread twice as far apart as the last pass's, so a
+// few passes reach far, and weighs every tap down where the guides tell the pixels apart: by their normals, by their depth
+// against the local depth gradient, and by their luminance against the noise the per-pixel variance predicts. The color is
+// divided by the albedo first and multiplied back after, so that textures stay sharp while the lighting is smoothed, and
+// lights seen directly, which have no noise to remove, are taken out of it.
+//
+// The guides are the AOVs a Renderer fills in the same pass as the image (see AovImages): albedo, normal, depth, emission
+// and variance are used; any of them may be left out, and only weigh the filter when present. Without variance, luminance
+// doesn't stop the filter at all, so it should be given.
+class Denoiser {
+public:
+	struct Settings {
+		int passes = 5;	// the last pass's taps are 2^(passes - 1) pixels apart, so the filter reaches 2^passes pixels out
+		float luminancePhi = 4.f;	// standard deviations of noise beyond which luminance differences stop the filter
+		float normalPower = 128.f;	// weight exp(-normalPower (1 - cosine)) between two pixels' normals, about cosine^normalPower
+		float depthPhi = 1.f;	// depth differences, relative to the depth gradient's, beyond which the filter stops
+	};
+private:
+	Settings m_settings;
+	int m_threadCount = defaultThreadCount();
+public:
+	Denoiser() = default;
+	explicit Denoiser(const Settings& settings, int threadCount = defaultThreadCount()) : m_settings(settings), m_threadCount(threadCount) {}
+
+	const Settings& settings() const { return m_settings; }
+
+	// Writes the filtered color to output, which may be color itself; guides must have color's size. Returns false and
+	// leaves output unchanged if output or a guide has another size.
+	bool denoise(const Image& color, const AovImages& guides, Image& output) const;
+};
@@ -14,13 +14,13 @@ class Dielectric : public Material {
 		return r0 + (1.f - r0) * glm::pow(1.f - cosTheta, 5.f);
 	}
 
-	// incident, normal assumed to be normalized
-	static glm::vec3 refract(glm::vec3 incident, glm::vec3 normal, float iorRatio) {
+	// incident, normal assumed to be normalized; u in [0, 1) chooses between reflection and refraction
+	static glm::vec3 refract(glm::vec3 incident, glm::vec3 normal, float iorRatio, float u) {
 		float cosTheta = glm::dot(-incident, normal);
 		float sinTheta = glm::sqrt(1.f - cosTheta * cosTheta);
 
 		bool totalInternalReflection = iorRatio * sinTheta > 1.f;
-		if (totalInternalReflection || random() < fresnelReflectance(cosTheta, iorRatio)) {
+		if (totalInternalReflection || u < fresnelReflectance(cosTheta, iorRatio)) {
 			return glm::reflect(incident, normal);
 		}
 
@@ -31,11 +31,31 @@ class Dielectric : public Material {
 public:
 	Dielectric(float indexOfRefraction) : m_indexOfRefraction(indexOfRefraction) {}
 
-	bool scatter(const Ray& ray, const Hittable::HitRecord& hit, glm::vec3& attenuation, Ray& scatteredRay) const {
+	bool scatter(const Ray& ray, const Hittable::HitRecord& hit, Sampler& sampler, glm::vec3& attenuation, Ray& scatteredRay) const override {
 		attenuation = glm::vec3(1.f);
 		float relativeIOR = hit.frontFace ? 1.f / m_indexOfRefraction : m_indexOfRefraction;
-		glm::vec3 refractDirection = refract(glm::normalize(ray.direction()), hit.normal, relativeIOR);
+		glm::vec3 refractDirection = refract(glm::normalize(ray.direction()), hit.normal, relativeIOR, sampler.getLobe1D());
 		scatteredRay = Ray(hit.point, refractDirection);
 		return true;
 	}
+
+	glm::vec3 albedo(const Hittable::HitRecord& hit) const override {
+		return glm::vec3(1.f);
+	}
+
+	bool scatterDifferential(const Ray& ray, const Hittable::HitRecord& hit, const Ray& scatteredRay, const RayDifferential& differential, RayDifferential& scatteredDifferential) const override {
+		// scatter() reflects to the side the normal faces and refracts to the other
+		if (glm::dot(scatteredRay.direction(), hit.normal) > 0.f) {
+			scatteredDifferential = reflectDifferential(differential, hit, scatteredRay);
+		}
+		else {
+			float relativeIOR = hit.frontFace ? 1.f / m_indexOfRefraction : m_indexOfRefraction;
+			scatteredDifferential = refractDifferential(differential, hit, scatteredRay, relativeIOR);
+		}
+		return scatteredDifferential.valid;
+	}
+
+	bool isSpecular() const override {
+		return true;
+	}
 };
\ No newline at end of file
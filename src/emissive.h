@@ -4,12 +4,13 @@
 #include "texture.h"
 
 class DiffuseEmissive : public Material {
-	std::shared_ptr<Texture> m_texture = nullptr;
+	std::shared_ptr<Texture> m_texture = nullptr;	// null for a solid color
+	TextureProgram m_emit;	// m_texture, compiled
 public:
-	DiffuseEmissive(glm::vec3 emit) : m_texture(std::make_shared<SolidColorTexture>(emit)) {}
-	DiffuseEmissive(std::shared_ptr<Texture> texture) : m_texture(texture) {}
+	DiffuseEmissive(glm::vec3 emit) : m_emit(emit) {}
+	DiffuseEmissive(std::shared_ptr<Texture> texture) : m_texture(texture), m_emit(*texture) {}
 
 	glm::vec3 emitted(const glm::vec2& uv, const glm::vec3& p) const override {
-		return m_texture->value(uv, p);
+		return m_emit.value(uv, p);
 	}
 };
\ No newline at end of file
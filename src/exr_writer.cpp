@@ -0,0 +1,352 @@
+#include "exr_writer.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "binary_file.h"
+#include "deflate.h"
+
+namespace {
+	// File layout, little-endian: magic, version and flags, header attributes (name, type name, size, value) up to an
+	// empty name, the offset of each chunk in the file, then the chunks: the first scanline or the tile's coordinates and
+	// level, the size of the data, and the data, which holds each scanline's values for every channel in turn. Values
+	// are stored byte by byte through put(), but for the uncompressed float rows write() copies straight from planar
+	// images, which rely on the little-endian host binary_file.h requires.
+	const uint8_t magic[4] = { 0x76, 0x2f, 0x31, 0x01 };
+	const uint32_t version = 2;
+	const uint32_t tiledFlag = 0x200;
+	const uint32_t longNamesFlag = 0x400;	// names of up to 255 characters, rather than 31
+	const char* const components[Image::channels] = { "R", "G", "B" };
+
+	// OpenEXR's codes
+	const int32_t halfType = 1, floatType = 2;
+	const uint8_t noCompression = 0, zipCompression = 3;
+	const uint8_t increasingY = 0, randomY = 2;
+
+	template<size_t size> struct Bits;
+	template<> struct Bits<1> { typedef uint8_t Type; };
+	template<> struct Bits<2> { typedef uint16_t Type; };
+	template<> struct Bits<4> { typedef uint32_t Type; };
+	template<> struct Bits<8> { typedef uint64_t Type; };
+
+	// a number's bytes from the lowest, whatever the host's order
+	template<typename T>
+	void put(std::vector<uint8_t>& out, const T& value) {
+		typename Bits<sizeof(T)>::Type bits;
+		std::memcpy(&bits, &value, sizeof(T));
+		for (size_t i = 0; i < sizeof(T); ++i) {
+			out.push_back(static_cast<uint8_t>(bits >> (8 * i)));
+		}
+	}
+
+	bool writeOffsets(std::FILE* f, const std::vector<uint64_t>& offsets) {
+		std::vector<uint8_t> bytes;
+		bytes.reserve(offsets.size() * sizeof(uint64_t));
+		for (uint64_t offset : offsets) put(bytes, offset);
+		return writeValues(f, bytes.data(), bytes.size());
+	}
+
+	void putString(std::vector<uint8_t>& out, const std::string& s) {
+		out.insert(out.end(), s.begin(), s.end());
+		out.push_back(0);
+	}
+
+	void putAttribute(std::vector<uint8_t>& out, const std::string& name, const std::string& type, const std::vector<uint8_t>& value) {
+		putString(out, name);
+		putString(out, type);
+		put(out, static_cast<int32_t>(value.size()));
+		out.insert(out.end(), value.begin(), value.end());
+	}
+
+	template<typename T>
+	std::vector<uint8_t> bytesOf(std::initializer_list<T> values) {
+		std::vector<uint8_t> out;
+		for (const T& value : values) put(out, value);
+		return out;
+	}
+
+	// OpenEXR's ZIP compression: the bytes split into the even and the odd ones, each then stored as the difference from the
+	// one before, which turns the high bytes of smooth values into runs, then a zlib stream. The data stays as it is when
+	// that's no smaller, which readers tell by its size.
+	void zipCompress(const std::vector<uint8_t>& raw, std::vector<uint8_t>& out) {
+		const size_t size = raw.size(), half = (size + 1) / 2;
+		std::vector<uint8_t> predicted(size);
+		for (size_t i = 0; i < size; ++i) {
+			predicted[(i & 1) == 0 ? i / 2 : half + i / 2] = raw[i];
+		}
+		for (size_t i = size; i-- > 1;) {
+			predicted[i] = static_cast<uint8_t>(predicted[i] - predicted[i - 1] + 128);
+		}
+		out.clear();
+		zlibCompress(predicted.data(), static_cast<int>(size), out);
+		if (out.size() >= size) out = raw;
+	}
+}
+
+uint16_t floatToHalf(float value) {
+	uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	const uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+	const uint32_t magnitude = bits & 0x7fffffff;
+	if (magnitude >= 0x7f800000) {
+		// infinity, or NaN with a mantissa bit set
+		return static_cast<uint16_t>(sign | 0x7c00 | (magnitude > 0x7f800000 ? 0x200 : 0));
+	}
+	// 65520, halfway between the largest half and the next power of two, and above round to infinity
+	if (magnitude >= 0x477ff000) return static_cast<uint16_t>(sign | 0x7c00);
+	uint32_t half, rest, halfway;
+	if (magnitude >= 0x38800000) {
+		// normal: the exponent rebiased from 127 to 15, and the mantissa cut from 23 bits to 10
+		half = (magnitude - 0x38000000) >> 13;
+		rest = magnitude & 0x1fff;
+		halfway = 0x1000;
+	}
+	else {
+		// denormal, in units of 2^-24, from the mantissa with its implicit bit; values up to 2^-25 round to 0
+		if (magnitude <= 0x33000000) return sign;
+		const uint32_t mantissa = (magnitude & 0x7fffff) | 0x800000;
+		const int shift = 126 - static_cast<int>(magnitude >> 23);
+		half = mantissa >> shift;
+		rest = mantissa & ((1u << shift) - 1);
+		halfway = 1u << (shift - 1);
+	}
+	// to nearest even; a carry out of the mantissa correctly moves up to the next exponent
+	half += rest > halfway || (rest == halfway && (half & 1) != 0) ? 1 : 0;
+	return static_cast<uint16_t>(sign | half);
+}
+
+ExrWriter::ExrWriter(const std::string& file, const std::vector<Layer>& layers, Compression compression, int tileSize)
+	: m_file(file), m_compression(compression), m_tileSize(std::max(0, tileSize)) {
+	if (layers.empty()) return;
+	m_width = layers[0].image->width();
+	m_height = layers[0].image->height();
+	for (const Layer& layer : layers) {
+		if (layer.image->width() != m_width || layer.image->height() != m_height) return;
+		m_images.push_back(layer.image);
+	}
+	open(layers);
+}
+
+ExrWriter::ExrWriter(const std::string& file, int width, int height, const std::vector<Layer>& layers, Compression compression, int tileSize)
+	: m_file(file), m_width(width), m_height(height), m_compression(compression), m_tileSize(std::max(0, tileSize)) {
+	m_images.assign(layers.size(), nullptr);
+	open(layers);
+}
+
+void ExrWriter::open(const std::vector<Layer>& layers) {
+	if (layers.empty() || m_width <= 0 || m_height <= 0) return;
+	bool longNames = false;
+	for (size_t i = 0; i < layers.size(); ++i) {
+		const Layer& layer = layers[i];
+		for (int c = 0; c < Image::channels; ++c) {
+			Channel channel;
+			channel.name = layer.name.empty() ? components[c] : layer.name + "." + components[c];
+			channel.layer = static_cast<int>(i);
+			channel.component = c;
+			channel.type = layer.type;
+			if (channel.name.size() > 255) return;
+			longNames = longNames || channel.name.size() > 31;
+			m_channels.push_back(channel);
+		}
+	}
+	// readers expect the channels sorted, and the data follows their order
+	std::sort(m_channels.begin(), m_channels.end(), [](const Channel& a, const Channel& b) { return a.name < b.name; });
+	for (size_t i = 1; i < m_channels.size(); ++i) {
+		if (m_channels[i].name == m_channels[i - 1].name) return;
+	}
+
+	if (m_tileSize > 0) {
+		m_chunkColumns = (m_width + m_tileSize - 1) / m_tileSize;
+		m_chunkRows = (m_height + m_tileSize - 1) / m_tileSize;
+	}
+	else {
+		m_chunkColumns = 1;
+		m_chunkRows = (m_height + rowsPerBlock() - 1) / rowsPerBlock();
+	}
+	m_offsets.assign(static_cast<size_t>(m_chunkColumns) * m_chunkRows, 0);
+
+	std::vector<uint8_t> header(magic, magic + 4);
+	put(header, version | (m_tileSize > 0 ? tiledFlag : 0) | (longNames ? longNamesFlag : 0));
+	std::vector<uint8_t> channels;
+	for (const Channel& channel : m_channels) {
+		putString(channels, channel.name);
+		put(channels, channel.type == PixelType::Half ? halfType : floatType);
+		put(channels, static_cast<uint32_t>(0));	// not perceptually linear, and 3 reserved bytes
+		put(channels, static_cast<int32_t>(1));	// sampled at every pixel, in x and y
+		put(channels, static_cast<int32_t>(1));
+	}
+	channels.push_back(0);
+	putAttribute(header, "channels", "chlist", channels);
+	putAttribute(header, "compression", "compression", { m_compression == Compression::Zip ? zipCompression : noCompression });
+	const std::vector<uint8_t> window = bytesOf<int32_t>({ 0, 0, m_width - 1, m_height - 1 });
+	putAttribute(header, "dataWindow", "box2i", window);
+	putAttribute(header, "displayWindow", "box2i", window);
+	// chunks may come in any order in tiled files; writeChunks() keeps scanlines in order
+	putAttribute(header, "lineOrder", "lineOrder", { m_tileSize > 0 ? randomY : increasingY });
+	putAttribute(header, "pixelAspectRatio", "float", bytesOf<float>({ 1.f }));
+	putAttribute(header, "screenWindowCenter", "v2f", bytesOf<float>({ 0.f, 0.f }));
+	putAttribute(header, "screenWindowWidth", "float", bytesOf<float>({ 1.f }));
+	if (m_tileSize > 0) {
+		// a single level, as neither mipmaps nor ripmaps are written
+		std::vector<uint8_t> tiles = bytesOf<uint32_t>({ static_cast<uint32_t>(m_tileSize), static_cast<uint32_t>(m_tileSize) });
+		tiles.push_back(0);
+		putAttribute(header, "tiles", "tiledesc", tiles);
+	}
+	header.push_back(0);
+
+	m_out = std::fopen((m_file + ".tmp").c_str(), "wb");
+	if (m_out == nullptr) return;
+	m_tableOffset = header.size();
+	m_end = m_tableOffset + m_offsets.size() * sizeof(uint64_t);
+	m_ok = writeValues(m_out, header.data(), header.size()) && writeOffsets(m_out, m_offsets);
+}
+
+ExrWriter::~ExrWriter() {
+	if (m_out != nullptr) {
+		std::fclose(m_out);
+		std::remove((m_file + ".tmp").c_str());
+	}
+}
+
+PixelRect ExrWriter::chunkRect(int chunk) const {
+	const glm::ivec2 size(m_width, m_height);
+	if (m_tileSize > 0) {
+		const glm::ivec2 min = glm::ivec2(chunk % m_chunkColumns, chunk / m_chunkColumns) * m_tileSize;
+		return PixelRect(min, glm::min(min + m_tileSize, size));
+	}
+	const glm::ivec2 min(0, chunk * rowsPerBlock());
+	return PixelRect(min, glm::min(glm::ivec2(m_width, min.y + rowsPerBlock()), size));
+}
+
+int ExrWriter::chunkAt(int x, int y) const {
+	return m_tileSize > 0 ? y / m_tileSize * m_chunkColumns + x / m_tileSize : y / rowsPerBlock();
+}
+
+bool ExrWriter::direct(const std::vector<const Image*>& images) const {
+	if (m_compression != Compression::None) return false;
+	for (const Channel& channel : m_channels) {
+		if (channel.type != PixelType::Float || images[channel.layer]->layout() != Image::Layout::Planar) return false;
+	}
+	return true;
+}
+
+void ExrWriter::encode(int chunk, const std::vector<const Image*>& images, const glm::ivec2& origin, std::vector<uint8_t>& data) const {
+	const PixelRect rect = chunkRect(chunk);
+	std::vector<uint8_t> raw;
+	raw.reserve(static_cast<size_t>(rect.area()) * m_channels.size() * sizeof(float));
+	for (int y = rect.min.y; y < rect.max.y; ++y) {
+		for (const Channel& channel : m_channels) {
+			const Image& image = *images[channel.layer];
+			const float* in = image.channel(channel.component, y - origin.y);
+			const int stride = image.pixelStride();
+			for (int x = rect.min.x - origin.x; x < rect.max.x - origin.x; ++x) {
+				const float value = in[static_cast<size_t>(x) * stride];
+				if (channel.type == PixelType::Half) put(raw, floatToHalf(value));
+				else put(raw, value);
+			}
+		}
+	}
+	if (m_compression == Compression::Zip) zipCompress(raw, data);
+	else data.swap(raw);
+}
+
+bool ExrWriter::writeHeader(int chunk, uint32_t size) {
+	const PixelRect rect = chunkRect(chunk);
+	std::vector<uint8_t> header;
+	if (m_tileSize > 0) {
+		put(header, rect.min.x / m_tileSize);
+		put(header, rect.min.y / m_tileSize);
+		put(header, 0);	// level
+		put(header, 0);
+	}
+	else {
+		put(header, rect.min.y);
+	}
+	put(header, static_cast<int32_t>(size));
+	m_offsets[chunk] = m_end;
+	m_end += header.size() + size;
+	return writeValues(m_out, header.data(), header.size());
+}
+
+bool ExrWriter::write(int chunk, const std::vector<const Image*>& images, const glm::ivec2& origin) {
+	if (direct(images)) {
+		const PixelRect rect = chunkRect(chunk);
+		const size_t width = static_cast<size_t>(rect.max.x - rect.min.x);
+		const uint32_t size = static_cast<uint32_t>(static_cast<size_t>(rect.area()) * m_channels.size() * sizeof(float));
+		std::lock_guard<std::mutex> lock(m_mutex);
+		bool ok = m_ok && writeHeader(chunk, size);
+		for (int y = rect.min.y; ok && y < rect.max.y; ++y) {
+			for (const Channel& channel : m_channels) {
+				const float* row = images[channel.layer]->channel(channel.component, y - origin.y) + (rect.min.x - origin.x);
+				ok = ok && writeValues(m_out, row, width);
+			}
+		}
+		m_ok = ok;
+		return ok;
+	}
+
+	std::vector<uint8_t> data;
+	encode(chunk, images, origin, data);
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_ok = m_ok && writeHeader(chunk, static_cast<uint32_t>(data.size())) && writeValues(m_out, data.data(), data.size());
+	return m_ok;
+}
+
+bool ExrWriter::writeChunk(int chunk) {
+	if (chunk < 0 || chunk >= chunks() || m_images.front() == nullptr) return false;
+	return write(chunk, m_images, glm::ivec2(0));
+}
+
+bool ExrWriter::writeChunk(int chunk, const std::vector<const Image*>& pixels) {
+	if (chunk < 0 || chunk >= chunks() || pixels.size() != m_images.size()) return false;
+	const PixelRect rect = chunkRect(chunk);
+	for (const Image* image : pixels) {
+		if (image->width() < rect.max.x - rect.min.x || image->height() < rect.max.y - rect.min.y) return false;
+	}
+	return write(chunk, pixels, rect.min);
+}
+
+bool ExrWriter::writeChunks(int threadCount) {
+	if (m_images.empty() || m_images.front() == nullptr) return false;
+	if (direct(m_images)) {
+		// nothing to encode; the writes go one at a time anyway
+		for (int chunk = 0; chunk < chunks(); ++chunk) {
+			if (!writeChunk(chunk)) return false;
+		}
+		return true;
+	}
+	// threadCount chunks at a time, encoded in parallel and written in order
+	threadCount = std::max(1, threadCount);
+	std::vector<std::vector<uint8_t>> data(threadCount);
+	for (int first = 0; first < chunks(); first += threadCount) {
+		const int count = std::min(threadCount, chunks() - first);
+		parallelFor(count, threadCount, [&](int i) { encode(first + i, m_images, glm::ivec2(0), data[i]); });
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (int i = 0; i < count; ++i) {
+			m_ok = m_ok && writeHeader(first + i, static_cast<uint32_t>(data[i].size())) && writeValues(m_out, data[i].data(), data[i].size());
+		}
+		if (!m_ok) return false;
+	}
+	return true;
+}
+
+bool ExrWriter::finish() {
+	if (m_out == nullptr) return false;
+	bool ok = m_ok && std::find(m_offsets.begin(), m_offsets.end(), static_cast<uint64_t>(0)) == m_offsets.end()
+		&& seek(m_out, m_tableOffset) && writeOffsets(m_out, m_offsets);
+	ok = std::fclose(m_out) == 0 && ok;
+	m_out = nullptr;
+	const std::string temporary = m_file + ".tmp";
+	if (!ok) {
+		std::remove(temporary.c_str());
+		return false;
+	}
+	if (replaceFile(temporary, m_file)) return true;
+	std::remove(temporary.c_str());
+	return false;
+}
+
+bool writeExr(const std::string& file, const std::vector<ExrWriter::Layer>& layers, ExrWriter::Compression compression, int tileSize, int threadCount) {
+	ExrWriter writer(file, layers, compression, tileSize);
+	return writer.ok() && writer.writeChunks(threadCount) && writer.finish();
+}
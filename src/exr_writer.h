@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "image.h"
+#include "parallel.h"
+#include "tiles.h"
+
+// IEEE half-precision bits of value, rounded to nearest even; values beyond the largest half become infinities
+uint16_t floatToHalf(float value);
+
+// Writes images, as layers of linear half or float channels, to an OpenEXR file: in blocks of scanlines, or in tiles of
+// tileSize x tileSize pixels, either way uncompressed or with OpenEXR's ZIP compression (deflate after a byte predictor).
+//
+// Chunks (blocks or tiles) are written one at a time by writeChunk(), from several threads at once and in any order, so
+// that tiles can be written out as soon as they are rendered (writing one again replaces it); finish() then writes the
+// table that locates them. Only the chunk being written is copied, and not even that for uncompressed float layers of
+// planar images, whose rows go from the images to the file as they are.
+class ExrWriter {
+public:
+	enum class PixelType { Half, Float };
+	enum class Compression { None, Zip };
+	struct Layer {
+		std::string name;	// channels are name.R, name.G and name.B; just R, G and B for an empty name
+		const Image* image;
+		PixelType type;
+	};
+private:
+	struct Channel {
+		std::string name;
+		int layer;
+		int component;
+		PixelType type;
+	};
+	std::string m_file;
+	std::FILE* m_out = nullptr;
+	std::mutex m_mutex;
+	int m_width = 0;
+	int m_height = 0;
+	std::vector<const Image*> m_images;	// of each layer
+	std::vector<Channel> m_channels;	// in the file's order, sorted by name
+	Compression m_compression = Compression::None;
+	int m_tileSize = 0;	// 0 for scanlines
+	int m_chunkRows = 0;	// of scanlines, or of tiles
+	int m_chunkColumns = 0;
+	uint64_t m_tableOffset = 0;
+	uint64_t m_end = 0;
+	std::vector<uint64_t> m_offsets;	// of each chunk in the file, 0 until written
+	bool m_ok = false;
+
+	int rowsPerBlock() const { return m_compression == Compression::Zip ? 16 : 1; }
+	void open(const std::vector<Layer>& layers);
+	bool direct(const std::vector<const Image*>& images) const;
+	// the chunk's pixel data from images, with pixel (x, y) of the image at (x, y) - origin, compressed if the file is
+	void encode(int chunk, const std::vector<const Image*>& images, const glm::ivec2& origin, std::vector<uint8_t>& data) const;
+	bool writeHeader(int chunk, uint32_t size);
+	bool write(int chunk, const std::vector<const Image*>& images, const glm::ivec2& origin);
+public:
+	// Starts writing layers, whose images must all be the same size, to file; ok() is false if they aren't or the file can't
+	// be written. The file only appears once finish() succeeds.
+	ExrWriter(const std::string& file, const std::vector<Layer>& layers, Compression compression = Compression::Zip, int tileSize = 0);
+	// The same for layers of width x height pixels that aren't in memory as a whole, whose pixels come with each chunk
+	// instead (see writeChunk()); the layers' images are ignored
+	ExrWriter(const std::string& file, int width, int height, const std::vector<Layer>& layers, Compression compression = Compression::Zip, int tileSize = 0);
+	~ExrWriter();
+	ExrWriter(const ExrWriter&) = delete;
+	ExrWriter& operator=(const ExrWriter&) = delete;
+
+	bool ok() const { return m_ok; }
+	int chunks() const { return static_cast<int>(m_offsets.size()); }
+	// pixels of chunk, in scanline order
+	PixelRect chunkRect(int chunk) const;
+	// the chunk that holds pixel (x, y)
+	int chunkAt(int x, int y) const;
+	// Writes chunk from the pixels the images hold now; returns false if it can't be written. Safe to call from several
+	// threads, for different chunks.
+	bool writeChunk(int chunk);
+	// The same, from images that hold just the chunk's pixels, from their (0, 0): one per layer, in the layers' order
+	bool writeChunk(int chunk, const std::vector<const Image*>& pixels);
+	// Writes every chunk from the layers' images, encoded by up to threadCount threads at once, in order, which scanline files declare theirs to be in
+	bool writeChunks(int threadCount = defaultThreadCount());
+	// Writes the chunks' table and closes the file; returns false if a chunk is missing or any of the file couldn't be written
+	bool finish();
+};
+
+// Writes layers to an OpenEXR file with ExrWriter, encoding chunks in parallel; returns false if it can't be written
+bool writeExr(const std::string& file, const std::vector<ExrWriter::Layer>& layers, ExrWriter::Compression compression = ExrWriter::Compression::Zip,
+	int tileSize = 0, int threadCount = defaultThreadCount());
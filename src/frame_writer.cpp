@@ -0,0 +1,83 @@
+#include "frame_writer.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include "exr_writer.h"
+
+namespace {
+	bool hasExtension(const std::string& file, const std::string& extension) {
+		return file.size() >= extension.size() && file.compare(file.size() - extension.size(), extension.size(), extension) == 0;
+	}
+}
+
+FrameWriter::FrameWriter(int threadCount, int maxFrames, float gamma) : m_gamma(gamma), m_maxFrames(std::max(1, maxFrames)) {
+	threadCount = std::max(1, threadCount);
+	for (int t = 0; t < threadCount; ++t) {
+		m_threads.emplace_back([this]() { work(); });
+	}
+}
+
+FrameWriter::~FrameWriter() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_queued.notify_all();
+	// the threads empty the queue before they stop
+	for (std::thread& thread : m_threads) {
+		thread.join();
+	}
+}
+
+void FrameWriter::write(Image frame, const std::string& file) {
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_done.wait(lock, [this]() { return m_held < m_maxFrames; });
+		m_queue.push_back(Frame{ std::move(frame), file });
+		++m_held;
+	}
+	m_queued.notify_one();
+}
+
+bool FrameWriter::finish() {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_done.wait(lock, [this]() { return m_held == 0; });
+	return m_failures == 0;
+}
+
+int FrameWriter::failures() {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_failures;
+}
+
+void FrameWriter::work() {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	for (;;) {
+		m_queued.wait(lock, [this]() { return !m_queue.empty() || m_stopping; });
+		if (m_queue.empty()) return;
+		Frame frame = std::move(m_queue.front());
+		m_queue.pop_front();
+
+		lock.unlock();
+		const bool ok = encode(frame);
+		// the frame's memory goes before another frame is let in
+		frame.image = Image(0, 0);
+		lock.lock();
+
+		if (!ok) ++m_failures;
+		--m_held;
+		m_done.notify_all();
+	}
+}
+
+bool FrameWriter::encode(const Frame& frame) const {
+	// other frames keep the other threads busy, so each frame is encoded on its own thread
+	if (hasExtension(frame.file, ".pfm") || hasExtension(frame.file, ".exr")) {
+		const bool ok = hasExtension(frame.file, ".pfm") ? frame.image.writePfm(frame.file)
+			: writeExr(frame.file, { { "", &frame.image, ExrWriter::PixelType::Half } }, ExrWriter::Compression::Zip, 0, 1);
+		if (!ok) std::clog << "Can't write image: " << frame.file << '\n';
+		return ok;
+	}
+	return frame.image.write(frame.file, m_gamma, 1);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "image.h"
+
+// Writes the frames of an image sequence on threads of its own, so that the next frame renders while the last ones are
+// encoded and written. At most maxFrames frames are held at once, queued or being written: write() waits for room, which
+// bounds the memory the frames take when rendering outpaces the disk.
+//
+// The format follows each file's extension: .pfm and .exr (half floats, ZIP) are linear, anything else is an 8-bit PNG
+// encoded with gamma. Each frame is encoded by one thread; threadCount threads work on different frames.
+class FrameWriter {
+	struct Frame {
+		Image image;
+		std::string file;
+	};
+	float m_gamma;
+	int m_maxFrames;
+	std::deque<Frame> m_queue;
+	int m_held = 0;	// frames queued or being written
+	int m_failures = 0;
+	bool m_stopping = false;
+	std::mutex m_mutex;
+	std::condition_variable m_queued;	// a frame was queued, or the writer is stopping
+	std::condition_variable m_done;	// a frame was written
+	std::vector<std::thread> m_threads;
+
+	void work();
+	bool encode(const Frame& frame) const;
+public:
+	explicit FrameWriter(int threadCount = 1, int maxFrames = 2, float gamma = 2.2f);
+	~FrameWriter();	// waits for the frames still held
+	FrameWriter(const FrameWriter&) = delete;
+	FrameWriter& operator=(const FrameWriter&) = delete;
+
+	// Queues frame to be written to file, waiting while maxFrames frames are held; move the frame in to avoid a copy
+	void write(Image frame, const std::string& file);
+	// Waits until every frame written so far is in its file; returns false if any of them couldn't be written
+	bool finish();
+	// frames that couldn't be written, so far
+	int failures();
+};
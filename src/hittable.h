@@ -1,5 +1,8 @@
 #pragma once
 
+#include <cstdint>
+#include <functional>
+
 #include "common.h"
 #include "aabb.h"
 
@@ -12,8 +15,15 @@ public:
 		glm::vec3 point = glm::vec3(0.f);
 		glm::vec3 normal = glm::vec3(0.f);	// unit vector
 		glm::vec2 uv = glm::vec2(0.f);
+		// derivatives of the point with respect to uv, where the surface has them (zero otherwise)
+		glm::vec3 dpdu = glm::vec3(0.f);
+		glm::vec3 dpdv = glm::vec3(0.f);
+		// change of uv from one pixel to the next, for filtering texture lookups; set from ray differentials, zero without
+		glm::vec2 dUVdx = glm::vec2(0.f);
+		glm::vec2 dUVdy = glm::vec2(0.f);
 		float t = 0.f;
 		bool frontFace = false;
+		uint32_t objectId = 0;	// id() of the object hit
 
 		void setFrontFaceAndNormal(const Ray& ray, const glm::vec3& outwardNormal) {
 			frontFace = glm::dot(ray.direction(), outwardNormal) <= 0.f;
@@ -23,6 +33,25 @@ public:
 
 	virtual ~Hittable() = default;
 
+	// Identifies the object in auxiliary outputs (see AovBuffer); 0 unless set. A HittableList or Transform with an ID gives
+	// it to every hit on the objects it holds.
+	uint32_t id() const { return m_id; }
+	void setId(uint32_t id) { m_id = id; }
+
 	virtual bool hit(const Ray& ray, Interval tRange, HitRecord& hit) const = 0;
 	virtual AABox boundingBox() const = 0;
+
+	// Surface area; only needed for objects used as lights
+	virtual float area() const { return 0.f; }
+	// Pick a point uniformly on the surface from u in [0, 1)^2 (pdf with respect to area is 1 / area()).
+	// The sample's normal is the outward normal. Returns false if the object cannot be sampled.
+	virtual bool sampleSurface(const glm::vec2& u, HitRecord& sample) const { return false; }
+
+	// Receives one quad in world space: the points corner + a * side1 + b * side2 for a, b in [0, 1]
+	typedef std::function<void(const glm::vec3& corner, const glm::vec3& side1, const glm::vec3& side2, const std::shared_ptr<Material>& material)> QuadVisitor;
+	// Calls visit for every quad the object is made of; returns false if it also has other surfaces.
+	// Only needed for solvers that work on explicit geometry (e.g. RadiositySolver).
+	virtual bool forEachQuad(const QuadVisitor& visit) const { return false; }
+protected:
+	uint32_t m_id = 0;
 };
\ No newline at end of file
@@ -31,8 +31,38 @@ public:
 			}
 		}
 
+		if (hitAnything && m_id != 0) hit.objectId = m_id;
 		return hitAnything;
 	}
 
 	AABox boundingBox() const override { return m_bbox; }
+
+	float area() const override {
+		float total = 0.f;
+		for (const std::shared_ptr<Hittable>& object : m_objects) {
+			total += object->area();
+		}
+		return total;
+	}
+
+	// Picks an object in proportion to its area, then reuses the leftover of u.x to sample it
+	bool sampleSurface(const glm::vec2& u, HitRecord& sample) const override {
+		float target = u.x * area();
+		for (const std::shared_ptr<Hittable>& object : m_objects) {
+			float objectArea = object->area();
+			if (target < objectArea || &object == &m_objects.back()) {
+				float remapped = objectArea > 0.f ? glm::clamp(target / objectArea, 0.f, 0.99999994f) : 0.f;
+				return object->sampleSurface(glm::vec2(remapped, u.y), sample);
+			}
+			target -= objectArea;
+		}
+		return false;
+	}
+
+	bool forEachQuad(const QuadVisitor& visit) const override {
+		for (const std::shared_ptr<Hittable>& object : m_objects) {
+			if (!object->forEachQuad(visit)) return false;
+		}
+		return true;
+	}
 };
\ No newline at end of file
@@ -1,49 +1,116 @@
 #include "image.h"
 
+#include <cstdio>
+#include <iostream>
+
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include "stb_image_write.h"
+#include "pixel_conversion.h"
+#include "png_writer.h"
 
-Image::Image(std::string file, float gamma) {
-	stbi_ldr_to_hdr_gamma(gamma);
+void Image::allocate(int width, int height, Layout layout) {
+	m_width = glm::max(0, width);
+	m_height = glm::max(0, height);
+	m_layout = layout;
+	// whole cache lines per row, and so per plane
+	const int lineFloats = static_cast<int>(cacheLineSize / sizeof(float));
+	const bool planar = layout == Layout::Planar;
+	m_pixelStride = planar ? 1 : channels;
+	m_rowStride = (m_width * m_pixelStride + lineFloats - 1) / lineFloats * lineFloats;
+	m_planeStride = planar ? static_cast<size_t>(m_rowStride) * m_height : 1;
+	m_data.assign(static_cast<size_t>(m_rowStride) * m_height * (planar ? channels : 1), 0.f);
+}
 
-	int n;
-	float* rawData = stbi_loadf(file.c_str(), &m_width, &m_height, &n, m_channels);
-	if (rawData == nullptr) {
-		m_width = m_height = 0;
-		return;
+namespace {
+	// Stores the decoded RGB file in image, each value converted by convert
+	template<typename T, typename Convert>
+	void convertFile(Image& image, const T* decoded, int threadCount, const Convert& convert) {
+		const bool interleaved = image.layout() == Image::Layout::Interleaved;
+		convertPixels(decoded, image.width(), image.height(), Image::channels, 16, threadCount, convert, [&](int y, const T* row, const auto& convertValue) {
+			if (interleaved) {
+				// the file's rows are already in this layout
+				float* out = image.channel(0, y);
+				for (int i = 0; i < image.width() * Image::channels; ++i) {
+					out[i] = convertValue(row[i]);
+				}
+				return;
+			}
+			for (int c = 0; c < Image::channels; ++c) {
+				float* out = image.channel(c, y);
+				for (int x = 0; x < image.width(); ++x) {
+					out[x] = convertValue(row[x * Image::channels + c]);
+				}
+			}
+		});
 	}
-	m_data.resize(m_width * m_height * m_channels);
-	for (int x = 0; x < m_width; ++x) {
-		for (int y = 0; y < m_height; ++y) {
-			int dataIdx = y * m_width * m_channels + x * m_channels;
-			float r = rawData[dataIdx + 0];
-			float g = rawData[dataIdx + 1];
-			float b = rawData[dataIdx + 2];
-			set(x, y, glm::vec3(r, g, b));
-		}
+}
+
+Image::Image(std::string file, float gamma, Layout layout, int threadCount) {
+	allocate(0, 0, layout);
+	// 8- and 16-bit files are decoded as integers and linearized here: stbi_loadf() would reduce 16-bit files to 8 bits, and
+	// its gamma is a global setting that concurrent loads would race on
+	int width, height, n;
+	if (stbi_is_hdr(file.c_str())) {
+		float* decoded = stbi_loadf(file.c_str(), &width, &height, &n, channels);
+		if (decoded == nullptr) return;
+		allocate(width, height, layout);
+		convertFile(*this, decoded, threadCount, [](float value) { return value; });
+		stbi_image_free(decoded);
+	}
+	else if (stbi_is_16_bit(file.c_str())) {
+		uint16_t* decoded = stbi_load_16(file.c_str(), &width, &height, &n, channels);
+		if (decoded == nullptr) return;
+		allocate(width, height, layout);
+		convertFile(*this, decoded, threadCount, [gamma](uint16_t value) { return glm::pow(static_cast<float>(value) / 65535.f, gamma); });
+		stbi_image_free(decoded);
+	}
+	else {
+		uint8_t* decoded = stbi_load(file.c_str(), &width, &height, &n, channels);
+		if (decoded == nullptr) return;
+		allocate(width, height, layout);
+		convertFile(*this, decoded, threadCount, [gamma](uint8_t value) { return glm::pow(static_cast<float>(value) / 255.f, gamma); });
+		stbi_image_free(decoded);
 	}
 }
 
-void Image::write(std::string file, float gamma) const {
-	uint8_t* data = new uint8_t[m_width * m_height * m_channels];
-	for (int x = 0; x < m_width; ++x) {
-		for (int y = 0; y < m_height; ++y) {
-			glm::vec3 pixel = get(x, y);
-			pixel = gammaCorrect(pixel, gamma);
-			pixel = glm::clamp(pixel * 255.0f, 0.f, 255.f);
-
-			// stbi_write expects 8-bit values in left-to-right, top-to-bottom, RGB order
-			int dataIdx = y * m_width * m_channels + x * m_channels;
-			data[dataIdx + 0] = static_cast<uint8_t>(pixel.x);
-			data[dataIdx + 1] = static_cast<uint8_t>(pixel.y);
-			data[dataIdx + 2] = static_cast<uint8_t>(pixel.z);
+bool Image::write(std::string file, float gamma, int threadCount) const {
+	const GammaEncoder encode(gamma);
+	auto encodeRow = [this, &encode](int y, uint8_t* row) {
+		for (int c = 0; c < channels; ++c) {
+			const float* in = channel(c, y);
+			for (int x = 0; x < m_width; ++x) {
+				row[x * channels + c] = encode(in[static_cast<size_t>(x) * m_pixelStride]);
+			}
 		}
+	};
+	if (!writePng(file, m_width, m_height, encodeRow, threadCount)) {
+		std::clog << "Can't write image: " << file << '\n';
+		return false;
 	}
+	return true;
+}
 
-	stbi_write_png(file.c_str(), m_width, m_height, m_channels, data, m_width * m_channels);
-
-	delete[] data;
-}
\ No newline at end of file
+bool Image::writePfm(const std::string& file) const {
+	std::FILE* f = std::fopen(file.c_str(), "wb");
+	if (f == nullptr) return false;
+	// a negative scale for little-endian floats
+	bool ok = std::fprintf(f, "PF\n%d %d\n-1.0\n", m_width, m_height) > 0;
+	std::vector<float> interleaved(m_layout == Layout::Planar ? static_cast<size_t>(m_width) * channels : 0);
+	// rows go from the bottom up
+	for (int y = m_height - 1; ok && y >= 0; --y) {
+		const float* row = channel(0, y);
+		// interleaved rows are already the RGB floats PFM stores
+		if (m_layout == Layout::Planar) {
+			for (int x = 0; x < m_width; ++x) {
+				for (int c = 0; c < channels; ++c) {
+					interleaved[static_cast<size_t>(x) * channels + c] = channel(c, y)[x];
+				}
+			}
+			row = interleaved.data();
+		}
+		const size_t count = static_cast<size_t>(m_width) * channels;
+		ok = std::fwrite(row, sizeof(float), count, f) == count;
+	}
+	return std::fclose(f) == 0 && ok;
+}
@@ -1,44 +1,63 @@
 #pragma once
 
-#include <string>
 #include <cstdint>
 #include <vector>
 #include <string>
 
+#include "aligned.h"
 #include "common.h"
+#include "parallel.h"
 
 class Image {
+public:
+	// How the RGB floats are stored. Either way every row starts on a 64-byte cache line.
+	enum class Layout {
+		Interleaved,	// RGB RGB RGB ...: one cache line per lookup, best for textures
+		Planar,	// all R, then all G, then all B: each channel streams on its own, best for SIMD over whole images
+	};
+	static const int channels = 3;
 private:
 	int m_width = 0;
 	int m_height = 0;
-	const int m_channels = 3;
-	std::vector<glm::vec3> m_data;
-
-	int idx(int x, int y) const {
-		return y * m_width * m_channels + x * m_channels;
-	}
+	Layout m_layout = Layout::Interleaved;
+	int m_pixelStride = channels;	// floats from one pixel to the next within a channel
+	int m_rowStride = 0;	// floats from one row to the next, padded to whole cache lines
+	size_t m_planeStride = 1;	// floats from one channel of a pixel to the next
+	AlignedVector<float> m_data;
 
-	static glm::vec3 gammaCorrect(glm::vec3& pix, float gamma) {
-		float inverseGamma = 1.f / gamma;
-		return glm::pow(glm::max(pix, 0.f), glm::vec3(inverseGamma));
+	size_t idx(int x, int y) const {
+		return static_cast<size_t>(y) * m_rowStride + static_cast<size_t>(x) * m_pixelStride;
 	}
+	void allocate(int width, int height, Layout layout);
 public:
-	// read image from file; will be transformed into linear space using provided gamma
-	Image(std::string file, float gamma = 2.2f);
-	Image(int width, int height) : m_width(width), m_height(height) {
-		m_data.resize(m_width * m_height * m_channels);
+	// read image from file; will be transformed into linear space using provided gamma, by up to threadCount threads
+	Image(std::string file, float gamma = 2.2f, Layout layout = Layout::Interleaved, int threadCount = defaultThreadCount());
+	Image(int width, int height, Layout layout = Layout::Interleaved) {
+		allocate(width, height, layout);
 	}
 	int width() const { return m_width; }
 	int height() const { return m_height; }
-	const glm::vec3& get(int x, int y) const {
-		return m_data[idx(x, y)];
-	}
-	glm::vec3& get(int x, int y) {
-		return m_data[idx(x, y)];
+	Layout layout() const { return m_layout; }
+	glm::vec3 get(int x, int y) const {
+		const float* p = &m_data[idx(x, y)];
+		return glm::vec3(p[0], p[m_planeStride], p[2 * m_planeStride]);
 	}
 	void set(int x, int y, const glm::vec3& val) {
-		m_data[idx(x, y)] = val;
+		float* p = &m_data[idx(x, y)];
+		p[0] = val.x;
+		p[m_planeStride] = val.y;
+		p[2 * m_planeStride] = val.z;
 	}
-	// write image to file; will be encoded using the provided gamma value
-	void write(std::string file, float gamma = 2.2f) const;
-};
\ No newline at end of file
+
+	// Direct access for loops over rows: channel c of pixel (0, y), with channel c of pixel (x, y) pixelStride() * x floats
+	// further on. Rows of planar images are contiguous runs of one channel.
+	float* channel(int c, int y) { return &m_data[idx(0, y) + c * m_planeStride]; }
+	const float* channel(int c, int y) const { return &m_data[idx(0, y) + c * m_planeStride]; }
+	int pixelStride() const { return m_pixelStride; }
+
+	// write image to file as an 8-bit PNG; will be encoded using the provided gamma value, compressed by up to threadCount
+	// threads; returns false if it can't be written
+	bool write(std::string file, float gamma = 2.2f, int threadCount = defaultThreadCount()) const;
+	// write image to file as a PFM, linear and unclamped; returns false if it can't be written
+	bool writePfm(const std::string& file) const;
+};
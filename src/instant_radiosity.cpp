@@ -0,0 +1,285 @@
+#include "instant_radiosity.h"
+
+#include <algorithm>
+#include <queue>
+
+#include "parallel.h"
+#include "warp.h"
+
+namespace {
+	// Same offset Renderer::rayColor uses to avoid self-intersection
+	const float rayEpsilon = 1e-3f;
+
+	bool isBlack(const glm::vec3& c) {
+		return c.x == 0.f && c.y == 0.f && c.z == 0.f;
+	}
+
+	// Squared distance from p to the nearest point of box
+	float distance2(const glm::vec3& p, const AABox& box) {
+		float d2 = 0.f;
+		for (int comp = 0; comp < 3; ++comp) {
+			const Interval& interval = box.getInterval(comp);
+			float d = glm::max(glm::max(interval.min() - p[comp], p[comp] - interval.max()), 0.f);
+			d2 += d * d;
+		}
+		return d2;
+	}
+
+	// One node of the cut, ordered by its contribution bound
+	struct CutNode {
+		float bound = 0.f;
+		int node = -1;
+		glm::vec3 transfer = glm::vec3(0.f);	// of the node's representative
+		glm::vec3 estimate = glm::vec3(0.f);
+
+		bool operator<(const CutNode& other) const { return bound < other.bound; }
+	};
+}
+
+InstantRadiosityIntegrator::InstantRadiosityIntegrator(const Hittable& world, const HittableList& lights, const Settings& settings, int maxBounces, int threadCount) :
+	m_world(world), m_lights(lights), m_settings(settings), m_maxBounces(maxBounces) {
+	float clampDistance = settings.clampDistance;
+	if (clampDistance <= 0.f) {
+		const AABox bounds = world.boundingBox();
+		clampDistance = bounds.getInterval(bounds.longestAxis()).size() / 32.f;
+	}
+	m_clampDistance2 = clampDistance * clampDistance;
+
+	// one list per path keeps the VPL order independent of thread scheduling
+	std::vector<std::vector<VPL>> pathVPLs(glm::max(settings.lightPaths, 0));
+	parallelFor(static_cast<int>(pathVPLs.size()), threadCount, [&](int i) {
+		IndependentSampler sampler;
+		traceLightPath(sampler, pathVPLs[i]);
+	});
+	for (const std::vector<VPL>& vpls : pathVPLs) {
+		m_vpls.insert(m_vpls.end(), vpls.begin(), vpls.end());
+	}
+
+	if (m_vpls.empty()) return;
+	std::vector<int> indices(m_vpls.size());
+	for (size_t i = 0; i < indices.size(); ++i) {
+		indices[i] = static_cast<int>(i);
+	}
+	m_nodes.reserve(2 * m_vpls.size() - 1);
+	IndependentSampler sampler;
+	buildTree(indices, 0, indices.size(), sampler);
+}
+
+void InstantRadiosityIntegrator::traceLightPath(Sampler& sampler, std::vector<VPL>& vpls) const {
+	const std::vector<std::shared_ptr<Hittable>>& lights = m_lights.objects();
+	if (lights.empty()) return;
+
+	// pick a light uniformly, then a point on it uniformly by area
+	int lightIndex = glm::min(static_cast<int>(sampler.getLight1D() * lights.size()), static_cast<int>(lights.size()) - 1);
+	const Hittable& light = *lights[lightIndex];
+	float area = light.area();
+
+	Hittable::HitRecord origin;
+	if (area <= 0.f || !light.sampleSurface(sampler.get2D(), origin)) return;
+
+	glm::vec3 emitted = origin.material->emitted(origin.uv, origin.point);
+	if (isBlack(emitted)) return;
+
+	// each path carries 1 / lightPaths of the emitted power
+	float scale = static_cast<float>(lights.size()) * area / static_cast<float>(m_settings.lightPaths);
+
+	VPL emitter;
+	emitter.point = origin.point;
+	emitter.normal = origin.normal;
+	emitter.intensity = emitted * scale;
+	emitter.twoSided = true;
+	vpls.push_back(emitter);
+
+	// emit from a random side, cosine-weighted about that side's normal: cosine / density = 2 pi
+	glm::vec3 normal = sampler.get1D() < 0.5f ? -origin.normal : origin.normal;
+	glm::vec3 direction = fromLocal(cosineHemisphere(sampler.get2D()), normal);
+	Ray ray(origin.point, direction);
+	glm::vec3 beta = emitted * scale * 2.f * pi;
+
+	// a VPL found after this many bounces lights camera hits through one more, so stop one short of maxBounces
+	for (int bounce = 1; bounce < m_maxBounces; ++bounce) {
+		Hittable::HitRecord hit;
+		if (!m_world.hit(ray, Interval(rayEpsilon, infinity), hit))
+			break;
+
+		const Material& material = *hit.material;
+		if (material.isDiffuse()) {
+			VPL vpl;
+			vpl.point = hit.point;
+			vpl.normal = hit.normal;
+			vpl.intensity = beta * material.evaluate(hit, hit.normal, hit.normal);
+			vpls.push_back(vpl);
+		}
+
+		glm::vec3 attenuation;
+		Ray scatteredRay;
+		if (!material.scatter(ray, hit, sampler, attenuation, scatteredRay))
+			break;
+		if (glm::dot(scatteredRay.direction(), scatteredRay.direction()) < 1e-12f)
+			break;
+		beta *= attenuation;
+		if (isBlack(beta))
+			break;
+		ray = scatteredRay;
+	}
+}
+
+int InstantRadiosityIntegrator::buildTree(std::vector<int>& indices, size_t start, size_t end, Sampler& sampler) {
+	int nodeIndex = static_cast<int>(m_nodes.size());
+	m_nodes.push_back(Node());
+
+	if (end - start == 1) {
+		const VPL& vpl = m_vpls[indices[start]];
+		Node& leaf = m_nodes[nodeIndex];
+		leaf.bounds.expand(vpl.point);
+		leaf.intensity = vpl.intensity;
+		leaf.representative = indices[start];
+		return nodeIndex;
+	}
+
+	// split at the median along the longest axis, as BVHNode does
+	AABox bounds;
+	for (size_t i = start; i < end; ++i) {
+		bounds.expand(m_vpls[indices[i]].point);
+	}
+	int axis = bounds.longestAxis();
+	size_t mid = start + (end - start) / 2;
+	std::nth_element(indices.begin() + start, indices.begin() + mid, indices.begin() + end, [&](int a, int b) {
+		return m_vpls[a].point[axis] < m_vpls[b].point[axis];
+	});
+
+	int left = buildTree(indices, start, mid, sampler);
+	int right = buildTree(indices, mid, end, sampler);
+
+	// the representative is one of the children's, picked in proportion to their intensity
+	const Node& leftNode = m_nodes[left];
+	const Node& rightNode = m_nodes[right];
+	float leftWeight = luminance(leftNode.intensity);
+	float totalWeight = leftWeight + luminance(rightNode.intensity);
+
+	Node& node = m_nodes[nodeIndex];
+	node.bounds = bounds;
+	node.intensity = leftNode.intensity + rightNode.intensity;
+	node.representative = (totalWeight <= 0.f || sampler.get1D() * totalWeight < leftWeight) ? leftNode.representative : rightNode.representative;
+	node.children[0] = left;
+	node.children[1] = right;
+	return nodeIndex;
+}
+
+glm::vec3 InstantRadiosityIntegrator::radiance(const Ray& ray, Sampler& sampler, AovSample* firstHit) const {
+	glm::vec3 color = glm::vec3(0.f);
+	glm::vec3 beta = glm::vec3(1.f);
+	Ray current = ray;
+
+	// follow specular bounces to the first diffuse surface, which the VPLs light
+	for (int bounce = 0; bounce <= m_maxBounces; ++bounce) {
+		Hittable::HitRecord hit;
+		if (!m_world.hit(current, Interval(rayEpsilon, infinity), hit))
+			break;
+		if (bounce == 0 && firstHit != nullptr) *firstHit = AovSample(current, hit);
+
+		const Material& material = *hit.material;
+		color += beta * material.emitted(hit.uv, hit.point);
+		if (material.isDiffuse()) {
+			color += beta * gather(hit, -glm::normalize(current.direction()));
+			break;
+		}
+		if (!material.isSpecular())
+			break;
+
+		glm::vec3 attenuation;
+		Ray scatteredRay;
+		if (!material.scatter(current, hit, sampler, attenuation, scatteredRay))
+			break;
+		beta *= attenuation;
+		current = scatteredRay;
+	}
+	return color;
+}
+
+glm::vec3 InstantRadiosityIntegrator::gather(const Hittable::HitRecord& hit, const glm::vec3& wo) const {
+	if (m_nodes.empty()) return glm::vec3(0.f);
+
+	// diffuse BSDFs are the same in every direction above the surface
+	float bsdfBound = luminance(hit.material->evaluate(hit, wo, hit.normal));
+
+	std::priority_queue<CutNode> cut;
+	glm::vec3 total = glm::vec3(0.f);
+	auto addToCut = [&](int nodeIndex, const glm::vec3* representativeTransfer) {
+		const Node& node = m_nodes[nodeIndex];
+		CutNode entry;
+		entry.node = nodeIndex;
+		entry.transfer = representativeTransfer ? *representativeTransfer : transfer(hit, wo, m_vpls[node.representative]);
+		entry.estimate = entry.transfer * node.intensity;
+		total += entry.estimate;
+		// leaves are exact and never refined
+		if (node.children[0] >= 0) {
+			entry.bound = contributionBound(hit, bsdfBound, node);
+			cut.push(entry);
+		}
+	};
+
+	addToCut(0, nullptr);
+	int cutSize = 1;
+	while (!cut.empty() && cutSize < m_settings.maxCutSize) {
+		CutNode worst = cut.top();
+		if (worst.bound <= m_settings.errorThreshold * luminance(total))
+			break;
+		cut.pop();
+		total -= worst.estimate;
+
+		// one child shares the parent's representative, so its transfer is already known
+		const Node& node = m_nodes[worst.node];
+		for (int child : node.children) {
+			bool shared = m_nodes[child].representative == node.representative;
+			addToCut(child, shared ? &worst.transfer : nullptr);
+		}
+		++cutSize;
+	}
+	return glm::max(total, 0.f);
+}
+
+glm::vec3 InstantRadiosityIntegrator::transfer(const Hittable::HitRecord& hit, const glm::vec3& wo, const VPL& vpl) const {
+	glm::vec3 d = vpl.point - hit.point;
+	float dist2 = glm::dot(d, d);
+	if (dist2 == 0.f) return glm::vec3(0.f);
+	glm::vec3 wi = d / glm::sqrt(dist2);
+
+	float cosReceiver = glm::dot(wi, hit.normal);
+	float cosLight = -glm::dot(wi, vpl.normal);
+	if (vpl.twoSided) cosLight = glm::abs(cosLight);
+	if (cosReceiver <= 0.f || cosLight <= 0.f) return glm::vec3(0.f);
+
+	glm::vec3 f = hit.material->evaluate(hit, wo, wi);
+	if (isBlack(f)) return glm::vec3(0.f);
+	if (!unoccluded(hit.point, vpl.point)) return glm::vec3(0.f);
+	return f * (cosReceiver * cosLight / glm::max(dist2, m_clampDistance2));
+}
+
+float InstantRadiosityIntegrator::contributionBound(const Hittable::HitRecord& hit, float bsdfBound, const Node& node) const {
+	// the receiver cosine is at most (largest height of the box above the surface) / (distance to the box)
+	float maxHeight = -infinity;
+	for (int corner = 0; corner < 8; ++corner) {
+		glm::vec3 p(
+			(corner & 1) ? node.bounds.x().max() : node.bounds.x().min(),
+			(corner & 2) ? node.bounds.y().max() : node.bounds.y().min(),
+			(corner & 4) ? node.bounds.z().max() : node.bounds.z().min()
+		);
+		maxHeight = glm::max(maxHeight, glm::dot(p - hit.point, hit.normal));
+	}
+	if (maxHeight <= 0.f) return 0.f;
+
+	float dist2 = distance2(hit.point, node.bounds);
+	float cosBound = dist2 > 0.f ? glm::min(maxHeight / glm::sqrt(dist2), 1.f) : 1.f;
+	// the light's cosine is at most 1
+	float geometryBound = cosBound / glm::max(dist2, m_clampDistance2);
+	return bsdfBound * geometryBound * luminance(node.intensity);
+}
+
+bool InstantRadiosityIntegrator::unoccluded(const glm::vec3& a, const glm::vec3& b) const {
+	glm::vec3 d = b - a;
+	float dist = glm::length(d);
+	if (dist <= 2.f * rayEpsilon) return true;
+	Hittable::HitRecord hit;
+	return !m_world.hit(Ray(a, d / dist), Interval(rayEpsilon, dist - rayEpsilon), hit);
+}
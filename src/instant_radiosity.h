@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vector>
+
+#include "common.h"
+#include "aabb.h"
+#include "aov.h"
+#include "hittable.h"
+#include "hittable_list.h"
+#include "material.h"
+#include "sampler.h"
+
+// Instant radiosity (Keller 1997) with lightcuts (Walter et al. 2005).
+// Light paths are traced once up front; every point they start from or reach on a diffuse surface becomes a virtual
+// point light (VPL). Camera rays follow specular bounces to the first diffuse hit, which is lit by the VPLs.
+// VPLs are grouped into a binary tree; each node stands in for its VPLs with one representative VPL, and shading
+// picks a cut through the tree by refining the node with the largest error bound until every bound is below
+// a fraction of the total. Geometry terms are clamped so that VPLs close to the shading point do not cause spikes,
+// which loses some energy in corners.
+// The result has no noise beyond pixel antialiasing, but is only suited to diffuse scenes.
+class InstantRadiosityIntegrator {
+public:
+	struct Settings {
+		int lightPaths = 4096;
+		float clampDistance = 0.f;	// distances below this are clamped in geometry terms; 0 picks 1/32 of the scene's longest side
+		float errorThreshold = 0.02f;	// refine the cut until every node's error bound is below this fraction of the estimate
+		int maxCutSize = 512;
+	};
+
+	struct VPL {
+		glm::vec3 point = glm::vec3(0.f);
+		glm::vec3 normal = glm::vec3(0.f);
+		glm::vec3 intensity = glm::vec3(0.f);	// contribution = receiver BSDF * intensity * geometry term
+		bool twoSided = false;	// emitters shine from both sides, like DiffuseEmissive
+	};
+
+	InstantRadiosityIntegrator(const Hittable& world, const HittableList& lights, const Settings& settings, int maxBounces, int threadCount);
+
+	// Radiance arriving along ray; firstHit is set to the surface ray hits, if any, when not null
+	glm::vec3 radiance(const Ray& ray, Sampler& sampler, AovSample* firstHit = nullptr) const;
+
+	const std::vector<VPL>& vpls() const { return m_vpls; }
+private:
+	struct Node {
+		AABox bounds;
+		glm::vec3 intensity = glm::vec3(0.f);	// sum over the node's VPLs
+		int representative = -1;	// VPL index
+		int children[2] = { -1, -1 };	// node indices; -1 for leaves
+	};
+
+	const Hittable& m_world;
+	const HittableList& m_lights;
+	Settings m_settings;
+	int m_maxBounces = 10;
+	float m_clampDistance2 = 0.f;
+
+	std::vector<VPL> m_vpls;
+	std::vector<Node> m_nodes;	// root first
+
+	void traceLightPath(Sampler& sampler, std::vector<VPL>& vpls) const;
+	int buildTree(std::vector<int>& indices, size_t start, size_t end, Sampler& sampler);
+
+	// Receiver BSDF times clamped geometry term times visibility, for one VPL; multiply by an intensity for radiance
+	glm::vec3 transfer(const Hittable::HitRecord& hit, const glm::vec3& wo, const VPL& vpl) const;
+	// Upper bound on the luminance a node's VPLs can contribute, given a bound on the receiver BSDF's luminance
+	float contributionBound(const Hittable::HitRecord& hit, float bsdfBound, const Node& node) const;
+	bool unoccluded(const glm::vec3& a, const glm::vec3& b) const;
+	glm::vec3 gather(const Hittable::HitRecord& hit, const glm::vec3& wo) const;
+};
@@ -2,17 +2,37 @@
 
 #include "material.h"
 #include "texture.h"
+#include "warp.h"
 
 class Lambertian : public Material {
-	std::shared_ptr<Texture> m_texture = nullptr;
+	std::shared_ptr<Texture> m_texture = nullptr;	// null for a solid color
+	TextureProgram m_albedo;	// m_texture, compiled
 public:
-	Lambertian(glm::vec3 albedo) : m_texture(std::make_shared<SolidColorTexture>(albedo)) {}
-	Lambertian(std::shared_ptr<Texture> texture) : m_texture(texture) {}
+	Lambertian(glm::vec3 albedo) : m_albedo(albedo) {}
+	Lambertian(std::shared_ptr<Texture> texture) : m_texture(texture), m_albedo(*texture) {}
 
-	bool scatter(const Ray& ray, const Hittable::HitRecord& hit, glm::vec3& attenuation, Ray& scatteredRay) const override {
-		glm::vec3 scatterDirection = hit.normal + randomOnSphere();
+	bool scatter(const Ray& ray, const Hittable::HitRecord& hit, Sampler& sampler, glm::vec3& attenuation, Ray& scatteredRay) const override {
+		glm::vec3 scatterDirection = fromLocal(cosineHemisphere(sampler.getDirection2D()), hit.normal);
 		scatteredRay = Ray(hit.point, scatterDirection);
-		attenuation = m_texture->value(hit.uv, hit.point);
+		attenuation = m_albedo.filteredValue(hit.uv, hit.point, hit.dUVdx, hit.dUVdy);
+		return true;
+	}
+
+	glm::vec3 albedo(const Hittable::HitRecord& hit) const override {
+		return m_albedo.filteredValue(hit.uv, hit.point, hit.dUVdx, hit.dUVdy);
+	}
+
+	glm::vec3 evaluate(const Hittable::HitRecord& hit, const glm::vec3& wo, const glm::vec3& wi) const override {
+		if (glm::dot(wi, hit.normal) <= 0.f) return glm::vec3(0.f);
+		return m_albedo.value(hit.uv, hit.point) / pi;
+	}
+
+	// scatter() samples the cosine-weighted hemisphere
+	float scatterPdf(const Hittable::HitRecord& hit, const glm::vec3& wo, const glm::vec3& wi) const override {
+		return glm::max(glm::dot(wi, hit.normal), 0.f) / pi;
+	}
+
+	bool isDiffuse() const override {
 		return true;
 	}
 };
\ No newline at end of file
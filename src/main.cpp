@@ -1,5 +1,6 @@
 #include <iostream>
 #include <limits>
+#include <string>
 
 #include "common.h"
 #include "image.h"
@@ -14,6 +15,7 @@
 #include "emissive.h"
 #include "bvh.h"
 #include "transform.h"
+#include "tiled_texture.h"
 
 // Creates the 3D box (six sides) that contains the two opposite vertices a & b.
 std::shared_ptr<HittableList> makeBox(const glm::vec3& a, const glm::vec3& b, std::shared_ptr<Material> mat)
@@ -67,6 +69,16 @@ HittableList cornellBoxScene() {
     return world;
 }
 
+// Same light as in cornellBoxScene, for integrators that sample lights directly
+HittableList cornellBoxSceneLights() {
+    HittableList lights;
+
+    auto light = std::make_shared<DiffuseEmissive>(glm::vec3(15.f, 15.f, 15.f));
+    lights.add(std::make_shared<Quad>(glm::vec3(343.f, 554.f, 332.f), glm::vec3(-130.f, 0.f, 0.f), glm::vec3(0.f, 0.f, -105.f), light));
+
+    return lights;
+}
+
 Camera cornellBoxSceneCamera(const glm::ivec2& imageSize) {
     glm::vec3 lookFrom(278.f, 278.f, -800.f);
     glm::vec3 lookAt(278.f, 278.f, 0.f);
@@ -128,7 +140,9 @@ Camera testQuadSceneCamera(const glm::ivec2& imageSize) {
 HittableList testEarthScene() {
     HittableList world;
 
-    std::shared_ptr<Texture> earthTexture = std::make_shared<ImageTexture>("C:\\Users\\markf\\GitHub\\raytracer\\data\\earthmap.jpg");
+    // scenes with more image textures list them all here, to be loaded at once
+    std::vector<std::shared_ptr<ImageTexture>> textures = loadImageTextures({ "C:\\Users\\markf\\GitHub\\raytracer\\data\\earthmap.jpg" });
+    std::shared_ptr<Texture> earthTexture = textures[0];
     auto earthMaterial = std::make_shared<Lambertian>(earthTexture);
     auto globe = std::make_shared<Sphere>(glm::vec3(0.f, 0.f, 0.f), 2.f, earthMaterial);
 
@@ -249,9 +263,15 @@ Camera finalSceneCamera(const glm::ivec2& imageSize) {
     return Camera(frame, projection);
 }
 
-int main() {
+int main(int argc, char** argv) {
+	// raytracer --tile-texture <image> <output>: converts an image file for TiledImageTexture
+	if (argc == 4 && std::string(argv[1]) == "--tile-texture") {
+		return convertToTiledTexture(argv[2], argv[3]) ? 0 : 1;
+	}
+
     glm::ivec2 imageSize = glm::ivec2(300, 300);
     HittableList world = cornellBoxScene();
+    HittableList lights = cornellBoxSceneLights();
     Camera camera = cornellBoxSceneCamera(imageSize);
     Image img(imageSize.x, imageSize.y);
 
@@ -259,7 +279,7 @@ int main() {
     bvhWorld.add(std::make_shared<BVHNode>(world.objects(), 0, world.objects().size()));
 	
 	Renderer renderer;
-	renderer.render(bvhWorld, camera, img);
+	renderer.render(bvhWorld, camera, img, lights);
 
 	img.write("C:\\Users\\markf\\GitHub\\raytracer\\render\\test.png");
 }
\ No newline at end of file
@@ -0,0 +1,111 @@
+#include "mapped_framebuffer.h"
+
+#include <cstdio>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace {
+	size_t pageSize() {
+#ifdef _WIN32
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		return info.dwPageSize;
+#else
+		return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+	}
+}
+
+MappedFramebuffer::MappedFramebuffer(const std::string& file, int width, int height, int blockSize, const glm::ivec2& blockOrigin)
+	: m_file(file), m_width(glm::max(0, width)), m_height(glm::max(0, height)), m_blockSize(glm::max(1, blockSize)) {
+	// in [0, blockSize), also for origins left of or above the image
+	m_blockShift = glm::ivec2((-blockOrigin.x % m_blockSize + m_blockSize) % m_blockSize, (-blockOrigin.y % m_blockSize + m_blockSize) % m_blockSize);
+	m_blocksPerRow = (m_width + m_blockShift.x + m_blockSize - 1) / m_blockSize;
+	const int blockRows = (m_height + m_blockShift.y + m_blockSize - 1) / m_blockSize;
+	const size_t page = pageSize();
+	m_blockBytes = (static_cast<size_t>(m_blockSize) * m_blockSize * sizeof(Pixel) + page - 1) / page * page;
+	if (m_width == 0 || m_height == 0) return;
+	const uint64_t size = static_cast<uint64_t>(m_blocksPerRow) * blockRows * m_blockBytes;
+	if (size > SIZE_MAX) return;
+	m_size = static_cast<size_t>(size);
+
+	// a new file reads as zeros, which are empty pixels, without being written
+#ifdef _WIN32
+	HANDLE handle = CreateFileA(m_file.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (handle == INVALID_HANDLE_VALUE) {
+		close();
+		return;
+	}
+	m_fileHandle = handle;
+	m_mapping = CreateFileMappingA(handle, nullptr, PAGE_READWRITE, static_cast<DWORD>(size >> 32), static_cast<DWORD>(size), nullptr);
+	if (m_mapping == nullptr) {
+		close();
+		return;
+	}
+	m_data = static_cast<uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, m_size));
+#else
+	m_fd = open(m_file.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (m_fd < 0) {
+		close();
+		return;
+	}
+	if (ftruncate(m_fd, static_cast<off_t>(size)) != 0) {
+		close();
+		return;
+	}
+	void* data = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+	m_data = data != MAP_FAILED ? static_cast<uint8_t*>(data) : nullptr;
+#endif
+	if (m_data == nullptr) close();
+}
+
+MappedFramebuffer::~MappedFramebuffer() {
+	close();
+}
+
+void MappedFramebuffer::close() {
+#ifdef _WIN32
+	const bool created = m_fileHandle != nullptr;
+	if (m_data != nullptr) UnmapViewOfFile(m_data);
+	if (m_mapping != nullptr) CloseHandle(m_mapping);
+	if (m_fileHandle != nullptr) CloseHandle(m_fileHandle);
+	m_mapping = nullptr;
+	m_fileHandle = nullptr;
+#else
+	const bool created = m_fd >= 0;
+	if (m_data != nullptr) munmap(m_data, m_size);
+	if (m_fd >= 0) ::close(m_fd);
+	m_fd = -1;
+#endif
+	m_data = nullptr;
+	m_size = 0;
+	if (created) std::remove(m_file.c_str());
+}
+
+void MappedFramebuffer::release(const PixelRect& area) {
+	const PixelRect clipped = area.intersect(PixelRect(glm::ivec2(0), glm::ivec2(m_width, m_height)));
+	if (!valid() || clipped.empty()) return;
+	const glm::ivec2 first = (clipped.min + m_blockShift) / m_blockSize;
+	const glm::ivec2 last = (clipped.max - 1 + m_blockShift) / m_blockSize;
+	// each row of blocks is one contiguous range
+	for (int blockY = first.y; blockY <= last.y; ++blockY) {
+		uint8_t* begin = m_data + (static_cast<size_t>(blockY) * m_blocksPerRow + first.x) * m_blockBytes;
+		const size_t bytes = static_cast<size_t>(last.x - first.x + 1) * m_blockBytes;
+#ifdef _WIN32
+		// unlocking pages that aren't locked takes them out of the working set
+		FlushViewOfFile(begin, bytes);
+		VirtualUnlock(begin, bytes);
+#else
+		msync(begin, bytes, MS_ASYNC);
+		madvise(begin, bytes, MADV_DONTNEED);
+#endif
+	}
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "common.h"
+#include "image.h"
+#include "tiles.h"
+
+// Running per-pixel sums of samples, like AccumulationBuffer, kept in a memory-mapped file instead of memory, for images
+// larger than memory. Pixels are stored in square blocks, each contiguous and padded to whole pages, so that once the tile a
+// block matches is done, release() can write it back and drop it from memory without touching its neighbors: memory use
+// then follows the tiles being rendered, not the image, and the rest lives in the file and the OS's page cache.
+//
+// The file is sparse until written, and removed when the framebuffer is destroyed. Not thread safe: each pixel must be
+// written by one thread at a time.
+class MappedFramebuffer {
+	struct Pixel {
+		glm::vec3 sum = glm::vec3(0.f);
+		uint32_t count = 0;
+	};
+	std::string m_file;
+	int m_width = 0;
+	int m_height = 0;
+	int m_blockSize = 16;
+	glm::ivec2 m_blockShift = glm::ivec2(0);	// added to pixel coordinates so that blocks start at multiples of blockSize
+	int m_blocksPerRow = 0;
+	size_t m_blockBytes = 0;	// from one block to the next, whole pages
+	uint8_t* m_data = nullptr;
+	size_t m_size = 0;
+#ifdef _WIN32
+	void* m_fileHandle = nullptr;
+	void* m_mapping = nullptr;
+#else
+	int m_fd = -1;
+#endif
+
+	Pixel& pixel(int x, int y) const {
+		x += m_blockShift.x;
+		y += m_blockShift.y;
+		const int blockX = x / m_blockSize, blockY = y / m_blockSize;
+		uint8_t* block = m_data + (static_cast<size_t>(blockY) * m_blocksPerRow + blockX) * m_blockBytes;
+		return reinterpret_cast<Pixel*>(block)[(y - blockY * m_blockSize) * m_blockSize + (x - blockX * m_blockSize)];
+	}
+	void close();
+public:
+	// Maps a new file of width x height pixels, with the block grid through blockOrigin, e.g. the corner of the area split
+	// into tiles of blockSize pixels; valid() is false if it can't be created
+	MappedFramebuffer(const std::string& file, int width, int height, int blockSize = 16, const glm::ivec2& blockOrigin = glm::ivec2(0));
+	~MappedFramebuffer();
+	MappedFramebuffer(const MappedFramebuffer&) = delete;
+	MappedFramebuffer& operator=(const MappedFramebuffer&) = delete;
+
+	bool valid() const { return m_data != nullptr; }
+	int width() const { return m_width; }
+	int height() const { return m_height; }
+	// bytes of the file, most of which need never be in memory at once
+	size_t size() const { return m_size; }
+
+	void add(int x, int y, const glm::vec3& sample) {
+		Pixel& p = pixel(x, y);
+		p.sum += sample;
+		++p.count;
+	}
+	int count(int x, int y) const { return static_cast<int>(pixel(x, y).count); }
+	glm::vec3 mean(int x, int y) const {
+		const Pixel& p = pixel(x, y);
+		return p.count > 0 ? p.sum / static_cast<float>(p.count) : glm::vec3(0.f);
+	}
+
+	// Writes the means of area's pixels to tile, from its (0, 0)
+	void resolveTile(Image& tile, const PixelRect& area) const {
+		for (int y = area.min.y; y < area.max.y; ++y) {
+			for (int x = area.min.x; x < area.max.x; ++x) {
+				tile.set(x - area.min.x, y - area.min.y, mean(x, y));
+			}
+		}
+	}
+
+	// Starts writing back the blocks that area overlaps and drops them from memory; they are read back from the file (or
+	// the page cache) if used again
+	void release(const PixelRect& area);
+};
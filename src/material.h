@@ -1,15 +1,50 @@
 #pragma once
 
 #include "hittable.h"
+#include "ray_differential.h"
+#include "sampler.h"
 
 class Material {
 public:
 	virtual ~Material() = default;
 
-	virtual bool scatter(const Ray& ray, const Hittable::HitRecord& hit, glm::vec3& attenuation, Ray& scatteredRay) const {
+	// All randomness must come from sampler
+	virtual bool scatter(const Ray& ray, const Hittable::HitRecord& hit, Sampler& sampler, glm::vec3& attenuation, Ray& scatteredRay) const {
 		return false;
 	}
 	virtual glm::vec3 emitted(const glm::vec2& uv, const glm::vec3& p) const {
 		return glm::vec3(0.f);
 	}
+	// Color of the surface for auxiliary outputs such as denoiser guides (see AovBuffer): the reflectance of diffuse and
+	// glossy surfaces, white for clear ones
+	virtual glm::vec3 albedo(const Hittable::HitRecord& hit) const {
+		return glm::vec3(0.f);
+	}
+	// Carries the differential of ray over to scatteredRay, made by scatter(); returns false if the scattering is not
+	// specular enough for differentials to describe, and lookups along the rest of the path are then not filtered
+	virtual bool scatterDifferential(const Ray& ray, const Hittable::HitRecord& hit, const Ray& scatteredRay, const RayDifferential& differential, RayDifferential& scatteredDifferential) const {
+		return false;
+	}
+
+	// The following are used by integrators that connect path vertices explicitly (e.g. BDPT).
+	// Directions are unit vectors pointing away from the surface; wo is the side hit.normal faces.
+
+	// BSDF value for light arriving from wi and leaving along wo (without the cosine term)
+	virtual glm::vec3 evaluate(const Hittable::HitRecord& hit, const glm::vec3& wo, const glm::vec3& wi) const {
+		return glm::vec3(0.f);
+	}
+	// Solid angle density with which scatter() picks direction wi
+	virtual float scatterPdf(const Hittable::HitRecord& hit, const glm::vec3& wo, const glm::vec3& wi) const {
+		return 0.f;
+	}
+	// True if scatter() samples a (near-)delta distribution that evaluate() cannot describe;
+	// such vertices are never used for connections.
+	virtual bool isSpecular() const {
+		return false;
+	}
+	// True if light leaves the surface equally in all directions, so the radiance leaving a point
+	// does not depend on where it is seen from (used by caches keyed on position)
+	virtual bool isDiffuse() const {
+		return false;
+	}
 };
\ No newline at end of file
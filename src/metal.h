@@ -1,6 +1,7 @@
 #pragma once
 
 #include "material.h"
+#include "warp.h"
 
 class Metal : public Material {
 	glm::vec3 m_albedo = glm::vec3(0.f);
@@ -8,12 +9,27 @@ class Metal : public Material {
 public:
 	Metal(glm::vec3 albedo, float fuzziness) : m_albedo(albedo), m_fuzziness(fuzziness) {}
 
-	bool scatter(const Ray& ray, const Hittable::HitRecord& hit, glm::vec3& attenuation, Ray& scatteredRay) const override {
+	bool scatter(const Ray& ray, const Hittable::HitRecord& hit, Sampler& sampler, glm::vec3& attenuation, Ray& scatteredRay) const override {
 		glm::vec3 scatterDirection = glm::reflect(ray.direction(), hit.normal);
 		scatterDirection = glm::normalize(scatterDirection);
-		scatterDirection += randomOnSphere() * m_fuzziness;
+		scatterDirection += uniformSphere(sampler.getDirection2D()) * m_fuzziness;
 		scatteredRay = Ray(hit.point, scatterDirection);
 		attenuation = m_albedo;
 		return glm::dot(scatterDirection, hit.normal) > 0.f;
 	}
+
+	glm::vec3 albedo(const Hittable::HitRecord& hit) const override {
+		return m_albedo;
+	}
+
+	// only a perfect mirror keeps neighboring rays together
+	bool scatterDifferential(const Ray& ray, const Hittable::HitRecord& hit, const Ray& scatteredRay, const RayDifferential& differential, RayDifferential& scatteredDifferential) const override {
+		if (m_fuzziness > 0.f) return false;
+		scatteredDifferential = reflectDifferential(differential, hit, scatteredRay);
+		return scatteredDifferential.valid;
+	}
+
+	bool isSpecular() const override {
+		return true;
+	}
 };
\ No newline at end of file
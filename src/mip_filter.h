@@ -0,0 +1,164 @@
+#pragma once
+
+#include <algorithm>
+
+#include "common.h"
+
+// How a lookup in a mipmapped texture filters over the footprint of a pixel
+enum class TextureFilter {
+	Nearest,	// the nearest texel of the full-resolution level, ignoring the footprint
+	Trilinear,	// bilinear in the two levels around a square footprint's width, blended
+	EWA,	// elliptical weighted average over the footprint's ellipse (Heckbert 1989), sharper for surfaces seen at an angle
+};
+
+// Weight of a texel at squared distance r2 in [0, 1] from the center of an EWA ellipse: a Gaussian falloff, 0 at the edge,
+// tabulated at evenly spaced r2
+struct EWAWeights {
+	static const int size = 128;
+	float weights[size];
+
+	EWAWeights();
+};
+extern const EWAWeights ewaWeights;
+
+inline float ewaWeight(float r2) {
+	return ewaWeights.weights[glm::min(static_cast<int>(r2 * EWAWeights::size), EWAWeights::size - 1)];
+}
+
+// Filtered lookups in a pyramid of successively halved texture levels, for any storage of the levels. Derived provides
+//	int levels() const;
+//	glm::ivec2 levelSize(int level) const;
+//	glm::vec3 texel(int level, int x, int y) const;	// x and y may be outside the level, and clamp to its edge
+//
+// Coordinates st are in [0, 1]^2, with t down the image; lookups outside clamp to the edge.
+template<typename Derived>
+class MipFilter {
+	const Derived& derived() const { return static_cast<const Derived&>(*this); }
+
+	// level, possibly fractional, whose texels are width wide (in st units)
+	float levelFor(float width) const {
+		const glm::ivec2 size = derived().levelSize(0);
+		return glm::log2(glm::max(width * static_cast<float>(glm::max(size.x, size.y)), 1e-8f));
+	}
+	glm::vec3 coarsest() const {
+		return derived().texel(derived().levels() - 1, 0, 0);
+	}
+	glm::vec3 ewa(int level, glm::vec2 st, glm::vec2 axis0, glm::vec2 axis1) const;
+public:
+	typedef TextureFilter Filter;
+	static const int maxAnisotropy = 8;	// longest ellipse axis EWA allows, in units of its shortest one
+
+	glm::vec3 nearest(const glm::vec2& st) const {
+		const glm::ivec2 size = derived().levelSize(0);
+		return derived().texel(0, static_cast<int>(glm::floor(st.x * size.x)), static_cast<int>(glm::floor(st.y * size.y)));
+	}
+	glm::vec3 bilinear(int level, const glm::vec2& st) const;
+	// over a square footprint width wide
+	glm::vec3 trilinear(const glm::vec2& st, float width) const;
+	// over the ellipse with conjugate half axes dstdx and dstdy, the change of st from one pixel to the next
+	glm::vec3 ewa(const glm::vec2& st, glm::vec2 dstdx, glm::vec2 dstdy) const;
+
+	glm::vec3 lookup(Filter filter, const glm::vec2& st, const glm::vec2& dstdx, const glm::vec2& dstdy) const {
+		switch (filter) {
+		case Filter::Trilinear: {
+			// the footprint's larger extent along s or t, about the width of the pixel's box filter
+			glm::vec2 extent = glm::max(glm::abs(dstdx), glm::abs(dstdy));
+			return trilinear(st, glm::max(extent.x, extent.y));
+		}
+		case Filter::EWA:
+			return ewa(st, dstdx, dstdy);
+		default:
+			return nearest(st);
+		}
+	}
+};
+
+template<typename Derived>
+glm::vec3 MipFilter<Derived>::bilinear(int level, const glm::vec2& st) const {
+	level = glm::clamp(level, 0, derived().levels() - 1);
+	const glm::ivec2 size = derived().levelSize(level);
+	// texel centers are at half-integer coordinates
+	const float x = st.x * size.x - 0.5f;
+	const float y = st.y * size.y - 0.5f;
+	const int x0 = static_cast<int>(glm::floor(x));
+	const int y0 = static_cast<int>(glm::floor(y));
+	const float fx = x - x0, fy = y - y0;
+	const Derived& source = derived();
+	return (1.f - fx) * (1.f - fy) * source.texel(level, x0, y0) + fx * (1.f - fy) * source.texel(level, x0 + 1, y0)
+		+ (1.f - fx) * fy * source.texel(level, x0, y0 + 1) + fx * fy * source.texel(level, x0 + 1, y0 + 1);
+}
+
+template<typename Derived>
+glm::vec3 MipFilter<Derived>::trilinear(const glm::vec2& st, float width) const {
+	const float level = levelFor(width);
+	if (level <= 0.f) return bilinear(0, st);
+	if (level >= derived().levels() - 1) return coarsest();
+	const int lower = static_cast<int>(glm::floor(level));
+	const float blend = level - lower;
+	return (1.f - blend) * bilinear(lower, st) + blend * bilinear(lower + 1, st);
+}
+
+template<typename Derived>
+glm::vec3 MipFilter<Derived>::ewa(const glm::vec2& st, glm::vec2 dstdx, glm::vec2 dstdy) const {
+	// make dstdx the major axis, and widen the minor one if the ellipse is too long, which would take too many texels
+	if (glm::dot(dstdx, dstdx) < glm::dot(dstdy, dstdy)) std::swap(dstdx, dstdy);
+	const float major = glm::length(dstdx);
+	float minor = glm::length(dstdy);
+	if (minor * maxAnisotropy < major && minor > 0.f) {
+		float scale = major / (minor * maxAnisotropy);
+		dstdy *= scale;
+		minor *= scale;
+	}
+	if (minor == 0.f) return bilinear(0, st);
+
+	// the level where the minor axis is a few texels long
+	const float level = glm::max(0.f, levelFor(minor));
+	const int lower = static_cast<int>(glm::floor(level));
+	const float blend = level - lower;
+	if (lower >= derived().levels() - 1) return coarsest();
+	return (1.f - blend) * ewa(lower, st, dstdx, dstdy) + blend * ewa(lower + 1, st, dstdx, dstdy);
+}
+
+template<typename Derived>
+glm::vec3 MipFilter<Derived>::ewa(int level, glm::vec2 st, glm::vec2 axis0, glm::vec2 axis1) const {
+	if (level >= derived().levels() - 1) return coarsest();
+	// to texel coordinates of the level
+	const glm::vec2 size(derived().levelSize(level));
+	st = st * size - 0.5f;
+	axis0 *= size;
+	axis1 *= size;
+
+	// implicit ellipse A s^2 + B s t + C t^2 = 1, grown by a texel so that it covers at least one texel center
+	float a = axis0.y * axis0.y + axis1.y * axis1.y + 1.f;
+	float b = -2.f * (axis0.x * axis0.y + axis1.x * axis1.y);
+	float c = axis0.x * axis0.x + axis1.x * axis1.x + 1.f;
+	const float invF = 1.f / (a * c - b * b * 0.25f);
+	a *= invF;
+	b *= invF;
+	c *= invF;
+
+	// bounding box of the ellipse
+	const float det = -b * b + 4.f * a * c;
+	const float invDet = 1.f / det;
+	const float sHalf = 2.f * invDet * glm::sqrt(det * c);
+	const float tHalf = 2.f * invDet * glm::sqrt(det * a);
+	const int s0 = static_cast<int>(glm::ceil(st.x - sHalf)), s1 = static_cast<int>(glm::floor(st.x + sHalf));
+	const int t0 = static_cast<int>(glm::ceil(st.y - tHalf)), t1 = static_cast<int>(glm::floor(st.y + tHalf));
+
+	const Derived& source = derived();
+	glm::vec3 sum(0.f);
+	float weightSum = 0.f;
+	for (int t = t0; t <= t1; ++t) {
+		const float dt = t - st.y;
+		for (int s = s0; s <= s1; ++s) {
+			const float ds = s - st.x;
+			const float r2 = a * ds * ds + b * ds * dt + c * dt * dt;
+			if (r2 < 1.f) {
+				const float weight = ewaWeight(r2);
+				sum += weight * source.texel(level, s, t);
+				weightSum += weight;
+			}
+		}
+	}
+	return weightSum > 0.f ? sum / weightSum : bilinear(level, (st + 0.5f) / size);
+}
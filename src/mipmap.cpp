@@ -0,0 +1,43 @@
+#include "mipmap.h"
+
+#include <algorithm>
+
+EWAWeights::EWAWeights() {
+	const float alpha = 2.f;
+	for (int i = 0; i < size; ++i) {
+		float r2 = static_cast<float>(i) / static_cast<float>(size - 1);
+		weights[i] = glm::exp(-alpha * r2) - glm::exp(-alpha);
+	}
+}
+
+const EWAWeights ewaWeights;
+
+MipMap::MipMap(CompactImage image, int threadCount) {
+	m_levels.push_back(std::move(image));
+	if (m_levels[0].width() <= 0 || m_levels[0].height() <= 0) return;
+
+	while (m_levels.back().width() > 1 || m_levels.back().height() > 1) {
+		const CompactImage& previous = m_levels.back();
+		CompactImage next(glm::max(1, (previous.width() + 1) / 2), glm::max(1, (previous.height() + 1) / 2), previous.format(), previous.gamma());
+		const int previousLevel = static_cast<int>(m_levels.size()) - 1;
+
+		// each job fills one row of tiles, so that threads don't write to the same cache lines; averages in linear space
+		const int tileRows = (next.height() + CompactImage::tileSize - 1) / CompactImage::tileSize;
+		parallelFor(tileRows, threadCount, [&](int row) {
+			const int yEnd = glm::min(next.height(), (row + 1) * CompactImage::tileSize);
+			for (int y = row * CompactImage::tileSize; y < yEnd; ++y) {
+				for (int x = 0; x < next.width(); ++x) {
+					if (2 * x + 1 < previous.width() && 2 * y + 1 < previous.height()) {
+						next.set(x, y, previous.average2x2(2 * x, 2 * y));
+						continue;
+					}
+					// blocks cut off by the edge of an odd-sized level repeat the edge texels
+					glm::vec3 sum = texel(previousLevel, 2 * x, 2 * y) + texel(previousLevel, 2 * x + 1, 2 * y)
+						+ texel(previousLevel, 2 * x, 2 * y + 1) + texel(previousLevel, 2 * x + 1, 2 * y + 1);
+					next.set(x, y, 0.25f * sum);
+				}
+			}
+		});
+		m_levels.push_back(std::move(next));
+	}
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vector>
+
+#include "cache_stats.h"
+#include "common.h"
+#include "compact_image.h"
+#include "mip_filter.h"
+#include "parallel.h"
+
+// Pyramid of successively halved copies of a texture, so that a lookup can average over the texture's footprint in a pixel
+// with a few texels of the level where that footprint is about one texel wide (Williams 1983, "Pyramidal Parametrics").
+// Besides removing aliasing, lookups far from the camera then read from small levels that stay in cache.
+//
+// The levels are all in memory; see TiledMipMap for textures paged in from disk. Lookups are those of MipFilter.
+class MipMap : public MipFilter<MipMap> {
+	friend class MipFilter<MipMap>;
+
+	std::vector<CompactImage> m_levels;
+
+	glm::vec3 texel(int level, int x, int y) const {
+		const CompactImage& image = m_levels[level];
+		x = glm::clamp(x, 0, image.width() - 1);
+		y = glm::clamp(y, 0, image.height() - 1);
+		CACHE_STATS_TOUCH(image.address(x, y), image.format() == CompactImage::Format::Gamma8 ? 3 : 6);
+		return image.get(x, y);
+	}
+public:
+	// levels down to 1x1 texel, each made from the previous one by threadCount threads
+	explicit MipMap(CompactImage image, int threadCount = defaultThreadCount());
+
+	int levels() const { return static_cast<int>(m_levels.size()); }
+	glm::ivec2 levelSize(int i) const { return glm::ivec2(m_levels[i].width(), m_levels[i].height()); }
+	const CompactImage& level(int i) const { return m_levels[i]; }
+};
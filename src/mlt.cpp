@@ -0,0 +1,112 @@
+#include "mlt.h"
+
+#include <algorithm>
+#include <iostream>
+#include <mutex>
+
+#include "parallel.h"
+#include "splat_image.h"
+
+void MLTSampler::ensureReady(size_t index) {
+	if (index >= m_samples.size()) m_samples.resize(index + 1);
+	PrimarySample& sample = m_samples[index];
+
+	// catch up on a large step that happened since this number was last used
+	if (sample.lastModificationIteration < m_lastLargeStepIteration) {
+		sample.value = uniform();
+		sample.lastModificationIteration = m_lastLargeStepIteration;
+	}
+
+	sample.backup();
+	if (m_largeStep) {
+		sample.value = uniform();
+	}
+	else {
+		// apply all the small steps this number missed at once: their offsets add up to a normal with variance n * sigma^2
+		int64_t smallSteps = m_currentIteration - sample.lastModificationIteration;
+		float effectiveSigma = m_sigma * glm::sqrt(static_cast<float>(smallSteps));
+		sample.value += m_normal(m_generator) * effectiveSigma;
+		sample.value -= glm::floor(sample.value);
+		// guard against rounding up to exactly 1
+		sample.value = glm::min(sample.value, 0.99999994f);
+	}
+	sample.lastModificationIteration = m_currentIteration;
+}
+
+void MetropolisIntegrator::render(Image& output, int mutationsPerPixel, int threadCount) const {
+	const int width = output.width();
+	const int height = output.height();
+
+	// Bootstrap: estimate the mean path luminance, keeping each path's seed so chains can start from it
+	const int bootstrapSamples = m_settings.bootstrapSamples;
+	std::vector<float> bootstrapWeights(bootstrapSamples, 0.f);
+	parallelFor(bootstrapSamples, threadCount, [&](int i) {
+		MLTSampler sampler(static_cast<unsigned int>(i), m_settings.sigma, m_settings.largeStepProbability);
+		glm::ivec2 pixel;
+		bootstrapWeights[i] = luminance(m_path(sampler, pixel));
+	});
+
+	std::vector<double> cdf(bootstrapSamples + 1, 0.0);
+	for (int i = 0; i < bootstrapSamples; ++i) {
+		cdf[i + 1] = cdf[i] + bootstrapWeights[i];
+	}
+	const double b = bootstrapSamples > 0 ? cdf.back() / bootstrapSamples : 0.0;
+
+	SplatImage splats(width, height);
+	if (b > 0.0) {
+		const int64_t totalMutations = static_cast<int64_t>(mutationsPerPixel) * width * height;
+		const int chains = m_settings.chains;
+
+		std::atomic<int> remaining(chains);
+		std::mutex logMutex;
+		parallelFor(chains, threadCount, [&](int chain) {
+			const int64_t chainMutations = (chain + 1) * totalMutations / chains - chain * totalMutations / chains;
+			std::mt19937 generator(static_cast<unsigned int>(bootstrapSamples + chain));
+			std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+			// pick a bootstrap path in proportion to its luminance and replay it
+			double target = uniform(generator) * cdf.back();
+			int seed = static_cast<int>(std::upper_bound(cdf.begin() + 1, cdf.end(), target) - (cdf.begin() + 1));
+			seed = glm::clamp(seed, 0, bootstrapSamples - 1);
+			MLTSampler sampler(static_cast<unsigned int>(seed), m_settings.sigma, m_settings.largeStepProbability);
+
+			glm::ivec2 currentPixel;
+			glm::vec3 current = m_path(sampler, currentPixel);
+			float currentLuminance = luminance(current);
+
+			for (int64_t j = 0; j < chainMutations; ++j) {
+				sampler.startIteration();
+				glm::ivec2 proposedPixel;
+				glm::vec3 proposed = m_path(sampler, proposedPixel);
+				float proposedLuminance = luminance(proposed);
+
+				float accept = currentLuminance > 0.f ? glm::min(1.f, proposedLuminance / currentLuminance) : 1.f;
+				if (accept > 0.f)
+					splats.add(proposedPixel.x, proposedPixel.y, proposed * (accept / proposedLuminance));
+				if (accept < 1.f)
+					splats.add(currentPixel.x, currentPixel.y, current * ((1.f - accept) / currentLuminance));
+
+				if (uniform(generator) < accept) {
+					currentPixel = proposedPixel;
+					current = proposed;
+					currentLuminance = proposedLuminance;
+					sampler.accept();
+				}
+				else {
+					sampler.reject();
+				}
+			}
+
+			int left = --remaining;
+			std::lock_guard<std::mutex> lock(logMutex);
+			std::clog << "\rChains remaining: " << left << ' ' << std::flush;
+		});
+	}
+
+	const float scale = static_cast<float>(b / mutationsPerPixel);
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			output.set(x, y, scale * splats.get(x, y));
+		}
+	}
+}
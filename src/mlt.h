@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <random>
+#include <vector>
+
+#include "common.h"
+#include "image.h"
+#include "sampler.h"
+
+// Primary sample space sampler for Metropolis light transport (Kelemen et al. 2002).
+// Stores every number a path consumed, so that the path can be rebuilt from a mutated copy:
+// a large step replaces all numbers with fresh ones, a small step perturbs each one with a wrapped normal offset.
+// Numbers are mutated lazily, the first time they are used in an iteration.
+class MLTSampler : public Sampler {
+	struct PrimarySample {
+		float value = 0.f;
+		int64_t lastModificationIteration = 0;
+
+		// state before the current iteration's mutation, restored on rejection
+		float valueBackup = 0.f;
+		int64_t modifyBackup = 0;
+
+		void backup() {
+			valueBackup = value;
+			modifyBackup = lastModificationIteration;
+		}
+		void restore() {
+			value = valueBackup;
+			lastModificationIteration = modifyBackup;
+		}
+	};
+
+	std::mt19937 m_generator;
+	std::uniform_real_distribution<float> m_uniform = std::uniform_real_distribution<float>(0.f, 1.f);
+	std::normal_distribution<float> m_normal = std::normal_distribution<float>(0.f, 1.f);
+	float m_sigma = 0.01f;
+	float m_largeStepProbability = 0.3f;
+
+	std::vector<PrimarySample> m_samples;
+	int64_t m_currentIteration = 0;
+	int64_t m_lastLargeStepIteration = 0;
+	bool m_largeStep = true;
+	size_t m_sampleIndex = 0;
+
+	float uniform() { return m_uniform(m_generator); }
+	void ensureReady(size_t index);
+public:
+	// Two samplers built with the same seed produce the same sequence of paths
+	MLTSampler(unsigned int seed, float sigma, float largeStepProbability) :
+		m_generator(seed), m_sigma(sigma), m_largeStepProbability(largeStepProbability) {}
+
+	// Picks the mutation type for the next path; call before building each path except the first,
+	// which always uses fresh numbers
+	void startIteration() {
+		++m_currentIteration;
+		m_largeStep = uniform() < m_largeStepProbability;
+		m_sampleIndex = 0;
+	}
+	// Keep the numbers the last path used
+	void accept() {
+		if (m_largeStep) m_lastLargeStepIteration = m_currentIteration;
+	}
+	// Go back to the numbers used before the last startIteration()
+	void reject() {
+		for (PrimarySample& sample : m_samples) {
+			if (sample.lastModificationIteration == m_currentIteration) sample.restore();
+		}
+		--m_currentIteration;
+	}
+
+	float get1D() override {
+		ensureReady(m_sampleIndex);
+		return m_samples[m_sampleIndex++].value;
+	}
+};
+
+// Primary sample space Metropolis light transport, wrapping a path tracer given as a function of its random numbers.
+// A bootstrap phase estimates the image's mean luminance b and seeds the chains in proportion to path luminance;
+// independent chains then run in parallel, each splatting both the proposed and the current path weighted by the
+// acceptance probability, and the splatted image is finally scaled by b / (mutations per pixel).
+class MetropolisIntegrator {
+public:
+	struct Settings {
+		int bootstrapSamples = 100000;
+		int chains = 1000;
+		float sigma = 0.01f;	// standard deviation of small step perturbations
+		float largeStepProbability = 0.3f;
+	};
+
+	// Builds one path from sampler's numbers; returns its radiance and the pixel it lands on
+	typedef std::function<glm::vec3(Sampler& sampler, glm::ivec2& pixel)> PathFunction;
+
+	MetropolisIntegrator(const Settings& settings, const PathFunction& path) : m_settings(settings), m_path(path) {}
+
+	// Overwrites output with the rendered image; mutationsPerPixel plays the role of samples per pixel
+	void render(Image& output, int mutationsPerPixel, int threadCount) const;
+private:
+	Settings m_settings;
+	PathFunction m_path;
+};
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+inline int defaultThreadCount() {
+	return static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+}
+
+// Calls body(i) for every i in [0, count), handing indices out one at a time to threadCount threads.
+// The calling thread takes part, so threadCount = 1 runs everything inline.
+template<typename Body>
+void parallelFor(int count, int threadCount, const Body& body) {
+	std::atomic<int> next(0);
+	auto worker = [&]() {
+		for (int i = next++; i < count; i = next++) {
+			body(i);
+		}
+	};
+
+	threadCount = std::max(1, std::min(threadCount, count));
+	std::vector<std::thread> threads;
+	for (int t = 1; t < threadCount; ++t) {
+		threads.emplace_back(worker);
+	}
+	worker();
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+}
+
+// Threads kept waiting between loops, for code that runs many loops too short to be worth starting threads for each, as
+// parallelFor() does. Like parallelFor(), the calling thread takes part, so threadCount = 1 starts no threads. Loops run
+// one at a time: parallelFor() must not be called by several threads at once, nor from a loop's body.
+class WorkerPool {
+	std::vector<std::thread> m_threads;
+	std::mutex m_mutex;
+	std::condition_variable m_started;	// a loop started, or the pool is stopping
+	std::condition_variable m_finished;	// a thread is done with the loop
+	const std::function<void(int)>* m_body = nullptr;
+	int m_count = 0;
+	std::atomic<int> m_next{ 0 };
+	uint64_t m_loops = 0;	// loops started so far
+	int m_busy = 0;	// threads that haven't finished the loop yet
+	bool m_stopping = false;
+
+	void run() {
+		for (int i = m_next++; i < m_count; i = m_next++) {
+			(*m_body)(i);
+		}
+	}
+	void work() {
+		uint64_t loops = 0;
+		std::unique_lock<std::mutex> lock(m_mutex);
+		for (;;) {
+			m_started.wait(lock, [&]() { return m_loops != loops || m_stopping; });
+			if (m_stopping) return;
+			loops = m_loops;
+			lock.unlock();
+			run();
+			lock.lock();
+			if (--m_busy == 0) m_finished.notify_one();
+		}
+	}
+public:
+	explicit WorkerPool(int threadCount) {
+		for (int t = 1; t < threadCount; ++t) {
+			m_threads.emplace_back([this]() { work(); });
+		}
+	}
+	~WorkerPool() {
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stopping = true;
+		}
+		m_started.notify_all();
+		for (std::thread& thread : m_threads) {
+			thread.join();
+		}
+	}
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	int threadCount() const { return static_cast<int>(m_threads.size()) + 1; }
+
+	// Calls body(i) for every i in [0, count), handing indices out one at a time to the pool's threads
+	template<typename Body>
+	void parallelFor(int count, const Body& body) {
+		if (m_threads.empty() || count <= 1) {
+			for (int i = 0; i < count; ++i) {
+				body(i);
+			}
+			return;
+		}
+		const std::function<void(int)> function = body;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_body = &function;
+			m_count = count;
+			m_next = 0;
+			m_busy = static_cast<int>(m_threads.size());
+			++m_loops;
+		}
+		m_started.notify_all();
+		run();
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_finished.wait(lock, [this]() { return m_busy == 0; });
+	}
+};
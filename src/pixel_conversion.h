@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "common.h"
+#include "parallel.h"
+
+// Encodes linear values as 8-bit values with gamma: pow(value, 1 / gamma) * 255, clamped and truncated, or rounded to the
+// nearest with round, without pow()
+class GammaEncoder {
+	float m_thresholds[255];	// linear values at which the 8-bit value steps up, the i-th where it reaches i + 1
+public:
+	explicit GammaEncoder(float gamma, bool round = false) {
+		const float step = round ? 0.5f : 1.f;
+		for (int i = 0; i < 255; ++i) {
+			m_thresholds[i] = std::pow((static_cast<float>(i) + step) / 255.f, gamma);
+		}
+	}
+	uint8_t operator()(float value) const {
+		// the number of thresholds at or below the value
+		int encoded = 0;
+		for (int step = 128; step > 0; step >>= 1) {
+			encoded += step * static_cast<int>(m_thresholds[encoded + step - 1] <= value);	// no branch to mispredict
+		}
+		return static_cast<uint8_t>(encoded);
+	}
+};
+
+namespace pixelConversion {
+	// calls use(convert), for float values, which are too many to tabulate
+	template<typename Convert, typename Use>
+	void withConverter(const float*, size_t, int, const Convert& convert, const Use& use) {
+		use(convert);
+	}
+
+	// Calls use() with a lookup in a table of convert() for every 8- or 16-bit value, which is cheaper than convert()
+	// (usually pow()) for each of all but a few values; with convert itself for those
+	template<typename T, typename Convert, typename Use>
+	void withConverter(const T*, size_t values, int threadCount, const Convert& convert, const Use& use) {
+		const int tableSize = 1 << (8 * sizeof(T));
+		if (values < 4 * static_cast<size_t>(tableSize)) {
+			use(convert);
+			return;
+		}
+		std::vector<decltype(convert(T()))> table(tableSize);
+		parallelFor(tableSize / 256, threadCount, [&](int block) {
+			for (int i = block * 256; i < (block + 1) * 256; ++i) {
+				table[i] = convert(static_cast<T>(i));
+			}
+		});
+		use([&table](T value) { return table[value]; });
+	}
+}
+
+// Converts the values of a decoded image file, width x height pixels of channels values in row-major order, for an image
+// type to store: rows(y, row, convertValue) stores convertValue(value) for each value of row y, which starts at row.
+// Blocks of rowsPerJob rows are handed out to threadCount threads, except for small images, which threads aren't worth
+// starting for. convertValue() gives convert(value), possibly from a table.
+template<typename T, typename Convert, typename Rows>
+void convertPixels(const T* decoded, int width, int height, int channels, int rowsPerJob, int threadCount, const Convert& convert, const Rows& rows) {
+	if (static_cast<size_t>(width) * height < (1 << 16)) threadCount = 1;
+	const size_t rowValues = static_cast<size_t>(width) * channels;
+	pixelConversion::withConverter(decoded, rowValues * height, threadCount, convert, [&](const auto& convertValue) {
+		const int jobs = (height + rowsPerJob - 1) / rowsPerJob;
+		parallelFor(jobs, threadCount, [&](int job) {
+			const int yEnd = glm::min(height, (job + 1) * rowsPerJob);
+			for (int y = job * rowsPerJob; y < yEnd; ++y) {
+				rows(y, decoded + y * rowValues, convertValue);
+			}
+		});
+	});
+}
@@ -0,0 +1,156 @@
+#include "png_writer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "deflate.h"
+
+namespace {
+	const int channels = 3;
+	const size_t groupBytes = 1 << 18;	// of filtered rows per group, about as much as keeps compression close to one stream's
+
+	struct CrcTable {
+		uint32_t values[256];
+
+		CrcTable() {
+			for (uint32_t n = 0; n < 256; ++n) {
+				uint32_t c = n;
+				for (int k = 0; k < 8; ++k) {
+					c = (c & 1) != 0 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+				}
+				values[n] = c;
+			}
+		}
+	};
+	const CrcTable crcTable;
+
+	uint32_t updateCrc(uint32_t crc, const uint8_t* data, size_t size) {
+		for (size_t i = 0; i < size; ++i) {
+			crc = crcTable.values[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+		}
+		return crc;
+	}
+
+	int paeth(int a, int b, int c) {
+		const int p = a + b - c, pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+		if (pa <= pb && pa <= pc) return a;
+		return pb <= pc ? b : c;
+	}
+
+	// Writes row filtered with PNG filter Type (0 to 4) after the type byte to out; returns the sum of the filtered bytes
+	// as signed values, which is smallest for the filter that compresses best, by PNG's usual heuristic
+	template<int Type>
+	int filterRow(const uint8_t* row, const uint8_t* above, int size, uint8_t* out) {
+		out[0] = static_cast<uint8_t>(Type);
+		int cost = 0;
+		for (int i = 0; i < size; ++i) {
+			const int left = i >= channels ? row[i - channels] : 0;
+			const int upLeft = i >= channels ? above[i - channels] : 0;
+			int predicted = 0;
+			if (Type == 1) predicted = left;
+			else if (Type == 2) predicted = above[i];
+			else if (Type == 3) predicted = (left + above[i]) / 2;
+			else if (Type == 4) predicted = paeth(left, above[i], upLeft);
+			const uint8_t filtered = static_cast<uint8_t>(row[i] - predicted);
+			out[i + 1] = filtered;
+			cost += std::abs(static_cast<int8_t>(filtered));
+		}
+		return cost;
+	}
+
+	// Filters and compresses rows [begin, end) into out, and their checksum into adler. Row begin - 1 belongs to another
+	// group, so rather than requesting it again, row begin is filtered with one of the filters that don't look above it
+	void encodeGroup(int begin, int end, int width, const PngRowSource& rows, bool final, std::vector<uint8_t>& out, Adler32& adler) {
+		const int rowBytes = width * channels;
+		std::vector<uint8_t> above(rowBytes, 0), row(rowBytes), filtered(static_cast<size_t>(end - begin) * (rowBytes + 1));
+		std::vector<uint8_t> trial(rowBytes + 1);
+		for (int y = begin; y < end; ++y) {
+			rows(y, row.data());
+			uint8_t* best = &filtered[static_cast<size_t>(y - begin) * (rowBytes + 1)];
+			int bestCost = filterRow<0>(row.data(), above.data(), rowBytes, best);
+			auto tryFilter = [&](int cost) {
+				if (cost < bestCost) {
+					bestCost = cost;
+					std::copy(trial.begin(), trial.end(), best);
+				}
+			};
+			tryFilter(filterRow<1>(row.data(), above.data(), rowBytes, trial.data()));
+			if (y == begin && begin > 0) {
+				std::swap(above, row);
+				continue;
+			}
+			tryFilter(filterRow<2>(row.data(), above.data(), rowBytes, trial.data()));
+			tryFilter(filterRow<3>(row.data(), above.data(), rowBytes, trial.data()));
+			tryFilter(filterRow<4>(row.data(), above.data(), rowBytes, trial.data()));
+			std::swap(above, row);
+		}
+		adler.update(filtered.data(), filtered.size());
+		deflate(filtered.data(), static_cast<int>(filtered.size()), final, out);
+	}
+
+	void putBigEndian(uint32_t value, uint8_t* out) {
+		out[0] = static_cast<uint8_t>(value >> 24);
+		out[1] = static_cast<uint8_t>(value >> 16);
+		out[2] = static_cast<uint8_t>(value >> 8);
+		out[3] = static_cast<uint8_t>(value);
+	}
+
+	bool writeChunk(std::FILE* f, const char* type, const uint8_t* data, size_t size) {
+		uint8_t header[8];
+		putBigEndian(static_cast<uint32_t>(size), header);
+		std::copy(type, type + 4, header + 4);
+		uint8_t crc[4];
+		putBigEndian(updateCrc(updateCrc(0xffffffffu, header + 4, 4), data, size) ^ 0xffffffffu, crc);
+		return std::fwrite(header, 1, 8, f) == 8 && (size == 0 || std::fwrite(data, 1, size, f) == size) && std::fwrite(crc, 1, 4, f) == 4;
+	}
+}
+
+bool writePng(const std::string& file, int width, int height, const PngRowSource& rows, int threadCount) {
+	if (width <= 0 || height <= 0) return false;
+	std::FILE* f = std::fopen(file.c_str(), "wb");
+	if (f == nullptr) return false;
+
+	const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	uint8_t header[13] = { 0 };
+	putBigEndian(static_cast<uint32_t>(width), header);
+	putBigEndian(static_cast<uint32_t>(height), header + 4);
+	header[8] = 8;	// bits per channel
+	header[9] = 2;	// RGB
+	// the zlib stream's header, as zlibCompress() writes it
+	const uint8_t zlibHeader[2] = { 0x78, 0x01 };
+	bool ok = std::fwrite(signature, 1, 8, f) == 8
+		&& writeChunk(f, "IHDR", header, sizeof(header))
+		&& writeChunk(f, "IDAT", zlibHeader, sizeof(zlibHeader));
+
+	// each group is an IDAT chunk of its own, as the chunks' data joins into one zlib stream
+	const size_t rowBytes = static_cast<size_t>(width) * channels + 1;
+	const int rowsPerGroup = static_cast<int>(std::max(static_cast<size_t>(1), groupBytes / rowBytes));
+	const int groups = (height + rowsPerGroup - 1) / rowsPerGroup;
+	threadCount = std::max(1, threadCount);
+	Adler32 adler;
+	for (int first = 0; ok && first < groups; first += threadCount) {
+		const int count = std::min(threadCount, groups - first);
+		std::vector<std::vector<uint8_t>> compressed(count);
+		std::vector<Adler32> checksums(count);
+		parallelFor(count, threadCount, [&](int i) {
+			const int group = first + i;
+			const int end = std::min(height, (group + 1) * rowsPerGroup);
+			encodeGroup(group * rowsPerGroup, end, width, rows, group == groups - 1, compressed[i], checksums[i]);
+		});
+		for (int i = 0; ok && i < count; ++i) {
+			const int group = first + i;
+			const int end = std::min(height, (group + 1) * rowsPerGroup);
+			adler.append(checksums[i], static_cast<size_t>(end - group * rowsPerGroup) * rowBytes);
+			ok = writeChunk(f, "IDAT", compressed[i].data(), compressed[i].size());
+		}
+	}
+
+	uint8_t checksum[4];
+	putBigEndian(adler.value(), checksum);
+	ok = ok && writeChunk(f, "IDAT", checksum, sizeof(checksum))
+		&& writeChunk(f, "IEND", nullptr, 0);
+	return std::fclose(f) == 0 && ok;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include "parallel.h"
+
+// Fills row with the 3 * width bytes of row y, in RGB order; called once per row, by several threads at once, for
+// different rows
+typedef std::function<void(int y, uint8_t* row)> PngRowSource;
+
+// Writes an 8-bit RGB PNG file, with rows from rows, and returns false if it can't be written.
+//
+// The rows are split into groups that threadCount threads filter and compress at once, each group into deflate blocks of
+// its own that end on a byte boundary, as zlib's sync flush does, so that the groups' output joins into one stream. Groups
+// are written out in batches of threadCount as they are done, so the image is never held in memory whole.
+bool writePng(const std::string& file, int width, int height, const PngRowSource& rows, int threadCount = defaultThreadCount());
@@ -78,7 +78,10 @@ public:
 		hit.point = ray.at(t);
 		hit.setFrontFaceAndNormal(ray, m_planeNormal);
 		hit.uv = glm::vec2(u, v);
+		hit.dpdu = m_side1;
+		hit.dpdv = m_side2;
 		hit.material = m_material;
+		hit.objectId = m_id;
 
 		return true;
 	}
@@ -86,4 +89,23 @@ public:
 	AABox boundingBox() const override {
 		return m_bbox;
 	}
+
+	float area() const override {
+		return glm::length(glm::cross(m_side1, m_side2));
+	}
+
+	bool sampleSurface(const glm::vec2& u, HitRecord& sample) const override {
+		sample.point = m_corner + u.x * m_side1 + u.y * m_side2;
+		sample.normal = m_planeNormal;
+		sample.frontFace = true;
+		sample.uv = u;
+		sample.t = 0.f;
+		sample.material = m_material;
+		return true;
+	}
+
+	bool forEachQuad(const QuadVisitor& visit) const override {
+		visit(m_corner, m_side1, m_side2, m_material);
+		return true;
+	}
 };
\ No newline at end of file
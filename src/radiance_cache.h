@@ -0,0 +1,120 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "common.h"
+
+// World-space radiance cache for diffuse surfaces, stored in a fixed-size open-addressing hash table.
+// Cells are keyed on quantized position and quantized normal, so the two sides of a wall stay separate.
+// Rendering threads add and look up entries concurrently without locks: a slot is claimed by compare-and-swap
+// on its key, and radiance sums are accumulated with atomic adds. Lookups may see a partially updated sum,
+// which only adds a little noise to an already approximate value.
+class RadianceCache {
+public:
+	struct Settings {
+		bool enabled = false;
+		int startBounce = 2;	// from this bounce on, diffuse hits end the path with the cached value when there is one
+		float cellSize = 0.f;	// world-space cell size; 0 picks 1/64 of the scene's longest side
+		int minSamples = 16;	// entries with fewer samples are not used yet
+		int capacity = 1 << 20;	// number of slots, rounded up to a power of two
+
+		// Whether a diffuse hit at bounce of a path of at most maxBounces looks for a cached value
+		bool looksUp(int bounce) const { return bounce >= startBounce; }
+		// Whether such a hit adds its radiance to the cache: only hits with at least as many bounces left as those that look
+		// it up, since paths cut short by maxBounces would bias the entries dark
+		bool adds(int bounce, int maxBounces) const { return bounce <= startBounce && startBounce <= maxBounces; }
+	};
+private:
+	struct Entry {
+		std::atomic<uint64_t> key;
+		std::atomic<float> sum[3];
+		std::atomic<uint32_t> count;
+
+		Entry() : key(0), count(0) {
+			for (std::atomic<float>& s : sum) s.store(0.f, std::memory_order_relaxed);
+		}
+	};
+
+	static const int maxProbes = 32;
+
+	std::unique_ptr<Entry[]> m_entries;
+	uint64_t m_mask = 0;
+	float m_inverseCellSize = 1.f;
+	uint32_t m_minSamples = 16;
+
+	static uint64_t mix(uint64_t h) {
+		// splitmix64 finalizer
+		h ^= h >> 30;
+		h *= 0xbf58476d1ce4e5b9ull;
+		h ^= h >> 27;
+		h *= 0x94d049bb133111ebull;
+		h ^= h >> 31;
+		return h;
+	}
+
+	uint64_t keyOf(const glm::vec3& point, const glm::vec3& normal) const {
+		glm::vec3 cell = glm::floor(point * m_inverseCellSize);
+		glm::vec3 normalCell = glm::floor(normal * 2.f + 0.5f);	// each component in {-2, ..., 2}
+
+		uint64_t h = 0;
+		for (int comp = 0; comp < 3; ++comp) {
+			h = mix(h ^ static_cast<uint64_t>(static_cast<int64_t>(cell[comp])));
+		}
+		uint64_t normalBucket = static_cast<uint64_t>((normalCell.x + 2.f) * 25.f + (normalCell.y + 2.f) * 5.f + (normalCell.z + 2.f));
+		h = mix(h ^ (normalBucket << 56));
+		return h != 0 ? h : 1;	// 0 marks an empty slot
+	}
+
+	static void atomicAdd(std::atomic<float>& target, float value) {
+		float current = target.load(std::memory_order_relaxed);
+		while (!target.compare_exchange_weak(current, current + value, std::memory_order_relaxed)) {}
+	}
+
+	// Returns the slot holding key, claiming an empty one if insert is set; nullptr if not found or the probe sequence is full
+	Entry* find(uint64_t key, bool insert) const {
+		for (int probe = 0; probe < maxProbes; ++probe) {
+			Entry& entry = m_entries[(key + probe) & m_mask];
+			uint64_t current = entry.key.load(std::memory_order_acquire);
+			if (current == key) return &entry;
+			if (current == 0) {
+				if (!insert) return nullptr;
+				if (entry.key.compare_exchange_strong(current, key, std::memory_order_acq_rel) || current == key)
+					return &entry;
+			}
+		}
+		return nullptr;
+	}
+public:
+	RadianceCache(float cellSize, int capacity, int minSamples) : m_inverseCellSize(1.f / cellSize), m_minSamples(static_cast<uint32_t>(minSamples)) {
+		uint64_t size = 1;
+		while (size < static_cast<uint64_t>(capacity)) size <<= 1;
+		m_entries.reset(new Entry[size]);
+		m_mask = size - 1;
+	}
+
+	// Records one estimate of the radiance leaving a diffuse surface at point
+	void add(const glm::vec3& point, const glm::vec3& normal, const glm::vec3& radiance) {
+		Entry* entry = find(keyOf(point, normal), true);
+		if (entry == nullptr) return;
+		for (int comp = 0; comp < 3; ++comp) {
+			atomicAdd(entry->sum[comp], radiance[comp]);
+		}
+		entry->count.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// Mean recorded radiance for the cell containing point; false if the cell has fewer than minSamples estimates
+	bool lookup(const glm::vec3& point, const glm::vec3& normal, glm::vec3& radiance) const {
+		const Entry* entry = find(keyOf(point, normal), false);
+		if (entry == nullptr) return false;
+		uint32_t count = entry->count.load(std::memory_order_relaxed);
+		if (count < m_minSamples || count == 0) return false;
+		radiance = glm::vec3(
+			entry->sum[0].load(std::memory_order_relaxed),
+			entry->sum[1].load(std::memory_order_relaxed),
+			entry->sum[2].load(std::memory_order_relaxed)
+		) / static_cast<float>(count);
+		return true;
+	}
+};
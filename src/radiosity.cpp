@@ -0,0 +1,322 @@
+#include "radiosity.h"
+
+#include <cstring>
+#include <iostream>
+
+#include "binary_file.h"
+#include "bvh.h"
+#include "emissive.h"
+#include "hittable_list.h"
+#include "parallel.h"
+#include "quad.h"
+#include "sampler.h"
+#include "texture.h"
+
+namespace {
+	// Same offset Renderer::rayColor uses to avoid self-intersection
+	const float rayEpsilon = 1e-3f;
+
+	// File layout, little-endian (see binary_file.h): magic, version, patch count, patch hash, then the radiance and the
+	// unshot radiance of each patch side (3 floats each), in the order of radiance()
+	const char magic[4] = { 'R', 'T', 'R', 'S' };
+	const uint32_t version = 1;
+
+	// Radiance of one side of a quad, looked up with the nearest texel
+	class RadiosityTexture : public Texture {
+		int m_width = 0;
+		int m_height = 0;
+		std::vector<glm::vec3> m_texels;
+	public:
+		RadiosityTexture(int width, int height, std::vector<glm::vec3> texels) : m_width(width), m_height(height), m_texels(std::move(texels)) {}
+
+		glm::vec3 value(const glm::vec2& uv, const glm::vec3& p) const override {
+			int x = glm::clamp(static_cast<int>(uv.x * m_width), 0, m_width - 1);
+			int y = glm::clamp(static_cast<int>(uv.y * m_height), 0, m_height - 1);
+			return m_texels[y * m_width + x];
+		}
+	};
+
+	// Quad with a different material on each side
+	class TwoSidedQuad : public Hittable {
+		Quad m_quad;
+		std::shared_ptr<Material> m_back = nullptr;
+	public:
+		TwoSidedQuad(const glm::vec3& corner, const glm::vec3& side1, const glm::vec3& side2, std::shared_ptr<Material> front, std::shared_ptr<Material> back) :
+			m_quad(corner, side1, side2, front), m_back(back) {}
+
+		bool hit(const Ray& ray, Interval tRange, HitRecord& hit) const override {
+			if (!m_quad.hit(ray, tRange, hit)) return false;
+			if (!hit.frontFace) hit.material = m_back;
+			return true;
+		}
+		AABox boundingBox() const override { return m_quad.boundingBox(); }
+	};
+}
+
+RadiositySolver::RadiositySolver(const Hittable& world, const Settings& settings, int threadCount) :
+	m_world(world), m_settings(settings), m_threadCount(threadCount) {
+	float patchSize = settings.patchSize;
+	if (patchSize <= 0.f) {
+		const AABox bounds = world.boundingBox();
+		patchSize = bounds.getInterval(bounds.longestAxis()).size() / 16.f;
+	}
+
+	bool specular = false;
+	m_valid = world.forEachQuad([&](const glm::vec3& corner, const glm::vec3& side1, const glm::vec3& side2, const std::shared_ptr<Material>& material) {
+		specular = specular || material->isSpecular();
+
+		Surface surface;
+		surface.corner = corner;
+		surface.side1 = side1;
+		surface.side2 = side2;
+		surface.material = material;
+		surface.resolution[0] = glm::max(1, static_cast<int>(glm::ceil(glm::length(side1) / patchSize)));
+		surface.resolution[1] = glm::max(1, static_cast<int>(glm::ceil(glm::length(side2) / patchSize)));
+		surface.firstPatch = static_cast<int>(m_patches.size());
+		m_surfaces.push_back(surface);
+
+		glm::vec3 normal = glm::cross(side1, side2);
+		glm::vec3 patchSide1 = side1 / static_cast<float>(surface.resolution[0]);
+		glm::vec3 patchSide2 = side2 / static_cast<float>(surface.resolution[1]);
+		for (int j = 0; j < surface.resolution[1]; ++j) {
+			for (int i = 0; i < surface.resolution[0]; ++i) {
+				Patch patch;
+				patch.corner = corner + static_cast<float>(i) * patchSide1 + static_cast<float>(j) * patchSide2;
+				patch.side1 = patchSide1;
+				patch.side2 = patchSide2;
+				patch.normal = glm::normalize(normal);
+				patch.area = glm::length(glm::cross(patchSide1, patchSide2));
+
+				// materials are looked up at the patch center
+				Hittable::HitRecord center;
+				center.material = material;
+				center.point = patch.corner + 0.5f * (patchSide1 + patchSide2);
+				center.normal = patch.normal;
+				center.uv = glm::vec2((i + 0.5f) / surface.resolution[0], (j + 0.5f) / surface.resolution[1]);
+				center.frontFace = true;
+				if (material->isDiffuse()) {
+					patch.reflectance = material->evaluate(center, center.normal, center.normal) * pi;
+				}
+				patch.emitted = material->emitted(center.uv, center.point);
+
+				m_patches.push_back(patch);
+				for (int side = 0; side < 2; ++side) {
+					m_radiance.push_back(patch.emitted);
+					m_unshot.push_back(patch.emitted);
+					m_emittedPower += luminance(patch.emitted) * patch.area;
+				}
+			}
+		}
+	}) && !specular;
+}
+
+int RadiositySolver::solve() {
+	if (!m_valid || m_emittedPower <= 0.f) return 0;
+
+	// shots are too short to start threads for each
+	WorkerPool workers(m_threadCount);
+	int shots = 0;
+	for (; shots < m_settings.maxShots; ++shots) {
+		int shooter = -1;
+		float maxPower = 0.f;
+		float unshotPower = 0.f;
+		for (size_t element = 0; element < m_unshot.size(); ++element) {
+			float power = luminance(m_unshot[element]) * m_patches[element / 2].area;
+			unshotPower += power;
+			if (power > maxPower) {
+				maxPower = power;
+				shooter = static_cast<int>(element);
+			}
+		}
+		if (shooter < 0 || unshotPower <= m_settings.convergenceThreshold * m_emittedPower)
+			break;
+
+		shoot(shooter, workers);
+		if (shots % 100 == 0) {
+			std::clog << "\rRadiosity: " << 100.f * unshotPower / m_emittedPower << "% unshot    " << std::flush;
+		}
+	}
+	std::clog << "\rRadiosity: " << shots << " shots, " << 100.f * unshotFraction() << "% unshot\n";
+	return shots;
+}
+
+float RadiositySolver::unshotFraction() const {
+	if (m_emittedPower <= 0.f) return 0.f;
+	float unshotPower = 0.f;
+	for (size_t element = 0; element < m_unshot.size(); ++element) {
+		unshotPower += luminance(m_unshot[element]) * m_patches[element / 2].area;
+	}
+	return unshotPower / m_emittedPower;
+}
+
+void RadiositySolver::shoot(int element, WorkerPool& workers) {
+	const int shooterIndex = element / 2;
+	const Patch& shooter = m_patches[shooterIndex];
+	const glm::vec3 shooterNormal = element % 2 == 0 ? shooter.normal : -shooter.normal;
+	const glm::vec3 shot = m_unshot[element];
+	m_unshot[element] = glm::vec3(0.f);
+
+	const int samples = glm::max(m_settings.formFactorSamples, 1);
+	const float sampleFrac = 1.f / static_cast<float>(samples);
+
+	// every receiver is written by one task only
+	workers.parallelFor(static_cast<int>(m_patches.size()), [&](int receiverIndex) {
+		const Patch& receiver = m_patches[receiverIndex];
+		if (receiverIndex == shooterIndex || receiver.reflectance == glm::vec3(0.f)) return;
+
+		// skip receivers entirely behind the shooting side
+		bool inFront = false;
+		for (int corner = 0; corner < 4 && !inFront; ++corner) {
+			glm::vec3 p = receiver.corner + static_cast<float>(corner & 1) * receiver.side1 + static_cast<float>(corner >> 1) * receiver.side2;
+			inFront = glm::dot(p - shooter.corner, shooterNormal) > 0.f;
+		}
+		if (!inFront) return;
+
+		// F_ij from the shooter to the receiver, summed per receiving side, using the disk approximation
+		// cos_i cos_j A_j / (pi r^2 + A_j) for each point pair so that nearby pairs stay bounded
+		IndependentSampler sampler;
+		float factor[2] = { 0.f, 0.f };
+		const float sampleArea = receiver.area * sampleFrac;
+		for (int s = 0; s < samples; ++s) {
+			glm::vec2 u = sampler.get2D();
+			glm::vec2 v = sampler.get2D();
+			glm::vec3 from = shooter.corner + u.x * shooter.side1 + u.y * shooter.side2;
+			glm::vec3 to = receiver.corner + v.x * receiver.side1 + v.y * receiver.side2;
+
+			glm::vec3 d = to - from;
+			float dist2 = glm::dot(d, d);
+			if (dist2 == 0.f) continue;
+			glm::vec3 w = d / glm::sqrt(dist2);
+			float cosShooter = glm::dot(w, shooterNormal);
+			float cosReceiver = -glm::dot(w, receiver.normal);
+			if (cosShooter <= 0.f || cosReceiver == 0.f) continue;
+			if (!unoccluded(from, to)) continue;
+
+			int side = cosReceiver > 0.f ? 0 : 1;
+			factor[side] += cosShooter * glm::abs(cosReceiver) * sampleArea / (pi * dist2 + sampleArea);
+		}
+
+		// reciprocity: F_ji = F_ij A_i / A_j
+		for (int side = 0; side < 2; ++side) {
+			if (factor[side] == 0.f) continue;
+			glm::vec3 received = receiver.reflectance * shot * (factor[side] * shooter.area / receiver.area);
+			m_radiance[2 * receiverIndex + side] += received;
+			m_unshot[2 * receiverIndex + side] += received;
+		}
+	});
+}
+
+int RadiositySolver::patchAt(int quad, const glm::vec2& uv) const {
+	const Surface& surface = m_surfaces[quad];
+	int i = glm::clamp(static_cast<int>(uv.x * surface.resolution[0]), 0, surface.resolution[0] - 1);
+	int j = glm::clamp(static_cast<int>(uv.y * surface.resolution[1]), 0, surface.resolution[1] - 1);
+	return surface.firstPatch + j * surface.resolution[0] + i;
+}
+
+std::shared_ptr<Hittable> RadiositySolver::scene() const {
+	std::vector<std::shared_ptr<Hittable>> quads;
+	const int subdivision = glm::max(m_settings.displaySubdivision, 1);
+
+	for (int quad = 0; quad < static_cast<int>(m_surfaces.size()); ++quad) {
+		const Surface& surface = m_surfaces[quad];
+		const int width = surface.resolution[0] * subdivision;
+		const int height = surface.resolution[1] * subdivision;
+
+		std::shared_ptr<Material> sides[2];
+		for (int side = 0; side < 2; ++side) {
+			// bilinear interpolation between patch centers, clamped at the quad's edges
+			std::vector<glm::vec3> texels(width * height);
+			for (int y = 0; y < height; ++y) {
+				for (int x = 0; x < width; ++x) {
+					glm::vec2 p = (glm::vec2(x, y) + 0.5f) / static_cast<float>(subdivision) - 0.5f;
+					glm::vec2 p0 = glm::floor(p);
+					glm::vec2 t = p - p0;
+
+					glm::vec3 value = glm::vec3(0.f);
+					for (int corner = 0; corner < 4; ++corner) {
+						int dx = corner & 1, dy = corner >> 1;
+						int i = glm::clamp(static_cast<int>(p0.x) + dx, 0, surface.resolution[0] - 1);
+						int j = glm::clamp(static_cast<int>(p0.y) + dy, 0, surface.resolution[1] - 1);
+						float weight = (dx ? t.x : 1.f - t.x) * (dy ? t.y : 1.f - t.y);
+						value += weight * radiance(surface.firstPatch + j * surface.resolution[0] + i, side);
+					}
+					texels[y * width + x] = value;
+				}
+			}
+			sides[side] = std::make_shared<DiffuseEmissive>(std::make_shared<RadiosityTexture>(width, height, std::move(texels)));
+		}
+		quads.push_back(std::make_shared<TwoSidedQuad>(surface.corner, surface.side1, surface.side2, sides[0], sides[1]));
+	}
+
+	if (quads.empty()) return std::make_shared<HittableList>();
+	return std::make_shared<BVHNode>(quads, 0, quads.size());
+}
+
+uint64_t RadiositySolver::patchHash() const {
+	// FNV-1a over the floats' bits
+	uint64_t hash = 14695981039346656037ull;
+	auto add = [&hash](const glm::vec3& v) {
+		for (int c = 0; c < 3; ++c) {
+			uint32_t bits;
+			std::memcpy(&bits, &v[c], sizeof(bits));
+			hash = (hash ^ bits) * 1099511628211ull;
+		}
+	};
+	for (const Patch& patch : m_patches) {
+		add(patch.corner);
+		add(patch.side1);
+		add(patch.side2);
+		add(patch.reflectance);
+		add(patch.emitted);
+	}
+	return hash;
+}
+
+bool RadiositySolver::write(const std::string& file) const {
+	const std::string temporary = file + ".tmp";
+	std::FILE* f = std::fopen(temporary.c_str(), "wb");
+	if (f == nullptr) return false;
+	const uint32_t patches = static_cast<uint32_t>(m_patches.size());
+	const uint64_t hash = patchHash();
+	bool ok = writeValues(f, magic, 4)
+		&& writeValues(f, &version, 1)
+		&& writeValues(f, &patches, 1)
+		&& writeValues(f, &hash, 1)
+		&& writeValues(f, m_radiance.data(), m_radiance.size())
+		&& writeValues(f, m_unshot.data(), m_unshot.size());
+	ok = std::fclose(f) == 0 && ok;
+	if (ok && replaceFile(temporary, file)) return true;
+	std::remove(temporary.c_str());
+	return false;
+}
+
+bool RadiositySolver::read(const std::string& file) {
+	std::FILE* f = std::fopen(file.c_str(), "rb");
+	if (f == nullptr) return false;
+	char fileMagic[4];
+	uint32_t fileVersion = 0, patches = 0;
+	uint64_t hash = 0;
+	std::vector<glm::vec3> radiance(m_radiance.size()), unshot(m_unshot.size());
+	bool ok = readValues(f, fileMagic, 4) && std::memcmp(fileMagic, magic, 4) == 0
+		&& readValues(f, &fileVersion, 1) && fileVersion == version
+		&& readValues(f, &patches, 1) && patches == m_patches.size()
+		&& readValues(f, &hash, 1) && hash == patchHash()
+		&& readValues(f, radiance.data(), radiance.size())
+		&& readValues(f, unshot.data(), unshot.size());
+	std::fclose(f);
+	if (!ok) {
+		std::clog << "Can't read radiosity solution: " << file << '\n';
+		return false;
+	}
+	m_radiance.swap(radiance);
+	m_unshot.swap(unshot);
+	return true;
+}
+
+bool RadiositySolver::unoccluded(const glm::vec3& a, const glm::vec3& b) const {
+	glm::vec3 d = b - a;
+	float dist = glm::length(d);
+	if (dist <= 2.f * rayEpsilon) return true;
+	Hittable::HitRecord hit;
+	return !m_world.hit(Ray(a, d / dist), Interval(rayEpsilon, dist - rayEpsilon), hit);
+}
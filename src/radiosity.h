@@ -0,0 +1,91 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "hittable.h"
+#include "material.h"
+#include "parallel.h"
+
+// Progressive refinement radiosity (Cohen et al. 1988) for scenes made only of quads with diffuse or emissive materials.
+// Every quad is split into patches of about patchSize, and each side of a patch keeps its own radiance, since quads
+// can be seen (and lit) from both sides. Each shot takes the patch side with the most unshot power and distributes
+// that power to all other patches, with form factors estimated from random point pairs and occlusion rays traced
+// through the world; receivers are processed in parallel, by threads kept for the whole solve. Shooting stops once the
+// unshot power falls below a fraction of the emitted power.
+// The solution is view-independent: scene() turns it into emissive quads, so that any view of it can be rendered
+// with one primary ray per pixel (Renderer with 0 bounces and 1 sample per pixel). write() saves it, so that later
+// renders of the same scene, such as the frames of a fly-through, can read() it rather than solve again.
+class RadiositySolver {
+public:
+	struct Settings {
+		float patchSize = 0.f;	// 0 picks 1/16 of the scene's longest side
+		int formFactorSamples = 4;	// point pairs per form factor
+		float convergenceThreshold = 0.01f;	// stop once unshot power is below this fraction of emitted power
+		int maxShots = 100000;
+		int displaySubdivision = 4;	// texels per patch side in scene(), interpolated between patch centers
+	};
+
+	// world is used both for its quads and for occlusion rays, so it should be a BVH
+	RadiositySolver(const Hittable& world, const Settings& settings, int threadCount);
+
+	// False if the world has surfaces other than quads, or specular materials; the solver does nothing then
+	bool valid() const { return m_valid; }
+	int patchCount() const { return static_cast<int>(m_patches.size()); }
+
+	// Shoots until converged or out of shots; returns the number of shots taken
+	int solve();
+	// Fraction of the emitted power that has not been shot yet
+	float unshotFraction() const;
+
+	// Radiance leaving side (0: the side cross(side1, side2) points to, 1: the other) of a patch
+	const glm::vec3& radiance(int patch, int side) const { return m_radiance[2 * patch + side]; }
+	// Index of the patch containing a point of the given quad, in the order forEachQuad visits them
+	int patchAt(int quad, const glm::vec2& uv) const;
+
+	// Emissive quads showing the current solution, in a BVH
+	std::shared_ptr<Hittable> scene() const;
+
+	// Saves the current solution, through a temporary file like AccumulationBuffer::write()
+	bool write(const std::string& file) const;
+	// Reads a solution written by write() for the same patches, with the same materials, which solve() can refine
+	// further; returns false and keeps the current solution if the file can't be read or is for other patches
+	bool read(const std::string& file);
+private:
+	struct Surface {
+		glm::vec3 corner = glm::vec3(0.f);
+		glm::vec3 side1 = glm::vec3(0.f);
+		glm::vec3 side2 = glm::vec3(0.f);
+		std::shared_ptr<Material> material = nullptr;
+		int resolution[2] = { 1, 1 };	// patches along side1 and side2
+		int firstPatch = 0;
+	};
+
+	struct Patch {
+		glm::vec3 corner = glm::vec3(0.f);
+		glm::vec3 side1 = glm::vec3(0.f);
+		glm::vec3 side2 = glm::vec3(0.f);
+		glm::vec3 normal = glm::vec3(0.f);	// of side 0
+		float area = 0.f;
+		glm::vec3 reflectance = glm::vec3(0.f);
+		glm::vec3 emitted = glm::vec3(0.f);
+	};
+
+	const Hittable& m_world;
+	Settings m_settings;
+	int m_threadCount = 1;
+	bool m_valid = false;
+
+	std::vector<Surface> m_surfaces;
+	std::vector<Patch> m_patches;
+	std::vector<glm::vec3> m_radiance;	// two sides per patch
+	std::vector<glm::vec3> m_unshot;	// radiance received but not shot yet, two sides per patch
+	float m_emittedPower = 0.f;
+
+	void shoot(int element, WorkerPool& workers);
+	// a hash of the patches' geometry and materials, to tell saved solutions for other scenes or settings apart
+	uint64_t patchHash() const;
+	bool unoccluded(const glm::vec3& a, const glm::vec3& b) const;
+};
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "common.h"
+#include "hittable.h"
+#include "ray.h"
+
+// Rays through the neighboring pixels to the right of and below a camera ray's, carried along with it through specular
+// bounces. Where they cross the surface a ray hits tells how much of that surface the pixel covers, which texture lookups
+// then filter over (Igehy 1999, "Tracing Ray Differentials").
+struct RayDifferential {
+	bool valid = false;
+	Ray dx;
+	Ray dy;
+
+	// Moves the offset rays to s times their offset from ray, e.g. so that each of many samples of a pixel filters over less
+	// than the whole pixel
+	void scale(const Ray& ray, float s) {
+		dx = Ray(ray.origin() + s * (dx.origin() - ray.origin()), ray.direction() + s * (dx.direction() - ray.direction()));
+		dy = Ray(ray.origin() + s * (dy.origin() - ray.origin()), ray.direction() + s * (dy.direction() - ray.direction()));
+	}
+};
+
+// Where offset ray crosses the plane tangent to the surface at hit; the hit point itself for rays parallel to the plane
+inline glm::vec3 tangentPlaneCrossing(const Ray& offset, const Hittable::HitRecord& hit) {
+	float denom = glm::dot(hit.normal, offset.direction());
+	if (glm::abs(denom) < 1e-8f) return hit.point;
+	return offset.at(glm::dot(hit.normal, hit.point - offset.origin()) / denom);
+}
+
+// Sets hit.dUVdx and hit.dUVdy, how far uv moves from one pixel to the next, by expressing the offset rays' crossings of the
+// tangent plane in terms of the surface derivatives hit.dpdu and hit.dpdv. Leaves them zero without differentials, or if the
+// surface has no derivatives.
+inline void surfaceDifferentials(const RayDifferential& differential, Hittable::HitRecord& hit) {
+	hit.dUVdx = hit.dUVdy = glm::vec2(0.f);
+	if (!differential.valid) return;
+	const glm::vec3 dpdx = tangentPlaneCrossing(differential.dx, hit) - hit.point;
+	const glm::vec3 dpdy = tangentPlaneCrossing(differential.dy, hit) - hit.point;
+
+	// dp = dpdu * du + dpdv * dv is overdetermined; solve it in the two axes the normal is least aligned with
+	const glm::vec3 n = glm::abs(hit.normal);
+	const int a = n.x > n.y && n.x > n.z ? 1 : 0;
+	const int b = n.z > n.x && n.z > n.y ? 1 : 2;
+	const float det = hit.dpdu[a] * hit.dpdv[b] - hit.dpdv[a] * hit.dpdu[b];
+	if (glm::abs(det) < 1e-12f) return;
+	auto solve = [&](const glm::vec3& dp) {
+		return glm::vec2(hit.dpdv[b] * dp[a] - hit.dpdv[a] * dp[b], hit.dpdu[a] * dp[b] - hit.dpdu[b] * dp[a]) / det;
+	};
+	hit.dUVdx = solve(dpdx);
+	hit.dUVdy = solve(dpdy);
+}
+
+// The differential of scatteredRay, the mirror reflection of a ray at hit, treating the surface as flat around the hit point
+inline RayDifferential reflectDifferential(const RayDifferential& differential, const Hittable::HitRecord& hit, const Ray& scatteredRay) {
+	RayDifferential reflected;
+	reflected.valid = differential.valid;
+	if (!reflected.valid) return reflected;
+	reflected.dx = Ray(tangentPlaneCrossing(differential.dx, hit), glm::reflect(differential.dx.direction(), hit.normal));
+	reflected.dy = Ray(tangentPlaneCrossing(differential.dy, hit), glm::reflect(differential.dy.direction(), hit.normal));
+	return reflected;
+}
+
+// The same for scatteredRay refracted at hit, with iorRatio = ior on the incident side / ior on the transmitted side
+inline RayDifferential refractDifferential(const RayDifferential& differential, const Hittable::HitRecord& hit, const Ray& scatteredRay, float iorRatio) {
+	RayDifferential refracted;
+	refracted.valid = differential.valid;
+	if (!refracted.valid) return refracted;
+	auto refract = [&](const Ray& offset) {
+		glm::vec3 incident = glm::normalize(offset.direction());
+		float cosIncident = -glm::dot(incident, hit.normal);
+		float sin2Transmitted = iorRatio * iorRatio * (1.f - cosIncident * cosIncident);
+		// an offset ray past the critical angle would be reflected: keep the main ray's direction instead
+		glm::vec3 direction = sin2Transmitted >= 1.f ? scatteredRay.direction()
+			: iorRatio * incident + (iorRatio * cosIncident - glm::sqrt(1.f - sin2Transmitted)) * hit.normal;
+		return Ray(tangentPlaneCrossing(offset, hit), direction);
+	};
+	refracted.dx = refract(differential.dx);
+	refracted.dy = refract(differential.dy);
+	return refracted;
+}
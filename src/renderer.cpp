@@ -1,45 +1,517 @@
 #include "renderer.h"
 
+#include <algorithm>
 #include <iostream>
+#include <mutex>
 
-void Renderer::render(const Hittable& world, const Camera& camera, Image& output) {
+#include "accumulation_buffer.h"
+#include "bdpt.h"
+#include "cache_stats.h"
+#include "exr_writer.h"
+#include "pixel_conversion.h"
+#include "png_writer.h"
+#include "splat_image.h"
+
+void Renderer::render(const Hittable& world, const Camera& camera, Image& output, const HittableList& lights) {
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
 	const float sampleFrac = 1.f / static_cast<float>(m_samplesPerPixel);
-	
-	for (int y = 0; y < output.height(); ++y) {
-		std::clog << "\rScanlines remaining: " << (output.height() - y) << ' ' << std::flush;
 
-		for (int x = 0; x < output.width(); ++x) {
-			glm::vec3 color = glm::vec3(0.f);
+	m_radianceCache.reset();
+	if (m_textureCache) m_textureCache->resetStats();
+#ifdef RAYTRACER_CACHE_STATS
+	cacheStats::reset();
+#endif
+	if (m_radianceCacheSettings.enabled) {
+		float cellSize = m_radianceCacheSettings.cellSize;
+		if (cellSize <= 0.f) {
+			const AABox bounds = world.boundingBox();
+			cellSize = bounds.getInterval(bounds.longestAxis()).size() / 64.f;
+		}
+		m_radianceCache.reset(new RadianceCache(cellSize, m_radianceCacheSettings.capacity, m_radianceCacheSettings.minSamples));
+	}
+
+	const bool timeBudget = m_timeBudget.seconds > 0.;
+	const bool progressive = m_progressive.enabled && !timeBudget;
+	if ((timeBudget || progressive) && (m_integrator == Integrator::Metropolis || m_integrator == Integrator::Bidirectional)) {
+		std::clog << (timeBudget ? "Time budget" : "Progressive rendering") << " not supported by this integrator; rendering "
+			<< m_samplesPerPixel << " samples per pixel\n";
+	}
+	const bool outOfCore = m_outOfCore.enabled && !timeBudget && !progressive
+		&& (m_integrator == Integrator::PathTracing || m_integrator == Integrator::InstantRadiosity);
+	if (m_outOfCore.enabled && !outOfCore) {
+		std::clog << "Out-of-core rendering not supported by this integrator or with a time budget or progressive passes; rendering in memory\n";
+	}
+	const bool aovs = m_aovs.any() && (m_integrator == Integrator::PathTracing || m_integrator == Integrator::InstantRadiosity);
+	if (m_aovs.any() && !aovs) {
+		std::clog << "AOVs not supported by this integrator\n";
+	}
+
+	if (m_integrator == Integrator::Metropolis) {
+		renderMetropolis(world, camera, output);
+		finishRender();
+		return;
+	}
+
+	const bool bidirectional = m_integrator == Integrator::Bidirectional;
+	const bool instantRadiosity = m_integrator == Integrator::InstantRadiosity;
+
+	BDPTIntegrator bdpt(world, lights, camera, m_maxBounces);
+	SplatImage lightImage(bidirectional ? output.width() : 0, bidirectional ? output.height() : 0);
+
+	// VPLs are traced once for the whole image
+	std::unique_ptr<InstantRadiosityIntegrator> vplIntegrator;
+	if (instantRadiosity) {
+		vplIntegrator.reset(new InstantRadiosityIntegrator(world, lights, m_instantRadiositySettings, m_maxBounces, m_threadCount));
+	}
+
+	const glm::ivec2 size = outOfCore ? glm::ivec2(camera.projection().imageSize()) : glm::ivec2(output.width(), output.height());
+	const PixelRect image(glm::ivec2(0), size);
+	const PixelRect area = m_cropWindow.empty() ? image : m_cropWindow.intersect(image);
+	std::vector<PixelRect> tiles = makeTiles(area, m_tileSize);
+	orderTiles(tiles, area, m_tileSize, m_tileOrder, m_tileImportance);
+	m_tilePixels = tilePixelOrder(m_tileSize, m_pixelOrder);
+	m_tileLayout = AccumulationLayout();
+	m_tileLayout.blockSize = m_tileSize;
+	m_tileLayout.blockOrigin = area.min;
+	if (aovs && outOfCore) {
+		// sums over the whole image would take as much memory as the framebuffer kept out of it
+		m_tiledAovBuffer.reset(new TiledAovBuffer(size.x, size.y, m_aovs, area, m_tileSize));
+	}
+	else if (aovs) {
+		m_aovBuffer.reset(new AovBuffer(size.x, size.y, m_aovs, m_tileLayout));
+	}
+
+	auto radiance = [&](int x, int y, Sampler& sampler) {
+		if (bidirectional) {
+			return bdpt.sample(x, y, sampler, lightImage);
+		}
+		// the first hit of the camera ray, from the same traversal as the radiance
+		AovSample firstHit;
+		AovSample* aov = m_aovBuffer || m_tiledAovBuffer ? &firstHit : nullptr;
+		glm::vec3 color;
+		if (instantRadiosity) {
+			color = vplIntegrator->radiance(camera.getRay(x, y, sampler), sampler, aov);
+		}
+		else {
+			RayDifferential differential;
+			Ray ray = camera.getRay(x, y, sampler, differential);
+			differential.scale(ray, differentialScale());
+			color = rayColor(world, ray, differential, m_maxBounces, sampler, aov);
+		}
+		if (m_aovBuffer) m_aovBuffer->add(x, y, firstHit, color);
+		else if (m_tiledAovBuffer) m_tiledAovBuffer->add(x, y, firstHit, color);
+		return color;
+	};
+
+	if (timeBudget && !bidirectional) {
+		renderTimeBudget(output, tiles, start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(m_timeBudget.seconds)), radiance);
+		finishRender();
+		return;
+	}
+	if (progressive && !bidirectional) {
+		renderProgressive(output, tiles, radiance);
+		finishRender();
+		return;
+	}
+
+	if (outOfCore) {
+		renderOutOfCore(output, size, area, tiles, radiance);
+		finishRender();
+		return;
+	}
+
+	// tiles write to blocks of their own, so threads never share cache lines; the image is only written once they are done
+	AccumulationLayout layout = m_tileLayout;
+	layout.variance = false;
+	AccumulationBuffer buffer(output.width(), output.height(), layout);
+	renderTiles(buffer, tiles, radiance, [](const PixelRect&) {});
+	buffer.resolve(output, area);
+
+	// light subpaths start one per camera sample, so with a crop window fewer of them cover the whole image; only the
+	// splats inside the window are kept
+	if (bidirectional && area.area() > 0) {
+		const float lightScale = sampleFrac * static_cast<float>(image.area()) / static_cast<float>(area.area());
+		for (int y = area.min.y; y < area.max.y; ++y) {
+			for (int x = area.min.x; x < area.max.x; ++x) {
+				output.set(x, y, output.get(x, y) + lightScale * lightImage.get(x, y));
+			}
+		}
+	}
+	finishRender();
+
+	std::clog << "\rDone.                 \n";
+}
+
+template<typename Buffer, typename TileDone>
+void Renderer::renderTiles(Buffer& buffer, const std::vector<PixelRect>& tiles, const PixelRadiance& radiance, const TileDone& tileDone) {
+	std::atomic<int> remaining(static_cast<int>(tiles.size()));
+	std::mutex logMutex;
+	std::clog << "\rTiles remaining: " << remaining << ' ' << std::flush;
+
+	parallelFor(static_cast<int>(tiles.size()), m_threadCount, [&](int i) {
+		const PixelRect& tile = tiles[i];
+		std::unique_ptr<Sampler> pixelSampler = makeSampler();
+		Sampler& sampler = *pixelSampler;
+		forEachPixel(tile, m_tilePixels, [&](int x, int y) {
 			for (int s = 0; s < m_samplesPerPixel; ++s) {
-				Ray ray = camera.getRay(x, y, true);
-				color += rayColor(world, ray, m_maxBounces);
+				sampler.startPixelSample(glm::ivec2(x, y), s);
+				buffer.add(x, y, radiance(x, y, sampler));
+			}
+		});
+		tileDone(tile);
+
+		int left = --remaining;
+		std::lock_guard<std::mutex> lock(logMutex);
+		std::clog << "\rTiles remaining: " << left << ' ' << std::flush;
+	});
+}
+
+void Renderer::finishRender() {
+	if (m_aovBuffer) m_aovBuffer->resolve();
+	m_aovBuffer.reset();
+	m_tiledAovBuffer.reset();
+	m_radianceCache.reset();
+	if (m_textureCache) {
+		const TextureCacheStats stats = m_textureCache->stats();
+		std::clog << "\rTexture cache: hit rate " << stats.hitRate() << ", " << stats.bytesRead / (1024 * 1024) << " MiB read, "
+			<< stats.evictions << " pages evicted\n";
+	}
+#ifdef RAYTRACER_CACHE_STATS
+	const CacheStats stats = cacheStats::collect();
+	std::clog << "\rCache model: " << stats.accesses << " accesses, L1 miss rate " << stats.l1MissRate()
+		<< ", L2 miss rate " << stats.l2MissRate() << '\n';
+#endif
+}
+
+namespace {
+	// A tile of the time-budget mode, with the statistics its allocation is based on
+	struct BudgetTile {
+		glm::ivec2 min = glm::ivec2(0);
+		glm::ivec2 max = glm::ivec2(0);	// exclusive
+		int samples = 0;	// per pixel, the same for every pixel of the tile
+		double seconds = 0.;	// thread time spent on the tile
+		int rounds = 0;	// samples per pixel to add in the current pass
+		float sigma = 0.f;	// standard deviation of one sample, averaged over the tile's pixels
+		double cost = 0.;	// thread seconds per pixel sample
+
+		int pixelCount() const { return (max.x - min.x) * (max.y - min.y); }
+	};
+}
+
+void Renderer::renderTimeBudget(Image& output, const std::vector<PixelRect>& rects, std::chrono::steady_clock::time_point deadline, const PixelRadiance& radiance) {
+	typedef std::chrono::steady_clock Clock;
+	AccumulationBuffer buffer(output.width(), output.height(), m_tileLayout);
+
+	std::vector<BudgetTile> tiles(rects.size());
+	for (size_t i = 0; i < rects.size(); ++i) {
+		tiles[i].min = rects[i].min;
+		tiles[i].max = rects[i].max;
+	}
+
+	// Adds tile.rounds samples to every pixel of the tile, one round at a time, and stops early if the next round would
+	// finish after the deadline (never during the pilot pass, when the tile has no cost estimate yet)
+	auto renderTile = [&](BudgetTile& tile) {
+		std::unique_ptr<Sampler> tileSampler = makeSampler();
+		Sampler& sampler = *tileSampler;
+		const Clock::duration roundTime = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(tile.cost * tile.pixelCount()));
+		for (int round = 0; round < tile.rounds; ++round) {
+			Clock::time_point roundStart = Clock::now();
+			if (tile.samples > 0 && roundStart + roundTime > deadline) break;
+			forEachPixel(PixelRect(tile.min, tile.max), m_tilePixels, [&](int x, int y) {
+				sampler.startPixelSample(glm::ivec2(x, y), buffer.count(x, y));
+				buffer.add(x, y, radiance(x, y, sampler));
+			});
+			++tile.samples;
+			tile.seconds += std::chrono::duration<double>(Clock::now() - roundStart).count();
+		}
+	};
+
+	if (tiles.empty()) return;
+
+	std::clog << "\rTime budget: pilot pass " << std::flush;
+	for (BudgetTile& tile : tiles) {
+		tile.rounds = glm::max(1, m_timeBudget.pilotSamples);
+	}
+	parallelFor(static_cast<int>(tiles.size()), m_threadCount, [&](int i) {
+		renderTile(tiles[i]);
+	});
+	if (Clock::now() > deadline) {
+		std::clog << "\rTime budget: the pilot pass alone took longer than the budget\n";
+	}
+
+	std::vector<int> order(tiles.size());
+	int passes = 0;
+	for (;; ++passes) {
+		double remaining = std::chrono::duration<double>(deadline - Clock::now()).count();
+		if (remaining <= 0.) break;
+		std::clog << "\rTime budget: " << static_cast<int>(glm::ceil(remaining)) << " s remaining   " << std::flush;
+
+		// per-tile cost and standard deviation so far; every tile keeps some share, as a few pilot samples may all have missed a light
+		double spent = 0., meanSigma = 0.;
+		for (BudgetTile& tile : tiles) {
+			tile.cost = glm::max(tile.seconds / (static_cast<double>(tile.samples) * tile.pixelCount()), 1e-9);
+			float variance = 0.f;
+			for (int y = tile.min.y; y < tile.max.y; ++y) {
+				for (int x = tile.min.x; x < tile.max.x; ++x) {
+					variance += buffer.variance(x, y);
+				}
 			}
-			output.set(x, y, color * sampleFrac);
+			tile.sigma = glm::sqrt(variance / static_cast<float>(tile.pixelCount()));
+			spent += tile.seconds;
+			meanSigma += tile.sigma;
+		}
+		meanSigma = meanSigma > 0. ? meanSigma / tiles.size() : 1.;
+		for (BudgetTile& tile : tiles) {
+			tile.sigma = glm::max(tile.sigma, 0.25f * static_cast<float>(meanSigma));
+		}
+
+		// Minimizing the summed variance of the pixel means, sum(pixels * sigma^2 / samples), for a total cost
+		// sum(cost * pixels * samples) = budget gives samples proportional to sigma / sqrt(cost)
+		const double budget = spent + remaining * m_threadCount;
+		double normalization = 0.;
+		for (const BudgetTile& tile : tiles) {
+			normalization += tile.pixelCount() * tile.sigma * glm::sqrt(tile.cost);
+		}
+
+		// this pass closes part of each tile's gap to its target, taking about half of the remaining time, so that
+		// the estimates are refreshed before the rest is spent
+		double deficitCost = 0.;
+		std::vector<double> deficits(tiles.size());
+		for (size_t i = 0; i < tiles.size(); ++i) {
+			const BudgetTile& tile = tiles[i];
+			double target = budget * tile.sigma / (glm::sqrt(tile.cost) * normalization);
+			deficits[i] = glm::max(0., target - tile.samples);
+			deficitCost += deficits[i] * tile.cost * tile.pixelCount();
+		}
+		const double share = deficitCost > 0. ? glm::min(1., 0.5 * remaining * m_threadCount / deficitCost) : 0.;
+		for (size_t i = 0; i < tiles.size(); ++i) {
+			tiles[i].rounds = deficits[i] > 0. ? glm::max(1, static_cast<int>(deficits[i] * share + 0.5)) : 0;
+		}
+
+		// highest error reduction per unit of time first, so that what the deadline cuts off matters least
+		auto gain = [&](const BudgetTile& tile) {
+			return tile.sigma * tile.sigma / (static_cast<double>(tile.samples) * (tile.samples + 1) * tile.cost);
+		};
+		for (size_t i = 0; i < order.size(); ++i) order[i] = static_cast<int>(i);
+		std::sort(order.begin(), order.end(), [&](int a, int b) { return gain(tiles[a]) > gain(tiles[b]); });
+		if (deficitCost <= 0.) tiles[order[0]].rounds = 1;
+
+		std::atomic<int> renderedTiles(0);
+		parallelFor(static_cast<int>(order.size()), m_threadCount, [&](int i) {
+			BudgetTile& tile = tiles[order[i]];
+			int before = tile.samples;
+			renderTile(tile);
+			if (tile.samples > before) ++renderedTiles;
+		});
+		if (renderedTiles == 0) break;
+	}
+
+	for (const PixelRect& rect : rects) {
+		buffer.resolve(output, rect);
+	}
+
+	int minSamples = tiles.front().samples, maxSamples = 0;
+	double totalSamples = 0., pixels = 0.;
+	for (const BudgetTile& tile : tiles) {
+		minSamples = glm::min(minSamples, tile.samples);
+		maxSamples = glm::max(maxSamples, tile.samples);
+		totalSamples += static_cast<double>(tile.samples) * tile.pixelCount();
+		pixels += tile.pixelCount();
+	}
+	std::clog << "\rDone: " << passes << " passes after the pilot, " << minSamples << " to " << maxSamples << " samples per pixel, "
+		<< totalSamples / pixels << " on average\n";
+}
+
+void Renderer::renderProgressive(Image& output, const std::vector<PixelRect>& tiles, const PixelRadiance& radiance) {
+	typedef std::chrono::steady_clock Clock;
+	const int passSamples = glm::max(1, m_progressive.passSamples);
+	const bool checkpoints = !m_progressive.checkpointFile.empty();
+
+	AccumulationBuffer buffer(output.width(), output.height(), m_tileLayout);
+	if (checkpoints && m_progressive.resume) {
+		AccumulationBuffer checkpoint(m_progressive.checkpointFile, m_tileLayout);
+		if (checkpoint.width() == output.width() && checkpoint.height() == output.height()) {
+			buffer = std::move(checkpoint);
+			std::clog << "Resuming from " << m_progressive.checkpointFile << '\n';
+		}
+		else if (checkpoint.width() > 0) {
+			std::clog << "Checkpoint " << m_progressive.checkpointFile << " is for another image size; starting over\n";
+		}
+	}
+	// sample indices continue from each pixel's count, so samples added with this seed never repeat earlier ones
+	buffer.addSeed(m_seed);
+
+	auto saveCheckpoint = [&]() {
+		if (!buffer.write(m_progressive.checkpointFile)) {
+			std::clog << "\nCould not write checkpoint " << m_progressive.checkpointFile << '\n';
+		}
+	};
+
+	const int passes = (m_samplesPerPixel + passSamples - 1) / passSamples;
+	Clock::time_point lastCheckpoint = Clock::now();
+	for (int pass = 0; pass < passes; ++pass) {
+		std::clog << "\rPass " << pass + 1 << " of " << passes << ' ' << std::flush;
+		const int target = glm::min(m_samplesPerPixel, (pass + 1) * passSamples);
+		parallelFor(static_cast<int>(tiles.size()), m_threadCount, [&](int i) {
+			const PixelRect& tile = tiles[i];
+			std::unique_ptr<Sampler> pixelSampler = makeSampler();
+			Sampler& sampler = *pixelSampler;
+			forEachPixel(tile, m_tilePixels, [&](int x, int y) {
+				for (int s = buffer.count(x, y); s < target; ++s) {
+					sampler.startPixelSample(glm::ivec2(x, y), s);
+					buffer.add(x, y, radiance(x, y, sampler));
+				}
+			});
+		});
+
+		if (checkpoints && pass + 1 < passes && std::chrono::duration<double>(Clock::now() - lastCheckpoint).count() >= m_progressive.checkpointSeconds) {
+			saveCheckpoint();
+			lastCheckpoint = Clock::now();
 		}
 	}
+	if (checkpoints) saveCheckpoint();
 
+	for (const PixelRect& tile : tiles) {
+		buffer.resolve(output, tile);
+	}
 	std::clog << "\rDone.                 \n";
 }
 
-glm::vec3 Renderer::rayColor(const Hittable& world, const Ray& ray, int depth) {
+void Renderer::renderOutOfCore(Image& output, const glm::ivec2& size, const PixelRect& area, const std::vector<PixelRect>& tiles, const PixelRadiance& radiance) {
+	// blocks match the tiles, so a finished tile's pages can go back to the file without holding up its neighbors
+	MappedFramebuffer framebuffer(m_outOfCore.framebufferFile, size.x, size.y, m_tileSize, area.min);
+	if (!framebuffer.valid()) {
+		std::clog << "Can't map framebuffer file " << m_outOfCore.framebufferFile << '\n';
+		return;
+	}
+	renderTiles(framebuffer, tiles, radiance, [&](const PixelRect& tile) {
+		framebuffer.release(tile);
+		if (m_tiledAovBuffer) m_tiledAovBuffer->tileDone(tile);
+	});
+
+	if (output.width() == size.x && output.height() == size.y) {
+		for (const PixelRect& tile : tiles) {
+			for (int y = tile.min.y; y < tile.max.y; ++y) {
+				for (int x = tile.min.x; x < tile.max.x; ++x) {
+					output.set(x, y, framebuffer.mean(x, y));
+				}
+			}
+			framebuffer.release(tile);
+		}
+	}
+	if (!m_outOfCore.outputFile.empty() && !writeOutOfCore(framebuffer, area)) {
+		std::clog << "\nCan't write image: " << m_outOfCore.outputFile << '\n';
+		return;
+	}
+	std::clog << "\rDone.                 \n";
+}
+
+bool Renderer::writeOutOfCore(MappedFramebuffer& framebuffer, const PixelRect& area) const {
+	const std::string& file = m_outOfCore.outputFile;
+	const int width = framebuffer.width(), height = framebuffer.height();
+	const bool exr = file.size() >= 4 && file.compare(file.size() - 4, 4, ".exr") == 0;
+	if (exr) {
+		// a tile at a time, resolved into an image of its own
+		ExrWriter writer(file, width, height, { { "", nullptr, ExrWriter::PixelType::Half } }, ExrWriter::Compression::Zip, m_tileSize);
+		if (!writer.ok()) return false;
+		std::atomic<bool> ok(true);
+		parallelFor(writer.chunks(), m_threadCount, [&](int chunk) {
+			const PixelRect rect = writer.chunkRect(chunk);
+			Image tile(rect.max.x - rect.min.x, rect.max.y - rect.min.y);
+			framebuffer.resolveTile(tile, rect);
+			if (!writer.writeChunk(chunk, { &tile })) ok = false;
+			framebuffer.release(rect);
+		});
+		return ok && writer.finish();
+	}
+
+	// a row at a time, as PNG stores them, each once, releasing each row of blocks after its last row; a group of rows
+	// still reading that block row's earlier rows on another thread only pages them back in
+	const GammaEncoder encode(2.2f);
+	return writePng(file, width, height, [&](int y, uint8_t* row) {
+		for (int x = 0; x < width; ++x) {
+			const glm::vec3 pixel = framebuffer.mean(x, y);
+			for (int c = 0; c < Image::channels; ++c) {
+				row[x * Image::channels + c] = encode(pixel[c]);
+			}
+		}
+		if (y == height - 1 || (y + 1 - area.min.y) % m_tileSize == 0) {
+			framebuffer.release(PixelRect(glm::ivec2(0, y), glm::ivec2(width, y + 1)));
+		}
+	}, m_threadCount);
+}
+
+std::unique_ptr<Sampler> Renderer::makeSampler() const {
+	switch (m_samplerType) {
+	case SamplerType::Stratified:
+		return std::unique_ptr<Sampler>(new StratifiedSampler(m_samplesPerPixel, m_seed));
+	case SamplerType::Sobol:
+		return std::unique_ptr<Sampler>(new SobolSampler(m_seed));
+	case SamplerType::BlueNoise:
+		return std::unique_ptr<Sampler>(new BlueNoiseSampler(m_seed));
+	default:
+		return std::unique_ptr<Sampler>(new IndependentSampler());
+	}
+}
+
+void Renderer::renderMetropolis(const Hittable& world, const Camera& camera, Image& output) {
+	const glm::ivec2 size(output.width(), output.height());
+
+	// the first two numbers pick the pixel, so mutations can move a path across the image
+	MetropolisIntegrator metropolis(m_metropolisSettings, [&](Sampler& sampler, glm::ivec2& pixel) {
+		glm::vec2 u = sampler.get2D();
+		pixel = glm::min(glm::ivec2(u * glm::vec2(size)), size - 1);
+		RayDifferential differential;
+		Ray ray = camera.getRay(pixel.x, pixel.y, sampler, differential);
+		differential.scale(ray, differentialScale());
+		return rayColor(world, ray, differential, m_maxBounces, sampler);
+	});
+	metropolis.render(output, m_samplesPerPixel, m_threadCount);
+
+	std::clog << "\rDone.                 \n";
+}
+
+float Renderer::differentialScale() const {
+	// each of n samples of a pixel only needs to filter over about 1/sqrt(n) of it, but not so little that lookups alias
+	return glm::max(0.125f, 1.f / glm::sqrt(static_cast<float>(glm::max(1, m_samplesPerPixel))));
+}
+
+glm::vec3 Renderer::rayColor(const Hittable& world, const Ray& ray, const RayDifferential& differential, int depth, Sampler& sampler, AovSample* firstHit) {
 	if (depth < 0) return glm::vec3(0.f);
+	sampler.startBounce(m_maxBounces - depth);
 
 	float reflectance = 0.1f;
 	const float eps = 1e-3f;
 	Hittable::HitRecord hit;
 	if (!world.hit(ray, Interval(eps, infinity), hit))
 		return envColor(ray);
+	surfaceDifferentials(differential, hit);
+	if (firstHit != nullptr) *firstHit = AovSample(ray, hit);
+
+	// Diffuse radiance does not depend on the viewing direction, so it can be shared between paths through the same cell
+	const bool cacheable = m_radianceCache && hit.material->isDiffuse();
+	const int bounce = m_maxBounces - depth;
+	if (cacheable && m_radianceCacheSettings.looksUp(bounce)) {
+		glm::vec3 cached;
+		if (m_radianceCache->lookup(hit.point, hit.normal, cached)) return cached;
+	}
 
 	glm::vec3 colorScattered = glm::vec3(0.f);
 	Ray scatteredRay;
 	glm::vec3 attenuation;
-	if (hit.material->scatter(ray, hit, attenuation, scatteredRay)) {
-		colorScattered = attenuation * rayColor(world, scatteredRay, depth - 1);
+	if (hit.material->scatter(ray, hit, sampler, attenuation, scatteredRay)) {
+		RayDifferential scatteredDifferential;
+		if (!differential.valid || !hit.material->scatterDifferential(ray, hit, scatteredRay, differential, scatteredDifferential)) {
+			scatteredDifferential.valid = false;
+		}
+		colorScattered = attenuation * rayColor(world, scatteredRay, scatteredDifferential, depth - 1, sampler);
 	}
 	
 	glm::vec3 colorEmitted = hit.material->emitted(hit.uv, hit.point);
 
-	return colorEmitted + colorScattered;
+	glm::vec3 color = colorEmitted + colorScattered;
+	if (cacheable && m_radianceCacheSettings.adds(bounce, m_maxBounces)) m_radianceCache->add(hit.point, hit.normal, color);
+	return color;
 }
 
 glm::vec3 Renderer::envColor(const Ray& ray) {
@@ -1,17 +1,159 @@
 #pragma once
 
+#include <chrono>
+#include <functional>
+#include <string>
+
 #include "common.h"
+#include "accumulation_buffer.h"
+#include "aov.h"
 #include "hittable_list.h"
 #include "camera.h"
 #include "image.h"
+#include "instant_radiosity.h"
+#include "mapped_framebuffer.h"
 #include "material.h"
+#include "mlt.h"
+#include "parallel.h"
+#include "radiance_cache.h"
+#include "sampler.h"
+#include "texture_cache.h"
+#include "tiles.h"
 
 class Renderer {
+public:
+	enum class Integrator {
+		PathTracing,
+		Bidirectional,	// see BDPTIntegrator; needs the scene's lights
+		Metropolis,	// see MetropolisIntegrator; wraps the path tracer, samples per pixel become mutations per pixel
+		InstantRadiosity,	// see InstantRadiosityIntegrator; needs the scene's lights, samples per pixel only antialias
+	};
+	// How the samples of a pixel are distributed (see sampler.h); Metropolis always uses its own sampler
+	enum class SamplerType {
+		Independent,
+		Stratified,
+		Sobol,
+		BlueNoise,	// blue-noise error distribution across pixels, for previews at a few samples per pixel
+	};
+	// Render for a wall-clock time instead of a fixed number of samples per pixel. A pilot pass estimates each tile's cost and
+	// variance, then progressive passes give more samples to the tiles where they reduce the error most per unit of time.
+	// Path tracing and instant radiosity only.
+	struct TimeBudget {
+		double seconds = 0.;	// from the call to render(); 0 renders samplesPerPixel samples instead
+		int pilotSamples = 4;	// samples per pixel of the pilot pass, which runs to completion even past the deadline
+	};
+	// Render in passes that accumulate into an AccumulationBuffer, saved to checkpointFile as the render goes, so that a
+	// killed render can resume and renders made with different seeds can be merged. Path tracing and instant radiosity only.
+	struct Progressive {
+		bool enabled = false;
+		int passSamples = 4;	// samples per pixel added by each pass, up to samplesPerPixel in all
+		std::string checkpointFile;	// empty for no checkpoints
+		double checkpointSeconds = 60.;	// least time between checkpoints; the finished buffer is always saved
+		bool resume = true;	// continue from checkpointFile if it holds a buffer of the image's size
+	};
+	// Render into a MappedFramebuffer in framebufferFile rather than in memory, and stream the result to outputFile tile by
+	// tile, for images larger than memory: memory use then follows the tiles being rendered rather than the image size, which
+	// is the camera's. The output passed to render() is only written if it has that size. Path tracing and instant
+	// radiosity only, at samplesPerPixel samples per pixel (not with a time budget or progressive passes).
+	struct OutOfCore {
+		bool enabled = false;
+		std::string framebufferFile;	// removed once the render is done
+		std::string outputFile;	// OpenEXR half floats, tiled like the render, for a .exr extension, or else an 8-bit PNG
+	};
+private:
 	int m_samplesPerPixel = 100;
 	int m_maxBounces = 10;
+	int m_threadCount = defaultThreadCount();
+	uint32_t m_seed = 0;
+	int m_tileSize = 16;
+	TileOrder m_tileOrder = TileOrder::Scanline;
+	PixelImportance m_tileImportance;
+	PixelOrder m_pixelOrder = PixelOrder::RowMajor;
+	std::vector<glm::ivec2> m_tilePixels;	// pixel offsets within a tile in m_pixelOrder, set by render()
+	AccumulationLayout m_tileLayout;	// blocks of accumulation buffers that match the tiles, set by render()
+	PixelRect m_cropWindow;	// empty for the whole image
+	Integrator m_integrator = Integrator::PathTracing;
+	SamplerType m_samplerType = SamplerType::Sobol;
+	MetropolisIntegrator::Settings m_metropolisSettings;
+	InstantRadiosityIntegrator::Settings m_instantRadiositySettings;
+	RadianceCache::Settings m_radianceCacheSettings;
+	TimeBudget m_timeBudget;
+	Progressive m_progressive;
+	OutOfCore m_outOfCore;
+	AovImages m_aovs;
+	std::unique_ptr<RadianceCache> m_radianceCache;	// only set during render() when enabled
+	std::unique_ptr<AovBuffer> m_aovBuffer;	// only set during render() when AOVs are wanted
+	std::unique_ptr<TiledAovBuffer> m_tiledAovBuffer;	// instead of m_aovBuffer for out-of-core renders
+	std::shared_ptr<TextureCache> m_textureCache;	// only for its statistics
 
 	glm::vec3 envColor(const Ray& ray);	// TODO: refactor into a property of the scene
-	glm::vec3 rayColor(const Hittable& world, const Ray& ray, int depth);
+	// differential: of the camera ray the path started with, while the path has only been through specular bounces
+	// firstHit: set to the surface ray hits, if any, when not null
+	glm::vec3 rayColor(const Hittable& world, const Ray& ray, const RayDifferential& differential, int depth, Sampler& sampler, AovSample* firstHit = nullptr);
+	float differentialScale() const;	// for ray differentials, given the samples per pixel
+	std::unique_ptr<Sampler> makeSampler() const;
+	void finishRender();	// resolves the AOVs, releases per-render state, and logs the texture cache's and the cache model's counters
+
+	// radiance of one sample through pixel (x, y), with the sampler already started on that sample
+	typedef std::function<glm::vec3(int x, int y, Sampler& sampler)> PixelRadiance;
+	void renderTimeBudget(Image& output, const std::vector<PixelRect>& tiles, std::chrono::steady_clock::time_point deadline, const PixelRadiance& radiance);
+	void renderProgressive(Image& output, const std::vector<PixelRect>& tiles, const PixelRadiance& radiance);
+	// renders samplesPerPixel samples of every pixel of tiles into buffer, calling tileDone(tile) once each tile is done
+	template<typename Buffer, typename TileDone>
+	void renderTiles(Buffer& buffer, const std::vector<PixelRect>& tiles, const PixelRadiance& radiance, const TileDone& tileDone);
+	void renderOutOfCore(Image& output, const glm::ivec2& size, const PixelRect& area, const std::vector<PixelRect>& tiles, const PixelRadiance& radiance);
+	bool writeOutOfCore(MappedFramebuffer& framebuffer, const PixelRect& area) const;
+	void renderMetropolis(const Hittable& world, const Camera& camera, Image& output);
 public:
-	void render(const Hittable& world, const Camera& camera, Image& output);
-};
\ No newline at end of file
+	int samplesPerPixel() const { return m_samplesPerPixel; }
+	int maxBounces() const { return m_maxBounces; }
+	int threadCount() const { return m_threadCount; }
+	// Seeds every sampler type but Independent; renders of one image with different seeds have independent samples
+	uint32_t seed() const { return m_seed; }
+	Integrator integrator() const { return m_integrator; }
+	SamplerType samplerType() const { return m_samplerType; }
+	void setSamplesPerPixel(int samplesPerPixel) { m_samplesPerPixel = samplesPerPixel; }
+	void setMaxBounces(int maxBounces) { m_maxBounces = maxBounces; }
+	void setThreadCount(int threadCount) { m_threadCount = threadCount; }
+	void setSeed(uint32_t seed) { m_seed = seed; }
+	// The image is rendered in square tiles, handed out to threads in tileOrder, so the region that matters most is done first
+	int tileSize() const { return m_tileSize; }
+	TileOrder tileOrder() const { return m_tileOrder; }
+	void setTileSize(int tileSize) { m_tileSize = tileSize; }
+	// importance is only used by TileOrder::Importance
+	void setTileOrder(TileOrder order, const PixelImportance& importance = PixelImportance()) {
+		m_tileOrder = order;
+		m_tileImportance = importance;
+	}
+	// Order of the pixels within each tile; the curves keep consecutive pixels close, so they share more cached BVH nodes
+	// and texels. Samplers are seeded per pixel, so only SamplerType::Independent renders depend on the order.
+	PixelOrder pixelOrder() const { return m_pixelOrder; }
+	void setPixelOrder(PixelOrder order) { m_pixelOrder = order; }
+	// Only pixels in the crop window are rendered; the rest of the output is left as it is. Empty for the whole image.
+	const PixelRect& cropWindow() const { return m_cropWindow; }
+	void setCropWindow(const PixelRect& cropWindow) { m_cropWindow = cropWindow; }
+	void setIntegrator(Integrator integrator) { m_integrator = integrator; }
+	void setSamplerType(SamplerType samplerType) { m_samplerType = samplerType; }
+	const MetropolisIntegrator::Settings& metropolisSettings() const { return m_metropolisSettings; }
+	void setMetropolisSettings(const MetropolisIntegrator::Settings& settings) { m_metropolisSettings = settings; }
+	const InstantRadiosityIntegrator::Settings& instantRadiositySettings() const { return m_instantRadiositySettings; }
+	void setInstantRadiositySettings(const InstantRadiosityIntegrator::Settings& settings) { m_instantRadiositySettings = settings; }
+	// Path tracing and Metropolis only: record the radiance leaving diffuse hits, and end paths at later bounces with the cached value
+	const RadianceCache::Settings& radianceCacheSettings() const { return m_radianceCacheSettings; }
+	void setRadianceCacheSettings(const RadianceCache::Settings& settings) { m_radianceCacheSettings = settings; }
+	const TimeBudget& timeBudget() const { return m_timeBudget; }
+	void setTimeBudget(const TimeBudget& timeBudget) { m_timeBudget = timeBudget; }
+	const Progressive& progressive() const { return m_progressive; }
+	void setProgressive(const Progressive& progressive) { m_progressive = progressive; }
+	const OutOfCore& outOfCore() const { return m_outOfCore; }
+	void setOutOfCore(const OutOfCore& outOfCore) { m_outOfCore = outOfCore; }
+	// Images to fill with auxiliary outputs in the same pass as the image (see AovImages), which must outlive render(). Path
+	// tracing and instant radiosity only.
+	const AovImages& aovs() const { return m_aovs; }
+	void setAovs(const AovImages& aovs) { m_aovs = aovs; }
+	// The cache of the scene's TiledImageTextures, if any; its hit rate and the bytes it read are logged after each render
+	void setTextureCache(std::shared_ptr<TextureCache> cache) { m_textureCache = cache; }
+
+	// lights: emissive objects that light subpaths may start from (also in world); only used by Integrator::Bidirectional and Integrator::InstantRadiosity
+	void render(const Hittable& world, const Camera& camera, Image& output, const HittableList& lights = HittableList());
+};
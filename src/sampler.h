@@ -0,0 +1,275 @@
+#pragma once
+
+#include <cstdint>
+
+#include "common.h"
+#include "blue_noise.h"
+
+// Source of the random numbers a path consumes, in [0, 1).
+// Camera, materials and integrators draw everything through a Sampler so that a path can be
+// reproduced (or perturbed) by replaying the numbers it was built from.
+//
+// Draws that serve a fixed purpose have their own calls (pixel position, and per bounce the BSDF lobe, direction
+// and light choice), so that samplers that stratify over samples of a pixel can give each purpose the same
+// dimension in every sample. Sequential samplers simply return their next numbers from these.
+class Sampler {
+public:
+	virtual ~Sampler() = default;
+
+	// Called by Renderer before each sample of a pixel
+	virtual void startPixelSample(const glm::ivec2& pixel, int sampleIndex) {}
+	// Called by integrators at the start of each bounce of a camera path, counting from 0 at the camera;
+	// until then the per-bounce draws are sequential
+	virtual void startBounce(int bounce) {}
+
+	virtual float get1D() = 0;
+	virtual glm::vec2 get2D() {
+		float x = get1D();
+		return glm::vec2(x, get1D());
+	}
+
+	// Position within the pixel
+	virtual glm::vec2 getPixel2D() { return get2D(); }
+	// Choice between BSDF lobes, e.g. reflection or refraction
+	virtual float getLobe1D() { return get1D(); }
+	// Direction within a lobe
+	virtual glm::vec2 getDirection2D() { return get2D(); }
+	// Choice of light
+	virtual float getLight1D() { return get1D(); }
+};
+
+// Fresh uniform random numbers from the calling thread's generator
+class IndependentSampler : public Sampler {
+public:
+	float get1D() override {
+		return random();
+	}
+};
+
+// Base for samplers whose numbers are a deterministic function of pixel, sample index and dimension.
+// Every draw, 1D or 2D, takes one dimension: dimension 0 is the pixel position, bounce b owns the
+// bounceDimensions dimensions after it, and other draws take dimensions of their own, far past those of any bounce,
+// sequentially from a first one for the current bounce. Each dimension is decorrelated from the others (and from
+// other pixels) with its own seed.
+class PixelSampler : public Sampler {
+	glm::ivec2 m_pixel = glm::ivec2(0);
+	int m_sampleIndex = 0;
+	int m_dimension = genericDimensions;
+	int m_bounceBase = -1;	// first dimension of the current bounce; -1 before startBounce()
+	uint32_t m_seed = 0;
+
+	uint32_t dimensionSeed(int dimension) const {
+		return hash(hash(hash(m_seed ^ static_cast<uint32_t>(m_pixel.x)) ^ static_cast<uint32_t>(m_pixel.y)) ^ static_cast<uint32_t>(dimension));
+	}
+protected:
+	static const int pixelDimensions = 1;
+	static const int bounceDimensions = 3;	// lobe, direction, light
+	// other draws: those before startBounce() from genericDimensions, those of bounce b from genericDimensions + (b + 1)
+	// genericDimensionsPerBounce
+	static const int genericDimensions = 1 << 20;
+	static const int genericDimensionsPerBounce = 1 << 10;
+
+	const glm::ivec2& pixel() const { return m_pixel; }
+	int sampleIndex() const { return m_sampleIndex; }
+	uint32_t seed() const { return m_seed; }
+
+	// sample sampleIndex of the sequence identified by seed
+	virtual float sample1D(int sampleIndex, uint32_t seed) const = 0;
+	virtual glm::vec2 sample2D(int sampleIndex, uint32_t seed) const = 0;
+
+	// the current sample's value in a dimension; overridden to treat some dimensions differently
+	virtual float draw1D(int dimension) const { return sample1D(m_sampleIndex, dimensionSeed(dimension)); }
+	virtual glm::vec2 draw2D(int dimension) const { return sample2D(m_sampleIndex, dimensionSeed(dimension)); }
+
+	// lowbias32 by Chris Wellons
+	static uint32_t hash(uint32_t x) {
+		x ^= x >> 16;
+		x *= 0x7feb352du;
+		x ^= x >> 15;
+		x *= 0x846ca68bu;
+		x ^= x >> 16;
+		return x;
+	}
+	// [0, 1) from the high bits of x
+	static float toUnitFloat(uint32_t x) {
+		return glm::min(static_cast<float>(x >> 8) * (1.f / 16777216.f), 0.99999994f);
+	}
+public:
+	explicit PixelSampler(uint32_t seed) : m_seed(seed) {}
+
+	void startPixelSample(const glm::ivec2& pixel, int sampleIndex) override {
+		m_pixel = pixel;
+		m_sampleIndex = sampleIndex;
+		m_dimension = genericDimensions;
+		m_bounceBase = -1;
+	}
+	void startBounce(int bounce) override {
+		m_bounceBase = pixelDimensions + bounce * bounceDimensions;
+		m_dimension = genericDimensions + (bounce + 1) * genericDimensionsPerBounce;
+	}
+
+	float get1D() override { return draw1D(m_dimension++); }
+	glm::vec2 get2D() override { return draw2D(m_dimension++); }
+
+	glm::vec2 getPixel2D() override { return draw2D(0); }
+	float getLobe1D() override { return m_bounceBase < 0 ? get1D() : draw1D(m_bounceBase); }
+	glm::vec2 getDirection2D() override { return m_bounceBase < 0 ? get2D() : draw2D(m_bounceBase + 1); }
+	float getLight1D() override { return m_bounceBase < 0 ? get1D() : draw1D(m_bounceBase + 2); }
+};
+
+// Jittered stratification: the samples of a pixel fall in distinct strata of each dimension, visited in an order
+// shuffled per dimension. 2D dimensions use a grid of the two closest factors of samplesPerPixel.
+// Sample indices past samplesPerPixel start another, differently shuffled, round of strata.
+class StratifiedSampler : public PixelSampler {
+	int m_samplesPerPixel = 1;
+	int m_strataX = 1;
+
+	// Element i of a random permutation of [0, length) chosen by seed (Kensler, "Correlated Multi-Jittered Sampling")
+	static uint32_t permutationElement(uint32_t i, uint32_t length, uint32_t seed) {
+		uint32_t w = length - 1;
+		w |= w >> 1;
+		w |= w >> 2;
+		w |= w >> 4;
+		w |= w >> 8;
+		w |= w >> 16;
+		do {
+			i ^= seed;
+			i *= 0xe170893du;
+			i ^= seed >> 16;
+			i ^= (i & w) >> 4;
+			i ^= seed >> 8;
+			i *= 0x0929eb3fu;
+			i ^= seed >> 23;
+			i ^= (i & w) >> 1;
+			i *= 1u | seed >> 27;
+			i *= 0x6935fa69u;
+			i ^= (i & w) >> 11;
+			i *= 0x74dcb303u;
+			i ^= (i & w) >> 2;
+			i *= 0x9e501cc3u;
+			i ^= (i & w) >> 2;
+			i *= 0xc860a3dfu;
+			i &= w;
+			i ^= i >> 5;
+		} while (i >= length);
+		return (i + seed) % length;
+	}
+
+	// stratum of sampleIndex, and a seed for its jitter
+	uint32_t stratum(int sampleIndex, uint32_t& seed) const {
+		uint32_t round = static_cast<uint32_t>(sampleIndex / m_samplesPerPixel);
+		if (round > 0) seed = hash(seed ^ round);
+		uint32_t index = static_cast<uint32_t>(sampleIndex % m_samplesPerPixel);
+		uint32_t result = permutationElement(index, static_cast<uint32_t>(m_samplesPerPixel), seed);
+		seed = hash(seed ^ (index * 0x9e3779b9u));
+		return result;
+	}
+protected:
+	float sample1D(int sampleIndex, uint32_t seed) const override {
+		uint32_t s = stratum(sampleIndex, seed);
+		return (static_cast<float>(s) + toUnitFloat(seed)) / static_cast<float>(m_samplesPerPixel);
+	}
+	glm::vec2 sample2D(int sampleIndex, uint32_t seed) const override {
+		uint32_t s = stratum(sampleIndex, seed);
+		int strataY = m_samplesPerPixel / m_strataX;
+		glm::vec2 jitter(toUnitFloat(seed), toUnitFloat(hash(seed)));
+		return glm::vec2(
+			(static_cast<float>(s % m_strataX) + jitter.x) / static_cast<float>(m_strataX),
+			(static_cast<float>(s / m_strataX) + jitter.y) / static_cast<float>(strataY)
+		);
+	}
+public:
+	StratifiedSampler(int samplesPerPixel, uint32_t seed = 0) : PixelSampler(seed), m_samplesPerPixel(glm::max(samplesPerPixel, 1)) {
+		// largest factor not above the square root
+		for (int x = 1; x * x <= m_samplesPerPixel; ++x) {
+			if (m_samplesPerPixel % x == 0) m_strataX = x;
+		}
+	}
+};
+
+// Owen-scrambled Sobol points, using the shuffled and scrambled 2D sequences of Burley,
+// "Practical Hash-based Owen Scrambling" (2020): each dimension gets the first two Sobol dimensions with its own
+// random shuffle of the sample index and its own nested uniform scramble. Best with power-of-two sample counts.
+class SobolSampler : public PixelSampler {
+	static uint32_t reverseBits(uint32_t x) {
+		x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+		x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+		x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+		x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+		return (x >> 16) | (x << 16);
+	}
+
+	// Owen scrambling of the bits of x, most significant first
+	static uint32_t nestedUniformScramble(uint32_t x, uint32_t seed) {
+		x = reverseBits(x);
+		// Laine-Karras style permutation, with Burley's constants
+		x += seed;
+		x ^= x * 0x6c50b47cu;
+		x ^= x * 0xb82f1e52u;
+		x ^= x * 0xc7afe638u;
+		x ^= x * 0x8d22f6e6u;
+		return reverseBits(x);
+	}
+
+	// second Sobol dimension; the first is reverseBits(index)
+	static uint32_t sobol1(uint32_t index) {
+		uint32_t result = 0;
+		uint32_t direction = 0x80000000u;
+		for (; index != 0; index >>= 1) {
+			if (index & 1u) result ^= direction;
+			direction ^= direction >> 1;
+		}
+		return result;
+	}
+protected:
+	float sample1D(int sampleIndex, uint32_t seed) const override {
+		uint32_t index = nestedUniformScramble(static_cast<uint32_t>(sampleIndex), seed);
+		return toUnitFloat(nestedUniformScramble(reverseBits(index), hash(seed ^ 0x1u)));
+	}
+	glm::vec2 sample2D(int sampleIndex, uint32_t seed) const override {
+		uint32_t index = nestedUniformScramble(static_cast<uint32_t>(sampleIndex), seed);
+		return glm::vec2(
+			toUnitFloat(nestedUniformScramble(reverseBits(index), hash(seed ^ 0x1u))),
+			toUnitFloat(nestedUniformScramble(sobol1(index), hash(seed ^ 0x2u)))
+		);
+	}
+public:
+	explicit SobolSampler(uint32_t seed = 0) : PixelSampler(seed) {}
+};
+
+// Blue-noise error distribution at low sample counts (Georgiev and Fajardo 2016; Heitz and Belcour 2019).
+// In the first blueNoiseDimensions dimensions, the samples of a pixel follow a rank-1 lattice (Kronecker sequence),
+// toroidally shifted by an offset read from the blue-noise tile at the pixel. Neighboring pixels get dissimilar
+// offsets, so their errors are negatively correlated and look like fine grain rather than clumps.
+// Each dimension and component reads the tile at its own translation, which keeps dimensions decorrelated.
+// Later dimensions use Sobol points.
+class BlueNoiseSampler : public SobolSampler {
+	int m_blueNoiseDimensions = 1;
+
+	// generators in 0.32 fixed point: golden ratio for 1D, R2 (plastic constant) for 2D
+	static const uint32_t golden = 0x9e3779b9u;
+	static const uint32_t r2x = 0xc13fa9a9u;
+	static const uint32_t r2y = 0x91e10da5u;
+
+	// tile value for a dimension's component at the current pixel, in 0.32 fixed point
+	uint32_t offset(int dimension, int component) const {
+		uint32_t k = hash(seed()) + static_cast<uint32_t>(2 * dimension + component + 1);
+		glm::ivec2 shift(static_cast<int>((k * golden) >> 26), static_cast<int>((k * r2y) >> 26));
+		float value = BlueNoiseTile::instance().value(pixel().x + shift.x, pixel().y + shift.y);
+		return static_cast<uint32_t>(static_cast<double>(value) * 4294967296.0);
+	}
+protected:
+	float draw1D(int dimension) const override {
+		if (dimension >= m_blueNoiseDimensions) return SobolSampler::draw1D(dimension);
+		return toUnitFloat(static_cast<uint32_t>(sampleIndex()) * golden + offset(dimension, 0));
+	}
+	glm::vec2 draw2D(int dimension) const override {
+		if (dimension >= m_blueNoiseDimensions) return SobolSampler::draw2D(dimension);
+		uint32_t i = static_cast<uint32_t>(sampleIndex());
+		return glm::vec2(toUnitFloat(i * r2x + offset(dimension, 0)), toUnitFloat(i * r2y + offset(dimension, 1)));
+	}
+public:
+	// By default the pixel position and the first two bounces are blue-noise dimensions
+	explicit BlueNoiseSampler(uint32_t seed = 0, int blueNoiseDimensions = pixelDimensions + 2 * bounceDimensions) :
+		SobolSampler(seed), m_blueNoiseDimensions(blueNoiseDimensions) {}
+};
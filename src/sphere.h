@@ -1,7 +1,9 @@
 #pragma once
 
+#include "cache_stats.h"
 #include "hittable.h"
 #include "material.h"
+#include "warp.h"
 
 class Sphere : public Hittable {
 	glm::vec3 m_center = glm::vec3(0.f);
@@ -15,6 +17,7 @@ public:
 	float radius() const { return m_radius; }
 
 	bool hit(const Ray& ray, Interval tRange, HitRecord& hit) const override {
+		CACHE_STATS_TOUCH(this, sizeof(*this));
 		glm::vec3 oc = m_center - ray.origin();
 		float a = glm::dot(ray.direction(), ray.direction());
 		float h = glm::dot(ray.direction(), oc);
@@ -44,7 +47,9 @@ public:
 		glm::vec3 outwardNormal = (hit.point - m_center) / m_radius;
 		hit.setFrontFaceAndNormal(ray, outwardNormal);
 		hit.uv = getSphereUV(outwardNormal);
+		getSphereDerivatives(outwardNormal, m_radius, hit.dpdu, hit.dpdv);
 		hit.material = m_material;
+		hit.objectId = m_id;
 
 		return true;
 	}
@@ -53,6 +58,22 @@ public:
 		return AABox(m_center - m_radius, m_center + m_radius);
 	}
 
+	float area() const override {
+		return 4.f * pi * m_radius * m_radius;
+	}
+
+	bool sampleSurface(const glm::vec2& u, HitRecord& sample) const override {
+		glm::vec3 outwardNormal = uniformSphere(u);
+
+		sample.point = m_center + m_radius * outwardNormal;
+		sample.normal = outwardNormal;
+		sample.frontFace = true;
+		sample.uv = getSphereUV(outwardNormal);
+		sample.t = 0.f;
+		sample.material = m_material;
+		return true;
+	}
+
 	// p is a point on the unit sphere centered at 0
 	static glm::vec2 getSphereUV(const glm::vec3& p) {
 		// uv coordinates should be clockwise around the sphere;
@@ -68,4 +89,16 @@ public:
 
 		return glm::vec2(u, v);
 	}
+
+	// Derivatives of the point on a sphere of the given radius with respect to the uv of getSphereUV(), for the point at unit
+	// offset p from the center. dpdv vanishes at the poles, where u is undefined.
+	static void getSphereDerivatives(const glm::vec3& p, float radius, glm::vec3& dpdu, glm::vec3& dpdv) {
+		dpdu = 2.f * pi * radius * glm::vec3(p.z, 0.f, -p.x);
+		float sinTheta = glm::sqrt(p.x * p.x + p.z * p.z);
+		if (sinTheta < 1e-6f) {
+			dpdv = glm::vec3(0.f);
+			return;
+		}
+		dpdv = pi * radius * glm::vec3(-p.y * p.x / sinTheta, sinTheta, -p.y * p.z / sinTheta);
+	}
 };
\ No newline at end of file
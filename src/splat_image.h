@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+#include "common.h"
+#include "image.h"
+
+// Accumulates contributions that may land on any pixel (e.g. light tracing), from many threads at once
+class SplatImage {
+	int m_width = 0;
+	int m_height = 0;
+	std::vector<std::atomic<float>> m_data;
+
+	int idx(int x, int y) const {
+		return (y * m_width + x) * 3;
+	}
+
+	static void atomicAdd(std::atomic<float>& target, float value) {
+		float current = target.load(std::memory_order_relaxed);
+		while (!target.compare_exchange_weak(current, current + value, std::memory_order_relaxed)) {}
+	}
+public:
+	SplatImage(int width, int height) : m_width(width), m_height(height), m_data(width * height * 3) {
+		for (std::atomic<float>& value : m_data) {
+			value.store(0.f, std::memory_order_relaxed);
+		}
+	}
+
+	int width() const { return m_width; }
+	int height() const { return m_height; }
+
+	void add(int x, int y, const glm::vec3& val) {
+		int i = idx(x, y);
+		for (int comp = 0; comp < 3; ++comp) {
+			if (val[comp] != 0.f) atomicAdd(m_data[i + comp], val[comp]);
+		}
+	}
+	glm::vec3 get(int x, int y) const {
+		int i = idx(x, y);
+		return glm::vec3(
+			m_data[i + 0].load(std::memory_order_relaxed),
+			m_data[i + 1].load(std::memory_order_relaxed),
+			m_data[i + 2].load(std::memory_order_relaxed)
+		);
+	}
+
+	// adds scale * (splatted values) to image, which must have the same size
+	void addTo(Image& image, float scale) const {
+		for (int y = 0; y < m_height; ++y) {
+			for (int x = 0; x < m_width; ++x) {
+				image.set(x, y, image.get(x, y) + scale * get(x, y));
+			}
+		}
+	}
+};
@@ -1,3 +1,98 @@
 #include "texture.h"
 
-const glm::vec3 ImageTexture::emptyColor = glm::vec3(1.f, 0.f, 1.f);
\ No newline at end of file
+#include <algorithm>
+
+const glm::vec3 ImageTexture::emptyColor = glm::vec3(1.f, 0.f, 1.f);
+
+void Texture::compile(TextureProgram& program) const {
+	program.call(*this);
+}
+
+TextureProgram::TextureProgram(const Texture& texture) {
+	TextureProgram unfolded;
+	unfolded.m_ops.clear();
+	texture.compile(unfolded);
+	std::vector<std::pair<float, bool>> parities;
+	fold(unfolded.m_ops, 0, parities);
+}
+
+void TextureProgram::fold(const std::vector<Op>& ops, int op, std::vector<std::pair<float, bool>>& parities) {
+	if (ops[op].kind != Op::Kind::Checker) {
+		m_ops.push_back(ops[op]);
+		return;
+	}
+	// in a branch of a checker of the same scale, the cell's parity is already known
+	const float inverseScale = ops[op].inverseScale;
+	for (const std::pair<float, bool>& parity : parities) {
+		if (parity.first == inverseScale) {
+			fold(ops, parity.second ? op + 1 : ops[op].odd, parities);
+			return;
+		}
+	}
+
+	const int checker = static_cast<int>(m_ops.size());
+	m_ops.push_back(ops[op]);
+	parities.emplace_back(inverseScale, true);
+	fold(ops, op + 1, parities);
+	const int odd = static_cast<int>(m_ops.size());
+	parities.back().second = false;
+	fold(ops, ops[op].odd, parities);
+	parities.pop_back();
+	m_ops[checker].odd = odd;
+
+	// both branches the same color
+	const Op& even = m_ops[checker + 1];
+	if (odd == checker + 2 && static_cast<int>(m_ops.size()) == odd + 1 && even.kind == Op::Kind::Constant && m_ops[odd].kind == Op::Kind::Constant && even.color == m_ops[odd].color) {
+		m_ops[checker] = even;
+		m_ops.resize(checker + 1);
+	}
+}
+
+void TextureProgram::constant(const glm::vec3& color) {
+	Op op;
+	op.kind = Op::Kind::Constant;
+	op.color = color;
+	m_ops.push_back(op);
+}
+
+void TextureProgram::mipLookup(const MipMap& mipmap, TextureFilter filter) {
+	Op op;
+	op.kind = Op::Kind::MipLookup;
+	op.mipmap = &mipmap;
+	op.filter = filter;
+	m_ops.push_back(op);
+}
+
+void TextureProgram::call(const Texture& texture) {
+	Op op;
+	op.kind = Op::Kind::Call;
+	op.texture = &texture;
+	m_ops.push_back(op);
+}
+
+int TextureProgram::checker(float inverseScale) {
+	Op op;
+	op.kind = Op::Kind::Checker;
+	op.inverseScale = inverseScale;
+	m_ops.push_back(op);
+	return static_cast<int>(m_ops.size()) - 1;
+}
+
+std::vector<std::shared_ptr<ImageTexture>> loadImageTextures(const std::vector<std::string>& files, TextureFilter filter, int threadCount) {
+	std::vector<std::string> unique = files;
+	std::sort(unique.begin(), unique.end());
+	unique.erase(std::unique(unique.begin(), unique.end()), unique.end());
+
+	// threads left over when there are fewer files than threads work within each file
+	std::vector<std::shared_ptr<ImageTexture>> loaded(unique.size());
+	const int threadsPerFile = glm::max(1, threadCount / glm::max(1, static_cast<int>(unique.size())));
+	parallelFor(static_cast<int>(unique.size()), threadCount, [&](int i) {
+		loaded[i] = std::make_shared<ImageTexture>(unique[i], filter, threadsPerFile);
+	});
+
+	std::vector<std::shared_ptr<ImageTexture>> textures;
+	for (const std::string& file : files) {
+		textures.push_back(loaded[std::lower_bound(unique.begin(), unique.end(), file) - unique.begin()]);
+	}
+	return textures;
+}
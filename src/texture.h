@@ -1,59 +1,238 @@
 #pragma once
 
+#include <memory>
+#include <vector>
+
+#include "cache_stats.h"
 #include "common.h"
 #include "image.h"
+#include "mipmap.h"
+#include "tiled_texture.h"
+
+class TextureProgram;
 
 class Texture {
 public:
 	virtual ~Texture() = default;
 
-	virtual const glm::vec3& value(const glm::vec2& uv, const glm::vec3& p) const = 0;
+	virtual glm::vec3 value(const glm::vec2& uv, const glm::vec3& p) const = 0;
+	// Average over the footprint of a pixel, with uv changing by dUVdx and dUVdy from one pixel to the next
+	virtual glm::vec3 filteredValue(const glm::vec2& uv, const glm::vec3& p, const glm::vec2& dUVdx, const glm::vec2& dUVdy) const {
+		return value(uv, p);
+	}
+	// Appends the texture's ops to program; by default a call back into the texture
+	virtual void compile(TextureProgram& program) const;
+};
+
+// A tree of textures flattened into an array of ops, evaluated by a loop rather than by a virtual call per node, for
+// materials to look their textures up with. Solid colors become constant ops, and checkers whose branches fold to the same
+// color, or that sit in a branch of a checker with the same scale, are folded away; most programs are then a single op.
+//
+// The program points into the textures it was compiled from, which must outlive it.
+class TextureProgram {
+public:
+	struct Op {
+		enum class Kind : uint8_t {
+			Constant,	// returns color
+			Checker,	// goes on with the next op in even cells, or with the op at odd in odd cells
+			MipLookup,	// returns a lookup in mipmap
+			Call,	// returns the value of texture
+		};
+		Kind kind = Kind::Constant;
+		TextureFilter filter = TextureFilter::EWA;
+		int odd = 0;
+		float inverseScale = 1.f;
+		glm::vec3 color = glm::vec3(0.f);
+		const MipMap* mipmap = nullptr;
+		const Texture* texture = nullptr;
+	};
+private:
+	std::vector<Op> m_ops;
+
+	// Copies the subprogram starting at ops[op] into m_ops, folded; parities holds the checkers it is in a branch of
+	void fold(const std::vector<Op>& ops, int op, std::vector<std::pair<float, bool>>& parities);
+
+	template<bool filtered>
+	glm::vec3 run(const glm::vec2& uv, const glm::vec3& p, const glm::vec2& dUVdx, const glm::vec2& dUVdy) const;
+public:
+	// whether p is in an even cell of a 3D checkerboard of cells 1 / inverseScale wide
+	static bool isEven(const glm::vec3& p, float inverseScale) {
+		int x = static_cast<int>(glm::floor(p.x * inverseScale));
+		int y = static_cast<int>(glm::floor(p.y * inverseScale));
+		int z = static_cast<int>(glm::floor(p.z * inverseScale));
+		return (x + y + z) % 2 == 0;
+	}
+
+	// black
+	TextureProgram() { m_ops.emplace_back(); }
+	explicit TextureProgram(const glm::vec3& color) {
+		constant(color);
+	}
+	explicit TextureProgram(const Texture& texture);
+
+	const std::vector<Op>& ops() const { return m_ops; }
+
+	glm::vec3 value(const glm::vec2& uv, const glm::vec3& p) const {
+		return run<false>(uv, p, glm::vec2(0.f), glm::vec2(0.f));
+	}
+	glm::vec3 filteredValue(const glm::vec2& uv, const glm::vec3& p, const glm::vec2& dUVdx, const glm::vec2& dUVdy) const {
+		return run<true>(uv, p, dUVdx, dUVdy);
+	}
+
+	// for Texture::compile()
+	void constant(const glm::vec3& color);
+	void mipLookup(const MipMap& mipmap, TextureFilter filter);
+	void call(const Texture& texture);
+	// a checker, whose even branch is compiled next; returns the op to pass to oddBranch() before compiling the odd branch
+	int checker(float inverseScale);
+	void oddBranch(int checker) { m_ops[checker].odd = static_cast<int>(m_ops.size()); }
 };
 
+template<bool filtered>
+glm::vec3 TextureProgram::run(const glm::vec2& uv, const glm::vec3& p, const glm::vec2& dUVdx, const glm::vec2& dUVdy) const {
+	const Op* op = m_ops.data();
+	for (;;) {
+		switch (op->kind) {
+		case Op::Kind::Constant:
+			return op->color;
+		case Op::Kind::Checker:
+			op = isEven(p, op->inverseScale) ? op + 1 : m_ops.data() + op->odd;
+			break;
+		case Op::Kind::MipLookup: {
+			// uv to st, with t running down the image, against v
+			const glm::vec2 st(glm::clamp(uv.x, 0.f, 1.f), 1.f - glm::clamp(uv.y, 0.f, 1.f));
+			return op->mipmap->lookup(op->filter, st, glm::vec2(dUVdx.x, -dUVdx.y), glm::vec2(dUVdy.x, -dUVdy.y));
+		}
+		default:
+			return filtered ? op->texture->filteredValue(uv, p, dUVdx, dUVdy) : op->texture->value(uv, p);
+		}
+	}
+}
+
 class SolidColorTexture : public Texture {
 public:
 	glm::vec3 m_color = glm::vec3(0.f);
 
 	SolidColorTexture(const glm::vec3& color) : m_color(color) {}
 
-	const glm::vec3& value(const glm::vec2& uv, const glm::vec3& p) const override {
+	glm::vec3 value(const glm::vec2& uv, const glm::vec3& p) const override {
 		return m_color;
 	};
+
+	void compile(TextureProgram& program) const override {
+		program.constant(m_color);
+	}
 };
 
 class CheckerTexture : public Texture {
 	float m_inverseScale = 1.f;
 	std::shared_ptr<Texture> m_evenTexture = nullptr;
 	std::shared_ptr<Texture> m_oddTexture = nullptr;
+
+	bool isEven(const glm::vec3& p) const {
+		return TextureProgram::isEven(p, m_inverseScale);
+	}
 public:
 	CheckerTexture(float scale, std::shared_ptr<Texture> even, std::shared_ptr<Texture> odd) : m_inverseScale(1.f / scale), m_evenTexture(even), m_oddTexture(odd) {}
 
-	const glm::vec3& value(const glm::vec2& uv, const glm::vec3& p) const override {
-		int x = static_cast<int>(glm::floor(p.x * m_inverseScale));
-		int y = static_cast<int>(glm::floor(p.y * m_inverseScale));
-		int z = static_cast<int>(glm::floor(p.z * m_inverseScale));
-		bool isEven = (x + y + z) % 2 == 0;
-
-		return isEven ? m_evenTexture->value(uv, p) : m_oddTexture->value(uv, p);
+	glm::vec3 value(const glm::vec2& uv, const glm::vec3& p) const override {
+		return isEven(p) ? m_evenTexture->value(uv, p) : m_oddTexture->value(uv, p);
 	};
+
+	glm::vec3 filteredValue(const glm::vec2& uv, const glm::vec3& p, const glm::vec2& dUVdx, const glm::vec2& dUVdy) const override {
+		return isEven(p) ? m_evenTexture->filteredValue(uv, p, dUVdx, dUVdy) : m_oddTexture->filteredValue(uv, p, dUVdx, dUVdy);
+	}
+
+	void compile(TextureProgram& program) const override {
+		const int checker = program.checker(m_inverseScale);
+		m_evenTexture->compile(program);
+		program.oddBranch(checker);
+		m_oddTexture->compile(program);
+	}
 };
 
+// Lookup in an image file. 8- and 16-bit files are kept compact (see CompactImage) and mipmapped, so that lookups can filter
+// over the footprint of a pixel; floating point files are kept as floats, and looked up at the nearest texel.
 class ImageTexture : public Texture {
-	Image image;
+	MipMap m_mipmap;
+	TextureFilter m_filter = TextureFilter::EWA;
+	Image m_hdrImage;	// only for files with no compact form
 public:
 	static const glm::vec3 emptyColor;
 
-	ImageTexture(std::string file) : image(file) {}
+	// uv to st, with t running down the image, against v
+	static glm::vec2 imageCoordinates(const glm::vec2& uv) {
+		return glm::vec2(glm::clamp(uv.x, 0.f, 1.f), 1.f - glm::clamp(uv.y, 0.f, 1.f));
+	}
+
+	// loads and mipmaps the file with up to threadCount threads
+	ImageTexture(std::string file, TextureFilter filter = TextureFilter::EWA, int threadCount = defaultThreadCount()) :
+		m_mipmap(CompactImage(file, 2.2f, threadCount), threadCount), m_filter(filter), m_hdrImage(0, 0) {
+		if (m_mipmap.level(0).width() <= 0) m_hdrImage = Image(file, 2.2f, Image::Layout::Interleaved, threadCount);
+	}
 
-	const glm::vec3& value(const glm::vec2& uv, const glm::vec3& p) const override {
-		if (image.width() <= 0 || image.height() <= 0) return emptyColor;
+	TextureFilter filter() const { return m_filter; }
+	const MipMap& mipmap() const { return m_mipmap; }
+
+	glm::vec3 value(const glm::vec2& uv, const glm::vec3& p) const override {
+		return filteredValue(uv, p, glm::vec2(0.f), glm::vec2(0.f));
+	};
+
+	glm::vec3 filteredValue(const glm::vec2& uv, const glm::vec3& p, const glm::vec2& dUVdx, const glm::vec2& dUVdy) const override {
+		const glm::vec2 st = imageCoordinates(uv);
+		if (m_mipmap.level(0).width() > 0 && m_mipmap.level(0).height() > 0) {
+			// t runs down the image, against v
+			return m_mipmap.lookup(m_filter, st, glm::vec2(dUVdx.x, -dUVdx.y), glm::vec2(dUVdy.x, -dUVdy.y));
+		}
+		if (m_hdrImage.width() > 0 && m_hdrImage.height() > 0) {
+			int x = glm::min(static_cast<int>(glm::floor(st.x * m_hdrImage.width())), m_hdrImage.width() - 1);
+			int y = glm::min(static_cast<int>(glm::floor(st.y * m_hdrImage.height())), m_hdrImage.height() - 1);
+			if (m_hdrImage.layout() == Image::Layout::Planar) {
+				// a float in each plane
+				for (int c = 0; c < Image::channels; ++c) {
+					CACHE_STATS_TOUCH(m_hdrImage.channel(c, y) + x, sizeof(float));
+				}
+			}
+			else {
+				CACHE_STATS_TOUCH(m_hdrImage.channel(0, y) + x * Image::channels, sizeof(glm::vec3));
+			}
+			return m_hdrImage.get(x, y);
+		}
+		return emptyColor;
+	};
 
-		// nearest filtering
-		float u = glm::clamp(uv.x, 0.f, 1.f);
-		float v = 1.f - glm::clamp(uv.y, 0.f, 1.f);
+	void compile(TextureProgram& program) const override {
+		if (m_mipmap.level(0).width() > 0 && m_mipmap.level(0).height() > 0) {
+			program.mipLookup(m_mipmap, m_filter);
+		}
+		else {
+			Texture::compile(program);
+		}
+	}
+};
+
+// Loads the image files of a scene, several at once, as decoding a file runs on one thread; a file named more than once is
+// loaded once, and its texture shared. The textures are in the order of files.
+std::vector<std::shared_ptr<ImageTexture>> loadImageTextures(const std::vector<std::string>& files, TextureFilter filter = TextureFilter::EWA,
+	int threadCount = defaultThreadCount());
+
+// Lookup in a tiled texture file (see convertToTiledTexture()), read into cache a page at a time as lookups need it, for
+// scenes whose textures don't all fit in memory. Textures that share a cache share its memory budget.
+class TiledImageTexture : public Texture {
+	TiledMipMap m_mipmap;
+	TextureFilter m_filter = TextureFilter::EWA;
+public:
+	TiledImageTexture(std::shared_ptr<TextureCache> cache, const std::string& file, TextureFilter filter = TextureFilter::EWA) : m_mipmap(cache, file), m_filter(filter) {}
+
+	TextureFilter filter() const { return m_filter; }
+	const TiledMipMap& mipmap() const { return m_mipmap; }
+
+	glm::vec3 value(const glm::vec2& uv, const glm::vec3& p) const override {
+		return filteredValue(uv, p, glm::vec2(0.f), glm::vec2(0.f));
+	};
 
-		int x = static_cast<int>(glm::floor(u * image.width()));
-		int y = static_cast<int>(glm::floor(v * image.height()));
-		return image.get(x, y);
+	glm::vec3 filteredValue(const glm::vec2& uv, const glm::vec3& p, const glm::vec2& dUVdx, const glm::vec2& dUVdy) const override {
+		if (m_mipmap.levels() == 0) return ImageTexture::emptyColor;
+		return m_mipmap.lookup(m_filter, ImageTexture::imageCoordinates(uv), glm::vec2(dUVdx.x, -dUVdx.y), glm::vec2(dUVdy.x, -dUVdy.y));
 	};
 };
@@ -0,0 +1,71 @@
+#include "texture_cache.h"
+
+#include <algorithm>
+
+TextureCache::TextureCache(size_t budget, int shardCount) : m_budget(budget), m_hits(0), m_misses(0), m_bytesRead(0), m_evictions(0) {
+	shardCount = std::max(1, shardCount);
+	m_shardBudget = budget / shardCount;
+	for (int i = 0; i < shardCount; ++i) {
+		m_shards.emplace_back(new Shard());
+	}
+}
+
+size_t TextureCache::bytes() const {
+	size_t total = 0;
+	for (const std::unique_ptr<Shard>& shard : m_shards) {
+		std::lock_guard<std::mutex> lock(shard->mutex);
+		total += shard->bytes;
+	}
+	return total;
+}
+
+std::shared_ptr<const TextureCache::Page> TextureCache::find(uint64_t key) {
+	Shard& s = shard(key);
+	std::lock_guard<std::mutex> lock(s.mutex);
+	auto entry = s.index.find(key);
+	if (entry == s.index.end()) {
+		++m_misses;
+		return nullptr;
+	}
+	++m_hits;
+	s.pages.splice(s.pages.begin(), s.pages, entry->second);
+	return entry->second->second;
+}
+
+std::shared_ptr<const TextureCache::Page> TextureCache::insert(uint64_t key, Page page) {
+	m_bytesRead += page.size();
+	std::shared_ptr<const Page> stored = std::make_shared<const Page>(std::move(page));
+
+	Shard& s = shard(key);
+	std::lock_guard<std::mutex> lock(s.mutex);
+	auto entry = s.index.find(key);
+	if (entry != s.index.end()) return entry->second->second;
+
+	s.pages.emplace_front(key, stored);
+	s.index[key] = s.pages.begin();
+	s.bytes += stored->size();
+	// the new page stays even if it is larger than the shard's budget on its own
+	while (s.bytes > m_shardBudget && s.pages.size() > 1) {
+		s.bytes -= s.pages.back().second->size();
+		s.index.erase(s.pages.back().first);
+		s.pages.pop_back();
+		++m_evictions;
+	}
+	return stored;
+}
+
+TextureCacheStats TextureCache::stats() const {
+	TextureCacheStats stats;
+	stats.hits = m_hits;
+	stats.misses = m_misses;
+	stats.bytesRead = m_bytesRead;
+	stats.evictions = m_evictions;
+	return stats;
+}
+
+void TextureCache::resetStats() {
+	m_hits = 0;
+	m_misses = 0;
+	m_bytesRead = 0;
+	m_evictions = 0;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct TextureCacheStats {
+	uint64_t hits = 0;
+	uint64_t misses = 0;
+	uint64_t bytesRead = 0;	// by the misses, from disk
+	uint64_t evictions = 0;
+
+	float hitRate() const { return hits + misses > 0 ? static_cast<float>(hits) / static_cast<float>(hits + misses) : 0.f; }
+};
+
+// Pages of texels read from tiled texture files (see TiledMipMap), shared by every texture that reads through it and kept
+// within a memory budget by evicting the least recently used pages. The pages are spread over shards by key, each with its
+// own lock and its own share of the budget, so that threads looking up different pages rarely wait for each other.
+//
+// Pages are handed out as shared pointers, so that one can be evicted while a thread is still reading it; the budget holds
+// for the pages in the cache, and the ones threads still hold come on top of it.
+class TextureCache {
+public:
+	typedef std::vector<uint8_t> Page;
+	static const int defaultShardCount = 16;
+private:
+	struct Shard {
+		std::mutex mutex;
+		std::list<std::pair<uint64_t, std::shared_ptr<const Page>>> pages;	// most recently used first
+		std::unordered_map<uint64_t, std::list<std::pair<uint64_t, std::shared_ptr<const Page>>>::iterator> index;
+		size_t bytes = 0;
+	};
+	size_t m_budget = 0;
+	size_t m_shardBudget = 0;
+	std::vector<std::unique_ptr<Shard>> m_shards;
+	std::atomic<uint64_t> m_hits;
+	std::atomic<uint64_t> m_misses;
+	std::atomic<uint64_t> m_bytesRead;
+	std::atomic<uint64_t> m_evictions;
+
+	Shard& shard(uint64_t key) const {
+		// mix the key's bits, as neighboring pages differ only in their low bits
+		key ^= key >> 33;
+		key *= 0xff51afd7ed558ccdull;
+		key ^= key >> 33;
+		return *m_shards[key % m_shards.size()];
+	}
+public:
+	// budget in bytes, split evenly between the shards
+	explicit TextureCache(size_t budget, int shardCount = defaultShardCount);
+
+	size_t budget() const { return m_budget; }
+	// bytes of the pages in the cache
+	size_t bytes() const;
+
+	// The page stored under key, or null if it isn't in the cache, counting a hit or a miss
+	std::shared_ptr<const Page> find(uint64_t key);
+	// Adds page, just read from disk, under key, evicting pages to stay within the budget, and returns what is stored under
+	// key: page, or the copy another thread added after both missed it
+	std::shared_ptr<const Page> insert(uint64_t key, Page page);
+
+	TextureCacheStats stats() const;
+	void resetStats();
+};
@@ -0,0 +1,177 @@
+#include "tiled_texture.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iostream>
+
+#include "binary_file.h"
+
+namespace {
+	// File layout, little-endian (see binary_file.h): magic, version, format (0 for Gamma8, 1 for Linear16), gamma, page
+	// size, level count, the width and height of each level, then the pages of each level from the largest, in row-major
+	// order. Every page holds pageSize x pageSize texels in row-major order, in the format of CompactImage; pages at the
+	// right and bottom edges repeat the edge texels.
+	const char magic[4] = { 'R', 'T', 'T', 'X' };
+	const uint32_t version = 1;
+	const int maxLevels = 32;
+
+	// Pages a thread has read lately, by key; a small direct-mapped table
+	struct RecentPages {
+		static const int size = 8;
+		uint64_t keys[size] = {};
+		std::shared_ptr<const TextureCache::Page> pages[size];
+	};
+
+	std::atomic<uint64_t> nextTextureKey(1);
+}
+
+bool writeTiledTexture(const MipMap& mipmap, const std::string& file, int pageSize) {
+	if (mipmap.levels() == 0 || mipmap.levelSize(0).x <= 0 || pageSize <= 0) return false;
+	const CompactImage& full = mipmap.level(0);
+	const size_t texelBytes = full.format() == CompactImage::Format::Gamma8 ? 3 : 6;
+
+	const std::string temporary = file + ".tmp";
+	std::FILE* f = std::fopen(temporary.c_str(), "wb");
+	if (f == nullptr) return false;
+	const uint32_t format = full.format() == CompactImage::Format::Gamma8 ? 0 : 1;
+	const float gamma = full.gamma();
+	const int32_t page = pageSize;
+	const uint32_t levels = static_cast<uint32_t>(mipmap.levels());
+	std::vector<int32_t> sizes;
+	for (int i = 0; i < mipmap.levels(); ++i) {
+		sizes.push_back(mipmap.levelSize(i).x);
+		sizes.push_back(mipmap.levelSize(i).y);
+	}
+	bool ok = writeValues(f, magic, 4)
+		&& writeValues(f, &version, 1)
+		&& writeValues(f, &format, 1)
+		&& writeValues(f, &gamma, 1)
+		&& writeValues(f, &page, 1)
+		&& writeValues(f, &levels, 1)
+		&& writeValues(f, sizes.data(), sizes.size());
+
+	std::vector<uint8_t> texels(static_cast<size_t>(pageSize) * pageSize * texelBytes);
+	for (int level = 0; ok && level < mipmap.levels(); ++level) {
+		const CompactImage& image = mipmap.level(level);
+		for (int pageY = 0; ok && pageY * pageSize < image.height(); ++pageY) {
+			for (int pageX = 0; ok && pageX * pageSize < image.width(); ++pageX) {
+				uint8_t* out = texels.data();
+				for (int y = 0; y < pageSize; ++y) {
+					const int imageY = glm::min(pageY * pageSize + y, image.height() - 1);
+					for (int x = 0; x < pageSize; ++x, out += texelBytes) {
+						const int imageX = glm::min(pageX * pageSize + x, image.width() - 1);
+						std::memcpy(out, image.address(imageX, imageY), texelBytes);
+					}
+				}
+				ok = writeValues(f, texels.data(), texels.size());
+			}
+		}
+	}
+	ok = std::fclose(f) == 0 && ok;
+	if (!ok) {
+		std::remove(temporary.c_str());
+		return false;
+	}
+	if (replaceFile(temporary, file)) return true;
+	std::remove(temporary.c_str());
+	return false;
+}
+
+bool convertToTiledTexture(const std::string& image, const std::string& file, int pageSize, int threadCount) {
+	CompactImage texels(image);
+	if (texels.width() <= 0 || texels.height() <= 0) {
+		std::clog << "Can't convert to a tiled texture: " << image << '\n';
+		return false;
+	}
+	return writeTiledTexture(MipMap(std::move(texels), threadCount), file, pageSize);
+}
+
+TiledMipMap::TiledMipMap(std::shared_ptr<TextureCache> cache, const std::string& file) : m_cache(cache), m_key(nextTextureKey++) {
+	m_file = std::fopen(file.c_str(), "rb");
+	char fileMagic[4];
+	uint32_t fileVersion = 0, format = 0, levels = 0;
+	float gamma = 1.f;
+	int32_t pageSize = 0;
+	std::vector<int32_t> sizes;
+	bool ok = m_file != nullptr
+		&& readValues(m_file, fileMagic, 4) && std::memcmp(fileMagic, magic, 4) == 0
+		&& readValues(m_file, &fileVersion, 1) && fileVersion == version
+		&& readValues(m_file, &format, 1) && format <= 1
+		&& readValues(m_file, &gamma, 1)
+		&& readValues(m_file, &pageSize, 1) && pageSize > 0
+		&& readValues(m_file, &levels, 1) && levels >= 1 && levels <= maxLevels;
+	if (ok) {
+		sizes.resize(2 * levels);
+		ok = readValues(m_file, sizes.data(), sizes.size());
+		for (int32_t size : sizes) ok = ok && size > 0;
+	}
+	if (!ok) {
+		std::clog << "Not a valid tiled texture: " << file << '\n';
+		return;
+	}
+
+	m_format = format == 0 ? CompactImage::Format::Gamma8 : CompactImage::Format::Linear16;
+	m_pageSize = pageSize;
+	uint64_t offset = sizeof(magic) + 5 * sizeof(uint32_t) + sizes.size() * sizeof(int32_t);
+	for (uint32_t i = 0; i < levels; ++i) {
+		Level level;
+		level.size = glm::ivec2(sizes[2 * i], sizes[2 * i + 1]);
+		level.pagesPerRow = (level.size.x + m_pageSize - 1) / m_pageSize;
+		level.offset = offset;
+		offset += static_cast<uint64_t>(level.pagesPerRow) * ((level.size.y + m_pageSize - 1) / m_pageSize) * pageBytes();
+		m_levels.push_back(level);
+	}
+	for (int i = 0; i < 256; ++i) {
+		m_decode[i] = glm::pow(static_cast<float>(i) / 255.f, gamma);
+	}
+}
+
+TiledMipMap::~TiledMipMap() {
+	if (m_file != nullptr) std::fclose(m_file);
+}
+
+const TextureCache::Page& TiledMipMap::page(int level, int pageX, int pageY) const {
+	const Level& l = m_levels[level];
+	const uint64_t index = static_cast<uint64_t>(pageY) * l.pagesPerRow + pageX;
+	// 24 bits of texture, 5 of level (see maxLevels) and 35 of page
+	const uint64_t key = (m_key << 40) | (static_cast<uint64_t>(level) << 35) | index;
+
+	thread_local RecentPages recent;
+	const int slot = static_cast<int>((key ^ (key >> 40)) % RecentPages::size);
+	if (recent.keys[slot] == key) return *recent.pages[slot];
+
+	std::shared_ptr<const TextureCache::Page> page = m_cache->find(key);
+	if (page == nullptr) {
+		TextureCache::Page texels(pageBytes());
+		bool ok;
+		{
+			std::lock_guard<std::mutex> lock(m_fileMutex);
+			ok = seek(m_file, l.offset + index * pageBytes()) && readValues(m_file, texels.data(), texels.size());
+		}
+		if (!ok) {
+			// cache black texels, so that a truncated file isn't read again for every lookup
+			std::clog << "Can't read page " << index << " of level " << level << " of a tiled texture\n";
+			std::fill(texels.begin(), texels.end(), static_cast<uint8_t>(0));
+		}
+		page = m_cache->insert(key, std::move(texels));
+	}
+	recent.keys[slot] = key;
+	recent.pages[slot] = page;
+	return *page;
+}
+
+glm::vec3 TiledMipMap::texel(int level, int x, int y) const {
+	const Level& l = m_levels[level];
+	x = glm::clamp(x, 0, l.size.x - 1);
+	y = glm::clamp(y, 0, l.size.y - 1);
+	const TextureCache::Page& texels = page(level, x / m_pageSize, y / m_pageSize);
+	const uint8_t* t = &texels[(static_cast<size_t>(y % m_pageSize) * m_pageSize + x % m_pageSize) * texelBytes()];
+	CACHE_STATS_TOUCH(t, texelBytes());
+	if (m_format == CompactImage::Format::Gamma8) {
+		return glm::vec3(m_decode[t[0]], m_decode[t[1]], m_decode[t[2]]);
+	}
+	uint16_t values[3];
+	std::memcpy(values, t, sizeof(values));
+	return glm::vec3(values[0], values[1], values[2]) * (1.f / 65535.f);
+}
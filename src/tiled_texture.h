@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "cache_stats.h"
+#include "common.h"
+#include "compact_image.h"
+#include "mip_filter.h"
+#include "mipmap.h"
+#include "texture_cache.h"
+
+// Writes mipmap as a tiled texture file, for TiledMipMap: every level cut into pages of pageSize x pageSize texels, each
+// stored contiguously so that one read brings in a page. Returns false if the file can't be written.
+bool writeTiledTexture(const MipMap& mipmap, const std::string& file, int pageSize = 64);
+// Converts an 8- or 16-bit image file (see CompactImage) to a tiled texture file
+bool convertToTiledTexture(const std::string& image, const std::string& file, int pageSize = 64, int threadCount = defaultThreadCount());
+
+// Mipmapped texture that stays on disk, in a file written by writeTiledTexture(), and reads the pages that lookups touch
+// into a TextureCache, so that textures far larger than memory can be rendered as long as the pages in use fit in the
+// cache's budget. Lookups are those of MipFilter.
+//
+// Each thread remembers the last few pages it read, as going through the cache's locks for every texel would cost more than
+// the filtering; those lookups don't count as cache hits, nor refresh the pages' place in the cache's LRU order.
+class TiledMipMap : public MipFilter<TiledMipMap> {
+	friend class MipFilter<TiledMipMap>;
+
+	struct Level {
+		glm::ivec2 size = glm::ivec2(0);
+		int pagesPerRow = 0;
+		uint64_t offset = 0;	// of the level's first page in the file
+	};
+	std::shared_ptr<TextureCache> m_cache;
+	std::FILE* m_file = nullptr;
+	mutable std::mutex m_fileMutex;
+	uint64_t m_key = 0;	// unique to this texture, in the high bits of the keys of its pages
+	CompactImage::Format m_format = CompactImage::Format::Gamma8;
+	int m_pageSize = 0;
+	std::vector<Level> m_levels;
+	float m_decode[256];	// 8-bit value to linear
+
+	int texelBytes() const { return m_format == CompactImage::Format::Gamma8 ? 3 : 6; }
+	size_t pageBytes() const { return static_cast<size_t>(m_pageSize) * m_pageSize * texelBytes(); }
+	// valid until the calling thread's next call, as the thread's table of recent pages keeps it alive until then
+	const TextureCache::Page& page(int level, int pageX, int pageY) const;
+	glm::vec3 texel(int level, int x, int y) const;
+public:
+	// a file written by writeTiledTexture(); levels() is 0 if it can't be read
+	TiledMipMap(std::shared_ptr<TextureCache> cache, const std::string& file);
+	~TiledMipMap();
+	TiledMipMap(const TiledMipMap&) = delete;
+	TiledMipMap& operator=(const TiledMipMap&) = delete;
+
+	int levels() const { return static_cast<int>(m_levels.size()); }
+	glm::ivec2 levelSize(int i) const { return m_levels[i].size; }
+	int pageSize() const { return m_pageSize; }
+	CompactImage::Format format() const { return m_format; }
+	const TextureCache& cache() const { return *m_cache; }
+};
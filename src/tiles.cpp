@@ -0,0 +1,131 @@
+#include "tiles.h"
+
+#include <algorithm>
+
+std::vector<PixelRect> makeTiles(const PixelRect& area, int tileSize) {
+	std::vector<PixelRect> tiles;
+	if (area.empty()) return tiles;
+	tileSize = glm::max(1, tileSize);
+	for (int y = area.min.y; y < area.max.y; y += tileSize) {
+		for (int x = area.min.x; x < area.max.x; x += tileSize) {
+			glm::ivec2 min(x, y);
+			tiles.push_back(PixelRect(min, glm::min(min + tileSize, area.max)));
+		}
+	}
+	return tiles;
+}
+
+uint32_t hilbertIndex(uint32_t x, uint32_t y, uint32_t size) {
+	uint32_t index = 0;
+	for (uint32_t s = size / 2; s > 0; s /= 2) {
+		uint32_t rx = (x & s) > 0 ? 1 : 0;
+		uint32_t ry = (y & s) > 0 ? 1 : 0;
+		index += s * s * ((3 * rx) ^ ry);
+		// rotate the quadrant so that the curve within it starts and ends at the right corners
+		if (ry == 0) {
+			if (rx == 1) {
+				x = size - 1 - x;
+				y = size - 1 - y;
+			}
+			std::swap(x, y);
+		}
+	}
+	return index;
+}
+
+uint32_t mortonIndex(uint32_t x, uint32_t y) {
+	// spread the low 16 bits of v out to the even bits
+	auto spread = [](uint32_t v) {
+		v &= 0xffff;
+		v = (v | (v << 8)) & 0x00ff00ff;
+		v = (v | (v << 4)) & 0x0f0f0f0f;
+		v = (v | (v << 2)) & 0x33333333;
+		v = (v | (v << 1)) & 0x55555555;
+		return v;
+	};
+	return spread(x) | (spread(y) << 1);
+}
+
+std::vector<glm::ivec2> tilePixelOrder(int tileSize, PixelOrder order) {
+	tileSize = glm::max(1, tileSize);
+	std::vector<glm::ivec2> offsets;
+	offsets.reserve(tileSize * tileSize);
+	if (order == PixelOrder::RowMajor) {
+		for (int y = 0; y < tileSize; ++y) {
+			for (int x = 0; x < tileSize; ++x) {
+				offsets.push_back(glm::ivec2(x, y));
+			}
+		}
+		return offsets;
+	}
+
+	// both curves fill power-of-two squares; walk the smallest one covering the tile and keep the pixels inside it
+	uint32_t size = 1;
+	while (size < static_cast<uint32_t>(tileSize)) size *= 2;
+	std::vector<std::pair<uint32_t, glm::ivec2>> keyed;
+	keyed.reserve(offsets.capacity());
+	for (uint32_t y = 0; y < static_cast<uint32_t>(tileSize); ++y) {
+		for (uint32_t x = 0; x < static_cast<uint32_t>(tileSize); ++x) {
+			uint32_t key = order == PixelOrder::Hilbert ? hilbertIndex(x, y, size) : mortonIndex(x, y);
+			keyed.push_back(std::make_pair(key, glm::ivec2(x, y)));
+		}
+	}
+	std::sort(keyed.begin(), keyed.end(), [](const std::pair<uint32_t, glm::ivec2>& a, const std::pair<uint32_t, glm::ivec2>& b) { return a.first < b.first; });
+	for (const std::pair<uint32_t, glm::ivec2>& k : keyed) {
+		offsets.push_back(k.second);
+	}
+	return offsets;
+}
+
+void orderTiles(std::vector<PixelRect>& tiles, const PixelRect& area, int tileSize, TileOrder order, const PixelImportance& importance) {
+	if (order == TileOrder::Scanline || tiles.empty()) return;
+	tileSize = glm::max(1, tileSize);
+
+	// sort key of each tile, from its position in the grid of tiles
+	const glm::ivec2 gridSize = (area.max - area.min + tileSize - 1) / tileSize;
+	std::vector<std::pair<float, int>> keys(tiles.size());
+	for (size_t i = 0; i < tiles.size(); ++i) {
+		const PixelRect& tile = tiles[i];
+		const glm::ivec2 cell = (tile.min - area.min) / tileSize;
+		float key = 0.f;
+		switch (order) {
+		case TileOrder::Spiral: {
+			// ring around the center first, then the angle within the ring
+			glm::vec2 offset = glm::vec2(cell) - 0.5f * glm::vec2(gridSize - 1);
+			float ring = glm::max(glm::abs(offset.x), glm::abs(offset.y));
+			float angle = glm::atan(offset.y, offset.x) + pi;
+			key = ring * 16.f + angle;	// angle < 2 pi, and rings are at least 0.5 apart
+			break;
+		}
+		case TileOrder::Importance: {
+			float sum = 0.f;
+			if (importance) {
+				for (int y = tile.min.y; y < tile.max.y; ++y) {
+					for (int x = tile.min.x; x < tile.max.x; ++x) {
+						sum += importance(x, y);
+					}
+				}
+			}
+			key = -sum / static_cast<float>(tile.area());
+			break;
+		}
+		case TileOrder::Hilbert: {
+			uint32_t size = 1;
+			while (size < static_cast<uint32_t>(glm::max(gridSize.x, gridSize.y))) size *= 2;
+			key = static_cast<float>(hilbertIndex(static_cast<uint32_t>(cell.x), static_cast<uint32_t>(cell.y), size));
+			break;
+		}
+		default:
+			break;
+		}
+		keys[i] = std::make_pair(key, static_cast<int>(i));
+	}
+
+	// ties keep scanline order
+	std::stable_sort(keys.begin(), keys.end(), [](const std::pair<float, int>& a, const std::pair<float, int>& b) { return a.first < b.first; });
+	std::vector<PixelRect> sorted(tiles.size());
+	for (size_t i = 0; i < keys.size(); ++i) {
+		sorted[i] = tiles[keys[i].second];
+	}
+	tiles.swap(sorted);
+}
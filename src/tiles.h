@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "common.h"
+
+// Rectangle of pixels [min, max), max exclusive
+struct PixelRect {
+	glm::ivec2 min = glm::ivec2(0);
+	glm::ivec2 max = glm::ivec2(0);
+
+	PixelRect() = default;
+	PixelRect(const glm::ivec2& min, const glm::ivec2& max) : min(min), max(max) {}
+
+	bool empty() const { return max.x <= min.x || max.y <= min.y; }
+	int area() const { return empty() ? 0 : (max.x - min.x) * (max.y - min.y); }
+	bool contains(int x, int y) const { return x >= min.x && x < max.x && y >= min.y && y < max.y; }
+	PixelRect intersect(const PixelRect& other) const {
+		return PixelRect(glm::max(min, other.min), glm::min(max, other.max));
+	}
+};
+
+// Order in which the tiles of an image are rendered
+enum class TileOrder {
+	Scanline,	// rows of tiles, top to bottom
+	Spiral,	// outwards from the center, ring by ring
+	Importance,	// highest mean importance first
+	Hilbert,	// along a Hilbert curve, so that consecutive tiles are neighbors and share cached scene data
+};
+
+// Order in which the pixels within a tile are rendered. Neighboring pixels trace similar rays, which visit the same BVH
+// nodes and texels, so orders that stay local keep more of that data in cache.
+enum class PixelOrder {
+	RowMajor,
+	Morton,	// Z-order: bit-interleaved coordinates, recursively by quadrant
+	Hilbert,	// like Morton, but consecutive pixels are always neighbors
+};
+
+// Per-pixel weight for TileOrder::Importance
+typedef std::function<float(int x, int y)> PixelImportance;
+
+// Splits area into tiles of tileSize x tileSize pixels (smaller at the right and bottom edges), in scanline order
+std::vector<PixelRect> makeTiles(const PixelRect& area, int tileSize);
+
+// Sorts tiles made by makeTiles(area, tileSize) into the given order; importance is only used by TileOrder::Importance
+void orderTiles(std::vector<PixelRect>& tiles, const PixelRect& area, int tileSize, TileOrder order, const PixelImportance& importance = PixelImportance());
+
+// Position of cell (x, y) along the Hilbert curve that fills a size x size grid, size a power of two
+uint32_t hilbertIndex(uint32_t x, uint32_t y, uint32_t size);
+
+// Position of cell (x, y) along the Z-order curve: the bits of x and y interleaved, x in the even bits
+uint32_t mortonIndex(uint32_t x, uint32_t y);
+
+// Offsets of the pixels of a tileSize x tileSize tile, in the given order
+std::vector<glm::ivec2> tilePixelOrder(int tileSize, PixelOrder order);
+
+// Calls body(x, y) for each pixel of tile, visiting tile.min + offset for each of the offsets made by tilePixelOrder();
+// offsets that fall outside smaller tiles at the image edge are skipped
+template<typename Body>
+void forEachPixel(const PixelRect& tile, const std::vector<glm::ivec2>& offsets, const Body& body) {
+	for (const glm::ivec2& offset : offsets) {
+		const glm::ivec2 pixel = tile.min + offset;
+		if (pixel.x < tile.max.x && pixel.y < tile.max.y) body(pixel.x, pixel.y);
+	}
+}
@@ -52,6 +52,9 @@ public:
 
 		hit.point = transformPoint(hit.point);
 		hit.normal = transformDirection(hit.normal);
+		hit.dpdu = transformDirection(m_scale * hit.dpdu);
+		hit.dpdv = transformDirection(m_scale * hit.dpdv);
+		if (m_id != 0) hit.objectId = m_id;
 
 		return true;
 	}
@@ -59,4 +62,25 @@ public:
 	AABox boundingBox() const override {
 		return m_bbox;
 	}
+
+	// Like hit(), these assume a uniform scale
+	float area() const override {
+		return m_object->area() * m_scale.x * m_scale.x;
+	}
+
+	bool sampleSurface(const glm::vec2& u, HitRecord& sample) const override {
+		if (!m_object->sampleSurface(u, sample))
+			return false;
+
+		sample.point = transformPoint(sample.point);
+		sample.normal = transformDirection(sample.normal);
+
+		return true;
+	}
+
+	bool forEachQuad(const QuadVisitor& visit) const override {
+		return m_object->forEachQuad([&](const glm::vec3& corner, const glm::vec3& side1, const glm::vec3& side2, const std::shared_ptr<Material>& material) {
+			visit(transformPoint(corner), m_rotation * (m_scale * side1), m_rotation * (m_scale * side2), material);
+		});
+	}
 };
\ No newline at end of file
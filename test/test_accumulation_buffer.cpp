@@ -0,0 +1,157 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+
+#include <cstdio>
+
+#include "test_common.h"
+#include "../src/accumulation_buffer.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTest
+{
+	TEST_CLASS(TestAccumulationBuffer)
+	{
+	public:
+		TEST_METHOD(TestConstructor)
+		{
+			AccumulationBuffer buffer(3, 2);
+			Assert::AreEqual(3, buffer.width());
+			Assert::AreEqual(2, buffer.height());
+			Assert::AreEqual(0, buffer.count(2, 1));
+			Assert::AreEqual(glm::vec3(0.f), buffer.mean(2, 1));
+			Assert::AreEqual(0.f, buffer.variance(2, 1));
+		}
+
+		TEST_METHOD(TestAdd)
+		{
+			AccumulationBuffer buffer(3, 2);
+			buffer.add(1, 1, glm::vec3(1.f));
+			Assert::AreEqual(1, buffer.count(1, 1));
+			Assert::AreEqual(0.f, buffer.variance(1, 1));
+			buffer.add(1, 1, glm::vec3(3.f));
+			buffer.add(1, 1, glm::vec3(2.f));
+			Assert::AreEqual(3, buffer.count(1, 1));
+			Assert::AreEqual(0, buffer.count(0, 1));
+			assertFuzzyEqual(glm::vec3(2.f), buffer.mean(1, 1), 1e-6f);
+			// luminance of a gray sample is its value: samples 1, 3, 2 have variance 1
+			Assert::AreEqual(1.f, buffer.variance(1, 1), 1e-5f);
+		}
+
+		TEST_METHOD(TestResolve)
+		{
+			AccumulationBuffer buffer(2, 2);
+			buffer.add(0, 0, glm::vec3(1.f, 2.f, 3.f));
+			buffer.add(1, 0, glm::vec3(2.f));
+			buffer.add(1, 0, glm::vec3(4.f));
+			Image image(2, 2);
+			image.set(1, 1, glm::vec3(5.f));
+			buffer.resolve(image);
+			Assert::AreEqual(glm::vec3(1.f, 2.f, 3.f), image.get(0, 0));
+			Assert::AreEqual(glm::vec3(3.f), image.get(1, 0));
+			Assert::AreEqual(glm::vec3(0.f), image.get(1, 1));
+		}
+
+		TEST_METHOD(TestWriteRead)
+		{
+			AccumulationBuffer buffer(3, 2);
+			buffer.add(0, 0, glm::vec3(1.f, 2.f, 3.f));
+			buffer.add(2, 1, glm::vec3(4.f));
+			buffer.add(2, 1, glm::vec3(2.f));
+			buffer.addSeed(7);
+			const std::string file = "test_accumulation_buffer.bin";
+			// replacing an older checkpoint
+			Assert::IsTrue(AccumulationBuffer(5, 4).write(file));
+			Assert::IsTrue(buffer.write(file));
+			Assert::IsTrue(std::fopen((file + ".tmp").c_str(), "rb") == nullptr);
+
+			AccumulationBuffer read(file);
+			std::remove(file.c_str());
+			Assert::AreEqual(3, read.width());
+			Assert::AreEqual(2, read.height());
+			Assert::AreEqual(1, static_cast<int>(read.seeds().size()));
+			Assert::AreEqual(7u, read.seeds()[0]);
+			for (int y = 0; y < 2; ++y) {
+				for (int x = 0; x < 3; ++x) {
+					Assert::AreEqual(buffer.count(x, y), read.count(x, y));
+					Assert::AreEqual(buffer.mean(x, y), read.mean(x, y));
+					Assert::AreEqual(buffer.variance(x, y), read.variance(x, y));
+				}
+			}
+
+			AccumulationBuffer missing("no_such_file.bin");
+			Assert::AreEqual(0, missing.width());
+			Assert::AreEqual(0, missing.height());
+		}
+
+		TEST_METHOD(TestMerge)
+		{
+			AccumulationBuffer a(2, 1), b(2, 1);
+			a.addSeed(1);
+			a.add(0, 0, glm::vec3(1.f));
+			b.addSeed(2);
+			b.add(0, 0, glm::vec3(3.f));
+			b.add(1, 0, glm::vec3(5.f));
+
+			AccumulationBuffer sameSeed(2, 1);
+			sameSeed.addSeed(1);
+			Assert::IsFalse(a.merge(sameSeed));
+			Assert::IsFalse(a.merge(AccumulationBuffer(1, 2)));
+			Assert::AreEqual(1, a.count(0, 0));
+
+			Assert::IsTrue(a.merge(b));
+			Assert::AreEqual(2, a.count(0, 0));
+			Assert::AreEqual(1, a.count(1, 0));
+			Assert::AreEqual(glm::vec3(2.f), a.mean(0, 0));
+			Assert::AreEqual(glm::vec3(5.f), a.mean(1, 0));
+			Assert::AreEqual(2.f, a.variance(0, 0), 1e-5f);
+			Assert::AreEqual(2, static_cast<int>(a.seeds().size()));
+		}
+
+		TEST_METHOD(TestLayout)
+		{
+			AlignedVector<glm::vec3> aligned(5);
+			Assert::AreEqual(size_t(0), reinterpret_cast<uintptr_t>(aligned.data()) % cacheLineSize);
+
+			// small blocks on a grid that doesn't start at the image corner: every pixel still has a place of its own
+			AccumulationLayout layout;
+			layout.blockSize = 3;
+			layout.blockOrigin = glm::ivec2(2, -4);
+			layout.variance = false;
+			AccumulationBuffer blocked(7, 5, layout);
+			AccumulationBuffer plain(7, 5);
+			for (int y = 0; y < 5; ++y) {
+				for (int x = 0; x < 7; ++x) {
+					for (int s = 0; s <= (x + y) % 3; ++s) {
+						blocked.add(x, y, glm::vec3(static_cast<float>(x), static_cast<float>(y), static_cast<float>(s)));
+						plain.add(x, y, glm::vec3(static_cast<float>(x), static_cast<float>(y), static_cast<float>(s)));
+					}
+				}
+			}
+			for (int y = 0; y < 5; ++y) {
+				for (int x = 0; x < 7; ++x) {
+					Assert::AreEqual(plain.count(x, y), blocked.count(x, y));
+					Assert::AreEqual(plain.mean(x, y), blocked.mean(x, y));
+				}
+			}
+			// no variance channel, and none after merging into a buffer that had one
+			Assert::AreEqual(0.f, blocked.variance(0, 4));
+			AccumulationBuffer merged(7, 5);
+			merged.addSeed(1);
+			blocked.addSeed(2);
+			Assert::IsTrue(merged.merge(blocked));
+			Assert::IsFalse(merged.layout().variance);
+			Assert::AreEqual(blocked.mean(6, 4), merged.mean(6, 4));
+
+			// checkpoints don't depend on the layout
+			const std::string file = "test_accumulation_layout.bin";
+			Assert::IsTrue(plain.write(file));
+			AccumulationBuffer read(file, layout);
+			std::remove(file.c_str());
+			Assert::AreEqual(7, read.width());
+			Assert::AreEqual(3, read.layout().blockSize);
+			Assert::AreEqual(plain.mean(5, 3), read.mean(5, 3));
+			Assert::AreEqual(plain.count(5, 3), read.count(5, 3));
+		}
+	};
+}
@@ -0,0 +1,143 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+
+#include "test_common.h"
+#include "../src/aov.h"
+#include "../src/dielectric.h"
+#include "../src/hittable_list.h"
+#include "../src/lambertian.h"
+#include "../src/sphere.h"
+#include "../src/transform.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTest
+{
+	TEST_CLASS(TestAov)
+	{
+	public:
+		TEST_METHOD(TestSample)
+		{
+			auto sphere = std::make_shared<Sphere>(glm::vec3(0.f, 0.f, -5.f), 1.f, std::make_shared<Lambertian>(glm::vec3(0.2f, 0.4f, 0.6f)));
+			sphere->setId(7);
+			// a direction of length 2, so the depth is twice t
+			const Ray ray(glm::vec3(0.f), glm::vec3(0.f, 0.f, -2.f));
+			Hittable::HitRecord hit;
+			Assert::IsTrue(sphere->hit(ray, Interval(0.f, infinity), hit));
+			const AovSample sample(ray, hit);
+			assertFuzzyEqual(glm::vec3(0.2f, 0.4f, 0.6f), sample.albedo, 1e-6f);
+			assertFuzzyEqual(glm::vec3(0.f, 0.f, 1.f), sample.normal, 1e-6f);
+			Assert::AreEqual(4.f, sample.depth, 1e-5f);
+			Assert::AreEqual(7u, sample.objectId);
+
+			Assert::AreEqual(glm::vec3(1.f), Dielectric(1.5f).albedo(hit));
+		}
+
+		TEST_METHOD(TestGroupId)
+		{
+			auto sphere = std::make_shared<Sphere>(glm::vec3(0.f, 0.f, -5.f), 1.f, std::make_shared<Lambertian>(glm::vec3(1.f)));
+			sphere->setId(3);
+			auto list = std::make_shared<HittableList>();
+			list->add(sphere);
+			Transform transform(list, glm::vec3(1.f, 0.f, 0.f));
+			const Ray ray(glm::vec3(1.f, 0.f, 0.f), glm::vec3(0.f, 0.f, -1.f));
+			Hittable::HitRecord hit;
+			// without IDs of their own, groups keep the primitive's
+			Assert::IsTrue(transform.hit(ray, Interval(0.f, infinity), hit));
+			Assert::AreEqual(3u, hit.objectId);
+			list->setId(4);
+			Assert::IsTrue(transform.hit(ray, Interval(0.f, infinity), hit));
+			Assert::AreEqual(4u, hit.objectId);
+			transform.setId(5);
+			Assert::IsTrue(transform.hit(ray, Interval(0.f, infinity), hit));
+			Assert::AreEqual(5u, hit.objectId);
+		}
+
+		TEST_METHOD(TestBuffer)
+		{
+			Image albedo(4, 3), normal(4, 3), depth(4, 3), objectId(4, 3), sampleCount(4, 3), emission(4, 3), variance(4, 3), wrongSize(3, 4);
+			sampleCount.set(0, 0, glm::vec3(9.f));
+			AovImages images;
+			images.albedo = &albedo;
+			images.normal = &normal;
+			images.depth = &depth;
+			images.objectId = &objectId;
+			images.sampleCount = &sampleCount;
+			images.emission = &emission;
+			images.variance = &variance;
+			AccumulationLayout layout;
+			layout.blockSize = 2;
+			AovBuffer buffer(4, 3, images, layout);
+
+			AovSample a, b;
+			a.albedo = glm::vec3(1.f, 0.f, 0.f);
+			a.normal = glm::vec3(0.f, 1.f, 0.f);
+			a.depth = 2.f;
+			a.objectId = 1;
+			b.albedo = glm::vec3(0.f, 0.f, 1.f);
+			b.normal = glm::vec3(1.f, 0.f, 0.f);
+			b.depth = 4.f;
+			b.objectId = 2;
+			b.emission = glm::vec3(2.f, 0.f, 0.f);
+			buffer.add(3, 2, a, glm::vec3(1.f));
+			// 3 once b's emission is taken out
+			buffer.add(3, 2, b, glm::vec3(5.f, 3.f, 3.f));
+			buffer.add(1, 0, b, glm::vec3(5.f, 3.f, 3.f));
+			buffer.resolve();
+
+			Assert::AreEqual(glm::vec3(0.5f, 0.f, 0.5f), albedo.get(3, 2));
+			Assert::AreEqual(glm::vec3(0.5f, 0.5f, 0.f), normal.get(3, 2));
+			Assert::AreEqual(glm::vec3(3.f), depth.get(3, 2));
+			// the first sample's
+			Assert::AreEqual(glm::vec3(1.f), objectId.get(3, 2));
+			Assert::AreEqual(glm::vec3(2.f), sampleCount.get(3, 2));
+			Assert::AreEqual(glm::vec3(1.f, 0.f, 0.f), emission.get(3, 2));
+			// samples 1 and 3 have variance 2, and their mean half that
+			assertFuzzyEqual(glm::vec3(1.f), variance.get(3, 2), 1e-5f);
+			Assert::AreEqual(glm::vec3(0.f), variance.get(1, 0));
+			Assert::AreEqual(glm::vec3(2.f), objectId.get(1, 0));
+			Assert::AreEqual(glm::vec3(1.f), sampleCount.get(1, 0));
+			// pixels without samples are left as they are
+			Assert::AreEqual(glm::vec3(9.f), sampleCount.get(0, 0));
+
+			images.albedo = &wrongSize;
+			AovBuffer partial(4, 3, images, layout);
+			Assert::IsTrue(partial.images().albedo == nullptr);
+			Assert::IsTrue(partial.images().normal == &normal);
+		}
+
+		TEST_METHOD(TestTiledBuffer)
+		{
+			Image albedo(5, 3), sampleCount(5, 3), wrongSize(3, 5);
+			AovImages images;
+			images.albedo = &albedo;
+			images.sampleCount = &sampleCount;
+			images.depth = &wrongSize;
+			// 2 x 2 tiles from (1, 0)
+			TiledAovBuffer buffer(5, 3, images, PixelRect(glm::ivec2(1, 0), glm::ivec2(5, 3)), 2);
+			Assert::IsTrue(buffer.images().depth == nullptr);
+
+			AovSample a, b;
+			a.albedo = glm::vec3(1.f, 0.f, 0.f);
+			b.albedo = glm::vec3(0.f, 1.f, 0.f);
+			buffer.add(2, 1, a, glm::vec3(0.f));
+			buffer.add(2, 1, b, glm::vec3(0.f));
+			buffer.add(4, 2, b, glm::vec3(0.f));
+
+			// only tiles that are done are written
+			buffer.tileDone(PixelRect(glm::ivec2(1, 0), glm::ivec2(3, 2)));
+			Assert::AreEqual(glm::vec3(0.5f, 0.5f, 0.f), albedo.get(2, 1));
+			Assert::AreEqual(glm::vec3(2.f), sampleCount.get(2, 1));
+			Assert::AreEqual(glm::vec3(0.f), albedo.get(4, 2));
+			buffer.tileDone(PixelRect(glm::ivec2(3, 2), glm::ivec2(5, 3)));
+			Assert::AreEqual(glm::vec3(0.f, 1.f, 0.f), albedo.get(4, 2));
+			Assert::AreEqual(glm::vec3(1.f), sampleCount.get(4, 2));
+			Assert::AreEqual(glm::vec3(0.f), sampleCount.get(1, 0));
+
+			// a tile's sums start over once it is done
+			buffer.add(2, 1, a, glm::vec3(0.f));
+			buffer.tileDone(PixelRect(glm::ivec2(1, 0), glm::ivec2(3, 2)));
+			Assert::AreEqual(glm::vec3(1.f, 0.f, 0.f), albedo.get(2, 1));
+		}
+	};
+}
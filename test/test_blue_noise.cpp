@@ -0,0 +1,51 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+
+#include <vector>
+
+#include "test_common.h"
+#include "../src/blue_noise.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTest
+{
+	TEST_CLASS(TestBlueNoise)
+	{
+	public:
+		TEST_METHOD(TestPermutation)
+		{
+			const BlueNoiseTile& tile = BlueNoiseTile::instance();
+			const int texels = BlueNoiseTile::size * BlueNoiseTile::size;
+			std::vector<int> counts(texels, 0);
+			for (int y = 0; y < BlueNoiseTile::size; ++y) {
+				for (int x = 0; x < BlueNoiseTile::size; ++x) {
+					int rank = tile.rank(x, y);
+					Assert::IsTrue(rank >= 0 && rank < texels);
+					++counts[rank];
+				}
+			}
+			for (int count : counts) {
+				Assert::AreEqual(1, count);
+			}
+
+			// wraps around
+			Assert::AreEqual(tile.rank(3, 5), tile.rank(3 + BlueNoiseTile::size, 5 - BlueNoiseTile::size));
+		}
+
+		TEST_METHOD(TestNeighbors)
+		{
+			// neighbors of white noise differ by 1/3 on average; blue noise has fewer similar neighbors
+			const BlueNoiseTile& tile = BlueNoiseTile::instance();
+			float difference = 0.f;
+			for (int y = 0; y < BlueNoiseTile::size; ++y) {
+				for (int x = 0; x < BlueNoiseTile::size; ++x) {
+					difference += glm::abs(tile.value(x, y) - tile.value(x + 1, y));
+					difference += glm::abs(tile.value(x, y) - tile.value(x, y + 1));
+				}
+			}
+			difference /= 2.f * BlueNoiseTile::size * BlueNoiseTile::size;
+			Assert::IsTrue(difference > 0.38f);
+		}
+	};
+}
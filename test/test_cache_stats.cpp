@@ -0,0 +1,41 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+
+#include "../src/cache_stats.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTest
+{
+	TEST_CLASS(TestCacheStats)
+	{
+		static const void* address(uintptr_t a) {
+			return reinterpret_cast<const void*>(a);
+		}
+	public:
+		TEST_METHOD(TestMisses)
+		{
+			cacheStats::reset();
+			// the first access to a line misses, later ones in the same line hit; spanning two lines is two accesses
+			cacheStats::touch(address(0x10000), 4);
+			cacheStats::touch(address(0x10020), 4);
+			cacheStats::touch(address(0x1003c), 8);
+			CacheStats stats = cacheStats::collect();
+			Assert::AreEqual(uint64_t(4), stats.accesses);
+			Assert::AreEqual(uint64_t(2), stats.l1Misses);
+			Assert::AreEqual(uint64_t(2), stats.l2Misses);
+
+			// nine lines 4 KiB apart share one 8-way L1 set, so the first is evicted from L1, but not from the larger L2
+			cacheStats::reset();
+			for (uintptr_t i = 0; i < 9; ++i) {
+				cacheStats::touch(address(0x100000 + i * 4096), 1);
+			}
+			cacheStats::touch(address(0x100000), 1);
+			stats = cacheStats::collect();
+			Assert::AreEqual(uint64_t(10), stats.accesses);
+			Assert::AreEqual(uint64_t(10), stats.l1Misses);
+			Assert::AreEqual(uint64_t(9), stats.l2Misses);
+			Assert::AreEqual(1.f, stats.l1MissRate());
+		}
+	};
+}
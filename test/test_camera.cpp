@@ -200,5 +200,39 @@ namespace UnitTest
 				}
 			}
 		}
+	
+		TEST_METHOD(TestProject)
+		{
+			const Camera camera(
+				Camera::Frame(glm::vec3(1.f, 3.f, 2.f), glm::vec3(0.f, 1.f, -1.f)),
+				Camera::Projection(glm::ivec2(16, 8), 60.f, 2.f)
+			);
+			const float tolerance = 1e-3f;
+
+			// points along camera rays project back onto their pixel, at any distance
+			const glm::ivec2 pixels[4] = { glm::ivec2(0, 0), glm::ivec2(15, 0), glm::ivec2(3, 7), glm::ivec2(9, 4) };
+			for (const glm::ivec2& pixel : pixels) {
+				const Ray ray = camera.getRay(pixel.x, pixel.y);
+				for (float t : { 0.5f, 1.f, 20.f }) {
+					glm::vec2 projected;
+					Assert::IsTrue(camera.project(ray.at(t), projected));
+					assertFuzzyEqual(glm::vec2(pixel), projected, tolerance);
+				}
+			}
+
+			// behind the camera
+			{
+				const Ray ray = camera.getRay(9, 4);
+				glm::vec2 projected;
+				Assert::IsFalse(camera.project(ray.at(-1.f), projected));
+			}
+
+			// outside the image
+			{
+				const Ray ray = camera.getRay(0, 0);
+				glm::vec2 projected;
+				Assert::IsFalse(camera.project(ray.origin() + 2.f * (ray.direction() - camera.getRay(1, 1).direction()) + ray.direction(), projected));
+			}
+		}
 	};
 }
\ No newline at end of file
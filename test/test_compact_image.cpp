@@ -0,0 +1,66 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+
+#include <vector>
+
+#include "test_common.h"
+#include "../src/compact_image.h"
+#include "../src/image.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTest
+{
+	TEST_CLASS(TestCompactImage)
+	{
+	public:
+		TEST_METHOD(TestGamma8)
+		{
+			// a size that leaves partial tiles at the right and bottom
+			const int width = 13, height = 10;
+			std::vector<uint8_t> rgb(width * height * 3);
+			for (size_t i = 0; i < rgb.size(); ++i) {
+				rgb[i] = static_cast<uint8_t>(i * 7);
+			}
+			CompactImage image(width, height, rgb.data());
+			Assert::AreEqual(width, image.width());
+			Assert::IsTrue(CompactImage::Format::Gamma8 == image.format());
+			// 2x2 tiles of 8x8 texels, 3 bytes each
+			Assert::AreEqual(size_t(4 * 64 * 3), image.bytes());
+			for (int y = 0; y < height; ++y) {
+				for (int x = 0; x < width; ++x) {
+					const uint8_t* texel = &rgb[(y * width + x) * 3];
+					glm::vec3 expected(glm::pow(texel[0] / 255.f, 2.2f), glm::pow(texel[1] / 255.f, 2.2f), glm::pow(texel[2] / 255.f, 2.2f));
+					assertFuzzyEqual(expected, image.get(x, y), 1e-6f);
+				}
+			}
+		}
+
+		TEST_METHOD(TestLinear16)
+		{
+			const uint16_t rgb[] = { 0, 65535, 32768, 1000, 50000, 20000 };
+			CompactImage image(2, 1, rgb, 1.f);
+			Assert::IsTrue(CompactImage::Format::Linear16 == image.format());
+			assertFuzzyEqual(glm::vec3(0.f, 1.f, 0.5f), image.get(0, 0), 1e-4f);
+			assertFuzzyEqual(glm::vec3(1000.f, 50000.f, 20000.f) / 65535.f, image.get(1, 0), 1e-4f);
+		}
+
+		TEST_METHOD(TestFile)
+		{
+			// TODO: avoid using absolute path on my machine
+			const std::string path = "C:\\Users\\markf\\GitHub\\raytracer\\data\\test.png";
+			CompactImage compact(path);
+			Image image(path);
+			Assert::AreEqual(image.width(), compact.width());
+			Assert::AreEqual(image.height(), compact.height());
+			for (int y = 0; y < image.height(); ++y) {
+				for (int x = 0; x < image.width(); ++x) {
+					assertFuzzyEqual(image.get(x, y), compact.get(x, y), 1e-5f);
+				}
+			}
+
+			CompactImage missing("C:\\Users\\markf\\GitHub\\raytracer\\data\\test_nonexistent.png");
+			Assert::AreEqual(0, missing.width());
+		}
+	};
+}
@@ -0,0 +1,166 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+
+#include "test_common.h"
+#include "../src/denoiser.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTest
+{
+	TEST_CLASS(TestDenoiser)
+	{
+		// deterministic noise in [-1, 1]
+		static float noise(int x, int y) {
+			uint32_t h = static_cast<uint32_t>(x) * 73856093u ^ static_cast<uint32_t>(y) * 19349663u;
+			h ^= h >> 13;
+			h *= 0x5bd1e995u;
+			h ^= h >> 15;
+			return static_cast<float>(h & 0xffff) / 32767.5f - 1.f;
+		}
+		static void fill(Image& image, const glm::vec3& value) {
+			for (int y = 0; y < image.height(); ++y) {
+				for (int x = 0; x < image.width(); ++x) {
+					image.set(x, y, value);
+				}
+			}
+		}
+		static float meanSquaredError(const Image& image, float value) {
+			float error = 0.f;
+			for (int y = 0; y < image.height(); ++y) {
+				for (int x = 0; x < image.width(); ++x) {
+					error += (image.get(x, y).y - value) * (image.get(x, y).y - value);
+				}
+			}
+			return error / static_cast<float>(image.width() * image.height());
+		}
+	public:
+		TEST_METHOD(TestSmooth)
+		{
+			// larger than a tile, so the tiles' edges are filtered too
+			const int width = 100, height = 70;
+			Image color(width, height), normal(width, height), depth(width, height), variance(width, height), output(width, height);
+			float mean = 0.f;
+			for (int y = 0; y < height; ++y) {
+				for (int x = 0; x < width; ++x) {
+					color.set(x, y, glm::vec3(0.5f + 0.2f * noise(x, y)));
+					mean += color.get(x, y).y;
+				}
+			}
+			mean /= static_cast<float>(width * height);
+			fill(normal, glm::vec3(0.f, 0.f, 1.f));
+			fill(depth, glm::vec3(3.f));
+			fill(variance, glm::vec3(0.0133f));
+			AovImages guides;
+			guides.normal = &normal;
+			guides.depth = &depth;
+			guides.variance = &variance;
+
+			for (int threadCount : { 1, 3 }) {
+				Assert::IsTrue(Denoiser(Denoiser::Settings(), threadCount).denoise(color, guides, output));
+				Assert::IsTrue(meanSquaredError(output, mean) < 0.01f * meanSquaredError(color, mean));
+				float outputMean = 0.f;
+				for (int y = 0; y < height; ++y) {
+					for (int x = 0; x < width; ++x) {
+						outputMean += output.get(x, y).y;
+					}
+				}
+				Assert::AreEqual(mean, outputMean / static_cast<float>(width * height), 0.01f);
+			}
+		}
+
+		TEST_METHOD(TestEdges)
+		{
+			// two walls meeting at x = 16, the right one with a checkered albedo, lit evenly but noisily
+			const int width = 32, height = 24;
+			Image color(width, height), albedo(width, height), normal(width, height), depth(width, height), variance(width, height);
+			for (int y = 0; y < height; ++y) {
+				for (int x = 0; x < width; ++x) {
+					const float reflectance = x < 16 ? 0.5f : ((x / 4 + y / 4) % 2 ? 0.8f : 0.2f);
+					const float light = x < 16 ? 0.4f : 1.f;
+					albedo.set(x, y, glm::vec3(reflectance));
+					color.set(x, y, glm::vec3(reflectance * light * (1.f + 0.1f * noise(x, y))));
+					normal.set(x, y, x < 16 ? glm::vec3(1.f, 0.f, 0.f) : glm::vec3(0.f, 0.f, 1.f));
+				}
+			}
+			fill(depth, glm::vec3(2.f));
+			fill(variance, glm::vec3(0.003f));
+			AovImages guides;
+			guides.albedo = &albedo;
+			guides.normal = &normal;
+			guides.depth = &depth;
+			guides.variance = &variance;
+
+			Image output(width, height);
+			Assert::IsTrue(Denoiser().denoise(color, guides, output));
+			for (int y = 0; y < height; ++y) {
+				for (int x = 0; x < width; ++x) {
+					// the light doesn't bleed across the normals' edge, and the albedo's edges stay sharp
+					const float expected = x < 16 ? 0.2f : albedo.get(x, y).y;
+					assertFuzzyEqual(glm::vec3(expected), output.get(x, y), 0.03f);
+				}
+			}
+		}
+
+		TEST_METHOD(TestEmission)
+		{
+			// a light seen in one pixel of an otherwise dark, flat image
+			Image color(9, 9), emission(9, 9), normal(9, 9), variance(9, 9);
+			color.set(4, 4, glm::vec3(5.f, 4.f, 3.f));
+			emission.set(4, 4, glm::vec3(5.f, 4.f, 3.f));
+			fill(normal, glm::vec3(0.f, 1.f, 0.f));
+			AovImages guides;
+			guides.emission = &emission;
+			guides.normal = &normal;
+			guides.variance = &variance;
+
+			// filtered in place
+			Assert::IsTrue(Denoiser().denoise(color, guides, color));
+			for (int y = 0; y < 9; ++y) {
+				for (int x = 0; x < 9; ++x) {
+					assertFuzzyEqual(x == 4 && y == 4 ? glm::vec3(5.f, 4.f, 3.f) : glm::vec3(0.f), color.get(x, y), 1e-5f);
+				}
+			}
+		}
+
+		TEST_METHOD(TestInPlace)
+		{
+			Image color(20, 10), normal(20, 10), variance(20, 10);
+			for (int y = 0; y < 10; ++y) {
+				for (int x = 0; x < 20; ++x) {
+					color.set(x, y, glm::vec3(1.f + 0.5f * noise(x, y), 1.f, 0.5f));
+					normal.set(x, y, glm::normalize(glm::vec3(x < 10 ? 1.f : -1.f, 0.f, 1.f)));
+				}
+			}
+			fill(variance, glm::vec3(0.02f));
+			AovImages guides;
+			guides.normal = &normal;
+			guides.variance = &variance;
+
+			Image output(20, 10);
+			Assert::IsTrue(Denoiser().denoise(color, guides, output));
+			Assert::IsTrue(Denoiser().denoise(color, guides, color));
+			for (int y = 0; y < 10; ++y) {
+				for (int x = 0; x < 20; ++x) {
+					Assert::AreEqual(output.get(x, y), color.get(x, y));
+				}
+			}
+		}
+
+		TEST_METHOD(TestWrongSize)
+		{
+			Image color(8, 6), output(8, 6), wrongSize(6, 8);
+			color.set(1, 1, glm::vec3(1.f));
+			output.set(2, 2, glm::vec3(7.f));
+			AovImages guides;
+			guides.albedo = &wrongSize;
+			Assert::IsFalse(Denoiser().denoise(color, guides, output));
+			Assert::AreEqual(glm::vec3(7.f), output.get(2, 2));
+			Assert::AreEqual(glm::vec3(0.f), output.get(1, 1));
+
+			guides.albedo = nullptr;
+			Assert::IsFalse(Denoiser().denoise(color, guides, wrongSize));
+			Assert::IsTrue(Denoiser().denoise(color, guides, output));
+		}
+	};
+}
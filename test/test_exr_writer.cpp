@@ -0,0 +1,266 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <vector>
+
+#include "test_common.h"
+#include "../src/exr_writer.h"
+#include "../src/stb_image.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTest
+{
+	TEST_CLASS(TestExrWriter)
+	{
+		// What readExr() found in a file
+		struct ExrFile {
+			uint32_t flags = 0;
+			std::map<std::string, std::vector<uint8_t>> attributes;
+			std::vector<std::string> channels;
+			std::vector<int32_t> types;
+			int width = 0, height = 0, tileSize = 0, compressedChunks = 0;
+			std::map<std::string, std::vector<float>> pixels;	// by channel, in row-major order
+		};
+
+		template<typename T>
+		static T get(const std::vector<uint8_t>& bytes, size_t offset) {
+			T value;
+			std::memcpy(&value, &bytes[offset], sizeof(T));
+			return value;
+		}
+
+		static float halfToFloat(uint16_t h) {
+			const int exponent = (h >> 10) & 0x1f, mantissa = h & 0x3ff;
+			const float value = exponent == 0 ? std::ldexp(static_cast<float>(mantissa), -24)
+				: exponent == 31 ? (mantissa != 0 ? NAN : INFINITY)
+				: std::ldexp(static_cast<float>(1024 + mantissa), exponent - 25);
+			return (h & 0x8000) != 0 ? -value : value;
+		}
+
+		// A minimal reader of the files ExrWriter writes, following the OpenEXR file layout
+		static bool readExr(const std::string& path, ExrFile& exr) {
+			std::FILE* f = std::fopen(path.c_str(), "rb");
+			if (f == nullptr) return false;
+			std::vector<uint8_t> file;
+			uint8_t buffer[4096];
+			for (size_t n; (n = std::fread(buffer, 1, sizeof(buffer), f)) > 0;) file.insert(file.end(), buffer, buffer + n);
+			std::fclose(f);
+
+			const uint8_t magic[4] = { 0x76, 0x2f, 0x31, 0x01 };
+			if (file.size() < 8 || std::memcmp(file.data(), magic, 4) != 0) return false;
+			exr.flags = get<uint32_t>(file, 4);
+			size_t at = 8;
+			auto readString = [&]() {
+				std::string s(reinterpret_cast<const char*>(&file[at]));
+				at += s.size() + 1;
+				return s;
+			};
+			for (std::string name = readString(); !name.empty(); name = readString()) {
+				readString();	// type
+				const int32_t size = get<int32_t>(file, at);
+				at += 4;
+				exr.attributes[name] = std::vector<uint8_t>(file.begin() + at, file.begin() + at + size);
+				at += size;
+			}
+			const std::vector<uint8_t>& channels = exr.attributes["channels"];
+			for (size_t c = 0; channels[c] != 0;) {
+				exr.channels.push_back(reinterpret_cast<const char*>(&channels[c]));
+				c += exr.channels.back().size() + 1;
+				exr.types.push_back(get<int32_t>(channels, c));
+				c += 16;
+			}
+			const std::vector<uint8_t>& window = exr.attributes["dataWindow"];
+			exr.width = get<int32_t>(window, 8) + 1;
+			exr.height = get<int32_t>(window, 12) + 1;
+			const bool zip = exr.attributes["compression"][0] == 3;
+			if (exr.attributes.count("tiles") > 0) exr.tileSize = get<int32_t>(exr.attributes["tiles"], 0);
+			for (const std::string& channel : exr.channels) {
+				exr.pixels[channel].assign(static_cast<size_t>(exr.width) * exr.height, NAN);
+			}
+
+			const int rows = exr.tileSize > 0 ? exr.tileSize : (zip ? 16 : 1);
+			const int columns = exr.tileSize > 0 ? exr.tileSize : exr.width;
+			const int chunks = ((exr.width + columns - 1) / columns) * ((exr.height + rows - 1) / rows);
+			for (int i = 0; i < chunks; ++i) {
+				size_t chunk = static_cast<size_t>(get<uint64_t>(file, at + i * 8));
+				int x0 = 0, y0 = 0;
+				if (exr.tileSize > 0) {
+					x0 = get<int32_t>(file, chunk) * exr.tileSize;
+					y0 = get<int32_t>(file, chunk + 4) * exr.tileSize;
+					chunk += 16;
+				}
+				else {
+					y0 = get<int32_t>(file, chunk);
+					chunk += 4;
+				}
+				const int32_t size = get<int32_t>(file, chunk);
+				chunk += 4;
+				const int x1 = glm::min(x0 + columns, exr.width), y1 = glm::min(y0 + rows, exr.height);
+				size_t expected = 0;
+				for (int32_t type : exr.types) expected += static_cast<size_t>(x1 - x0) * (y1 - y0) * (type == 1 ? 2 : 4);
+
+				std::vector<uint8_t> data(file.begin() + chunk, file.begin() + chunk + size);
+				if (static_cast<size_t>(size) < expected) {
+					++exr.compressedChunks;
+					std::vector<uint8_t> predicted(expected);
+					if (stbi_zlib_decode_buffer(reinterpret_cast<char*>(predicted.data()), static_cast<int>(expected),
+						reinterpret_cast<const char*>(data.data()), size) != static_cast<int>(expected)) return false;
+					for (size_t j = 1; j < expected; ++j) predicted[j] = static_cast<uint8_t>(predicted[j - 1] + predicted[j] - 128);
+					const size_t half = (expected + 1) / 2;
+					data.resize(expected);
+					for (size_t j = 0; j < expected; ++j) data[j] = predicted[(j & 1) == 0 ? j / 2 : half + j / 2];
+				}
+				else if (static_cast<size_t>(size) != expected) {
+					return false;
+				}
+
+				size_t offset = 0;
+				for (int y = y0; y < y1; ++y) {
+					for (size_t c = 0; c < exr.channels.size(); ++c) {
+						for (int x = x0; x < x1; ++x) {
+							float& value = exr.pixels[exr.channels[c]][static_cast<size_t>(y) * exr.width + x];
+							if (exr.types[c] == 1) {
+								value = halfToFloat(get<uint16_t>(data, offset));
+								offset += 2;
+							}
+							else {
+								value = get<float>(data, offset);
+								offset += 4;
+							}
+						}
+					}
+				}
+			}
+			return true;
+		}
+
+		// smooth, with values beyond [0, 1] as renders have
+		static Image gradient(int width, int height, Image::Layout layout, float scale) {
+			Image image(width, height, layout);
+			for (int y = 0; y < height; ++y) {
+				for (int x = 0; x < width; ++x) {
+					image.set(x, y, scale * glm::vec3(x * 0.1f, y * 0.25f - 2.f, 1.f / (1.f + x + y)));
+				}
+			}
+			return image;
+		}
+
+		static void assertPixels(const ExrFile& exr, const std::string& layer, const Image& image, float tolerance) {
+			const char* components[3] = { "R", "G", "B" };
+			for (int c = 0; c < 3; ++c) {
+				const std::vector<float>& pixels = exr.pixels.at(layer.empty() ? components[c] : layer + "." + components[c]);
+				for (int y = 0; y < image.height(); ++y) {
+					for (int x = 0; x < image.width(); ++x) {
+						const float expected = image.get(x, y)[c], value = pixels[static_cast<size_t>(y) * image.width() + x];
+						Assert::IsTrue(std::abs(value - expected) <= tolerance * std::abs(expected));
+					}
+				}
+			}
+		}
+	public:
+		TEST_METHOD(TestFloatToHalf)
+		{
+			Assert::AreEqual(0x0000, static_cast<int>(floatToHalf(0.f)));
+			Assert::AreEqual(0x8000, static_cast<int>(floatToHalf(-0.f)));
+			Assert::AreEqual(0x3c00, static_cast<int>(floatToHalf(1.f)));
+			Assert::AreEqual(0xc000, static_cast<int>(floatToHalf(-2.f)));
+			Assert::AreEqual(0x2e66, static_cast<int>(floatToHalf(0.1f)));
+			Assert::AreEqual(0x7bff, static_cast<int>(floatToHalf(65504.f)));
+			Assert::AreEqual(0x7c00, static_cast<int>(floatToHalf(65520.f)));
+			Assert::AreEqual(0x7c00, static_cast<int>(floatToHalf(INFINITY)));
+			Assert::IsTrue((floatToHalf(NAN) & 0x7fff) > 0x7c00);
+			// ties go to even
+			Assert::AreEqual(0x3c00, static_cast<int>(floatToHalf(1.f + std::ldexp(1.f, -11))));
+			Assert::AreEqual(0x3c02, static_cast<int>(floatToHalf(1.f + 3.f * std::ldexp(1.f, -11))));
+			// denormals, and the smallest normal
+			Assert::AreEqual(0x0001, static_cast<int>(floatToHalf(std::ldexp(1.f, -24))));
+			Assert::AreEqual(0x0000, static_cast<int>(floatToHalf(std::ldexp(1.f, -25))));
+			Assert::AreEqual(0x0001, static_cast<int>(floatToHalf(std::ldexp(1.5f, -25))));
+			Assert::AreEqual(0x0400, static_cast<int>(floatToHalf(std::ldexp(1.f, -14))));
+			for (float value : { 0.5f, 3.25f, -1000.f, 0.000123f }) {
+				Assert::IsTrue(std::abs(halfToFloat(floatToHalf(value)) - value) <= std::abs(value) / 2048.f);
+			}
+		}
+
+		TEST_METHOD(TestLayers)
+		{
+			const std::string file = "test_exr_writer.exr";
+			// planar and interleaved, 37 x 50 pixels to leave partial blocks and tiles
+			const Image beauty = gradient(37, 50, Image::Layout::Planar, 1.f);
+			const Image albedo = gradient(37, 50, Image::Layout::Interleaved, 0.5f);
+			const std::vector<ExrWriter::Layer> layers = {
+				{ "", &beauty, ExrWriter::PixelType::Float },
+				{ "albedo", &albedo, ExrWriter::PixelType::Half },
+			};
+			for (ExrWriter::Compression compression : { ExrWriter::Compression::None, ExrWriter::Compression::Zip }) {
+				for (int tileSize : { 0, 16 }) {
+					Assert::IsTrue(writeExr(file, layers, compression, tileSize, 3));
+					ExrFile exr;
+					Assert::IsTrue(readExr(file, exr));
+					Assert::AreEqual(tileSize > 0 ? 0x202u : 2u, exr.flags);
+					Assert::AreEqual(37, exr.width);
+					Assert::AreEqual(50, exr.height);
+					Assert::AreEqual(tileSize, exr.tileSize);
+					const std::vector<std::string> channels = { "B", "G", "R", "albedo.B", "albedo.G", "albedo.R" };
+					Assert::IsTrue(channels == exr.channels);
+					Assert::IsTrue(std::vector<int32_t>({ 2, 2, 2, 1, 1, 1 }) == exr.types);
+					Assert::AreEqual(compression == ExrWriter::Compression::Zip, exr.compressedChunks > 0);
+					assertPixels(exr, "", beauty, 0.f);
+					assertPixels(exr, "albedo", albedo, 1.f / 2048.f);
+				}
+			}
+		}
+
+		TEST_METHOD(TestTilesAsTheyFinish)
+		{
+			const std::string file = "test_exr_writer_tiles.exr";
+			std::remove(file.c_str());
+			Image image(40, 24, Image::Layout::Planar);
+			// tiles written as they are filled in, backwards and from several threads, without compression to be written
+			// straight from the image
+			{
+				ExrWriter writer(file, { { "", &image, ExrWriter::PixelType::Float } }, ExrWriter::Compression::None, 16);
+				Assert::IsTrue(writer.ok());
+				Assert::AreEqual(6, writer.chunks());
+				Assert::AreEqual(4, writer.chunkAt(17, 20));
+				std::atomic<int> failures(0);
+				parallelFor(writer.chunks(), 2, [&](int i) {
+					const int chunk = writer.chunks() - 1 - i;
+					const PixelRect rect = writer.chunkRect(chunk);
+					for (int y = rect.min.y; y < rect.max.y; ++y) {
+						for (int x = rect.min.x; x < rect.max.x; ++x) image.set(x, y, glm::vec3(x, y, chunk));
+					}
+					if (!writer.writeChunk(chunk)) ++failures;
+				});
+				Assert::AreEqual(0, failures.load());
+				Assert::IsTrue(writer.finish());
+			}
+			ExrFile exr;
+			Assert::IsTrue(readExr(file, exr));
+			assertPixels(exr, "", image, 0.f);
+
+			// a missing tile leaves no file
+			std::remove(file.c_str());
+			{
+				ExrWriter writer(file, { { "", &image, ExrWriter::PixelType::Half } }, ExrWriter::Compression::Zip, 16);
+				for (int chunk = 1; chunk < writer.chunks(); ++chunk) Assert::IsTrue(writer.writeChunk(chunk));
+				Assert::IsFalse(writer.finish());
+			}
+			Assert::IsFalse(readExr(file, exr));
+		}
+
+		TEST_METHOD(TestInvalid)
+		{
+			const Image image(8, 8), other(8, 9);
+			Assert::IsFalse(ExrWriter("test_exr_writer_invalid.exr", {}).ok());
+			Assert::IsFalse(ExrWriter("test_exr_writer_invalid.exr", { { "", &image, ExrWriter::PixelType::Half }, { "a", &other, ExrWriter::PixelType::Half } }).ok());
+			Assert::IsFalse(ExrWriter("test_exr_writer_invalid.exr", { { "a", &image, ExrWriter::PixelType::Half }, { "a", &image, ExrWriter::PixelType::Float } }).ok());
+		}
+	};
+}
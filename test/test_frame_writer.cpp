@@ -0,0 +1,79 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+
+#include <cstdio>
+
+#include "test_common.h"
+#include "../src/frame_writer.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTest
+{
+	TEST_CLASS(TestFrameWriter)
+	{
+		static std::string frameFile(int frame, const char* extension) {
+			return "test_frame_writer_" + std::to_string(frame) + extension;
+		}
+		static Image frameImage(int frame) {
+			Image image(5, 3);
+			image.set(frame % 5, 1, glm::vec3(1.f));
+			return image;
+		}
+	public:
+		TEST_METHOD(TestWrite)
+		{
+			// more frames than are held at once, so write() has to wait for the threads
+			for (int threadCount : { 1, 3 }) {
+				FrameWriter writer(threadCount, 2);
+				for (int frame = 0; frame < 8; ++frame) {
+					writer.write(frameImage(frame), frameFile(frame, ".png"));
+				}
+				Assert::IsTrue(writer.finish());
+				for (int frame = 0; frame < 8; ++frame) {
+					Image image(frameFile(frame, ".png"));
+					Assert::AreEqual(5, image.width());
+					Assert::AreEqual(3, image.height());
+					for (int x = 0; x < 5; ++x) {
+						assertFuzzyEqual(glm::vec3(x == frame % 5 ? 1.f : 0.f), image.get(x, 1), 1e-6f);
+					}
+					Assert::AreEqual(glm::vec3(0.f), image.get(frame % 5, 0));
+				}
+			}
+		}
+
+		TEST_METHOD(TestFormats)
+		{
+			{
+				FrameWriter writer;
+				writer.write(frameImage(1), frameFile(0, ".pfm"));
+				writer.write(frameImage(2), frameFile(0, ".exr"));
+				// the destructor waits for the frames
+			}
+			const char* magic[] = { "PF\n", "\x76\x2f\x31" };
+			const char* extensions[] = { ".pfm", ".exr" };
+			for (int i = 0; i < 2; ++i) {
+				std::FILE* f = std::fopen(frameFile(0, extensions[i]).c_str(), "rb");
+				Assert::IsTrue(f != nullptr);
+				char header[4] = {};
+				Assert::AreEqual(static_cast<size_t>(3), std::fread(header, 1, 3, f));
+				std::fclose(f);
+				Assert::AreEqual(std::string(magic[i]), std::string(header));
+			}
+		}
+
+		TEST_METHOD(TestWriteFails)
+		{
+			FrameWriter writer(2);
+			// a directory, which can't be opened as a file
+			writer.write(frameImage(0), "C:\\Users\\markf\\GitHub\\raytracer\\data\\");
+			writer.write(frameImage(1), frameFile(1, ".pfm"));
+			Assert::IsFalse(writer.finish());
+			Assert::AreEqual(1, writer.failures());
+			// later frames are still written
+			std::FILE* f = std::fopen(frameFile(1, ".pfm").c_str(), "rb");
+			Assert::IsTrue(f != nullptr);
+			std::fclose(f);
+		}
+	};
+}
@@ -7,6 +7,7 @@
 #include "../src/sphere.h"
 #include "../src/quad.h"
 #include "../src/lambertian.h"
+#include "../src/transform.h"
 
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
 
@@ -235,5 +236,35 @@ namespace UnitTest
 				testHitTRange(hittables, ray, quadHit, quadHit.t, 0.5f, 1e-4f);
 			}
 		}
+
+		TEST_METHOD(TestForEachQuad)
+		{
+			auto material = std::make_shared<Lambertian>(glm::vec3(0.5f));
+			auto inner = std::make_shared<HittableList>();
+			inner->add(std::make_shared<Quad>(glm::vec3(1.f, 0.f, 0.f), glm::vec3(1.f, 0.f, 0.f), glm::vec3(0.f, 2.f, 0.f), material));
+
+			HittableList hittables;
+			hittables.add(std::make_shared<Quad>(glm::vec3(0.f), glm::vec3(0.f, 0.f, 1.f), glm::vec3(1.f, 0.f, 0.f), material));
+			hittables.add(std::make_shared<Transform>(inner, glm::vec3(0.f, 0.f, 5.f), glm::mat3(1.f), glm::vec3(2.f)));
+
+			std::vector<glm::vec3> corners, sides;
+			Assert::IsTrue(hittables.forEachQuad([&](const glm::vec3& corner, const glm::vec3& side1, const glm::vec3& side2, const std::shared_ptr<Material>& quadMaterial) {
+				Assert::IsTrue(quadMaterial == material);
+				corners.push_back(corner);
+				sides.push_back(side1);
+				sides.push_back(side2);
+			}));
+			Assert::AreEqual(size_t(2), corners.size());
+			Assert::AreEqual(glm::vec3(0.f), corners[0]);
+			Assert::AreEqual(glm::vec3(0.f, 0.f, 1.f), sides[0]);
+			Assert::AreEqual(glm::vec3(1.f, 0.f, 0.f), sides[1]);
+			// the transformed quad is reported in world space
+			Assert::AreEqual(glm::vec3(2.f, 0.f, 5.f), corners[1]);
+			Assert::AreEqual(glm::vec3(2.f, 0.f, 0.f), sides[2]);
+			Assert::AreEqual(glm::vec3(0.f, 4.f, 0.f), sides[3]);
+
+			hittables.add(std::make_shared<Sphere>(glm::vec3(0.f), 1.f, material));
+			Assert::IsFalse(hittables.forEachQuad([](const glm::vec3&, const glm::vec3&, const glm::vec3&, const std::shared_ptr<Material>&) {}));
+		}
 	};
 }
\ No newline at end of file
@@ -1,6 +1,8 @@
 #include "pch.h"
 #include "CppUnitTest.h"
 
+#include <cstdio>
+
 #include "test_common.h"
 #include "../src/image.h"
 
@@ -111,6 +113,38 @@ namespace UnitTest
 			}
 		}
 
+		TEST_METHOD(TestLayout)
+		{
+			const int width = 21, height = 5;
+			Image interleaved(width, height);
+			Image planar(width, height, Image::Layout::Planar);
+			Assert::AreEqual(3, interleaved.pixelStride());
+			Assert::AreEqual(1, planar.pixelStride());
+			for (int y = 0; y < height; ++y) {
+				for (int x = 0; x < width; ++x) {
+					glm::vec3 value(static_cast<float>(x), static_cast<float>(y), static_cast<float>(x * y));
+					interleaved.set(x, y, value);
+					planar.set(x, y, value);
+				}
+			}
+
+			for (int y = 0; y < height; ++y) {
+				for (int c = 0; c < 3; ++c) {
+					// rows of every channel start on a cache line, and hold the channel's values pixelStride() apart
+					Assert::AreEqual(size_t(0), reinterpret_cast<uintptr_t>(planar.channel(c, y)) % cacheLineSize);
+					Assert::AreEqual(size_t(0), reinterpret_cast<uintptr_t>(interleaved.channel(0, y)) % cacheLineSize);
+					for (int x = 0; x < width; ++x) {
+						Assert::AreEqual(interleaved.get(x, y)[c], interleaved.channel(c, y)[x * 3]);
+						Assert::AreEqual(interleaved.get(x, y)[c], planar.channel(c, y)[x]);
+					}
+				}
+			}
+
+			Image copy(1, 1);
+			copy = planar;
+			Assert::AreEqual(glm::vec3(20.f, 4.f, 80.f), copy.get(20, 4));
+		}
+
 		TEST_METHOD(TestWrite)
 		{
 			// TODO: avoid using absolute path on my machine
@@ -147,5 +181,29 @@ namespace UnitTest
 				assertFuzzyEqual(glm::vec3(0.5f, 0.5f, 0.f), image.get(10, 44), tolerance);
 			}
 		}
+
+		TEST_METHOD(TestWritePfm)
+		{
+			const std::string path = "test_image.pfm";
+			for (Image::Layout layout : { Image::Layout::Interleaved, Image::Layout::Planar }) {
+				Image image(3, 2, layout);
+				image.set(0, 0, glm::vec3(1.f, 2.f, 3.f));
+				image.set(2, 1, glm::vec3(-0.5f, 100.f, 0.25f));
+				Assert::IsTrue(image.writePfm(path));
+
+				std::FILE* f = std::fopen(path.c_str(), "rb");
+				Assert::IsTrue(f != nullptr);
+				char header[16] = {};
+				Assert::AreEqual(static_cast<size_t>(12), std::fread(header, 1, 12, f));
+				Assert::AreEqual(std::string("PF\n3 2\n-1.0\n"), std::string(header));
+				float values[18];
+				Assert::AreEqual(static_cast<size_t>(18), std::fread(values, sizeof(float), 18, f));
+				Assert::AreEqual(static_cast<size_t>(0), std::fread(values, 1, 1, f));
+				std::fclose(f);
+				// the bottom row first, unclamped
+				Assert::AreEqual(glm::vec3(-0.5f, 100.f, 0.25f), glm::vec3(values[6], values[7], values[8]));
+				Assert::AreEqual(glm::vec3(1.f, 2.f, 3.f), glm::vec3(values[9], values[10], values[11]));
+			}
+		}
 	};
 }
\ No newline at end of file
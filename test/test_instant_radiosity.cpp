@@ -0,0 +1,94 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+
+#include "test_common.h"
+#include "../src/instant_radiosity.h"
+#include "../src/quad.h"
+#include "../src/lambertian.h"
+#include "../src/emissive.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTest
+{
+	TEST_CLASS(TestInstantRadiosity)
+	{
+		// 2 x 2 light facing down onto a 10 x 10 floor, 4 units below
+		HittableList m_world;
+		HittableList m_lights;
+		const glm::vec3 m_emitted = glm::vec3(4.f);
+		const glm::vec3 m_albedo = glm::vec3(0.5f);
+
+		void makeScene() {
+			auto light = std::make_shared<Quad>(glm::vec3(-1.f, 4.f, -1.f), glm::vec3(2.f, 0.f, 0.f), glm::vec3(0.f, 0.f, 2.f), std::make_shared<DiffuseEmissive>(m_emitted));
+			auto floor = std::make_shared<Quad>(glm::vec3(-5.f, 0.f, -5.f), glm::vec3(0.f, 0.f, 10.f), glm::vec3(10.f, 0.f, 0.f), std::make_shared<Lambertian>(m_albedo));
+			m_world.add(light);
+			m_world.add(floor);
+			m_lights.add(light);
+		}
+	public:
+		TEST_METHOD(TestEmitterVPLs)
+		{
+			makeScene();
+			InstantRadiosityIntegrator::Settings settings;
+			settings.lightPaths = 1000;
+			InstantRadiosityIntegrator integrator(m_world, m_lights, settings, 2, 1);
+
+			// one VPL on the light per path, together carrying emitted radiance * light area
+			glm::vec3 emitterIntensity = glm::vec3(0.f);
+			int emitters = 0;
+			for (const InstantRadiosityIntegrator::VPL& vpl : integrator.vpls()) {
+				if (vpl.twoSided) {
+					emitterIntensity += vpl.intensity;
+					++emitters;
+					Assert::AreEqual(4.f, vpl.point.y, 1e-4f);
+				}
+				else {
+					// maxBounces = 2 leaves room for one bounce VPL, on the floor
+					Assert::AreEqual(0.f, vpl.point.y, 1e-4f);
+				}
+			}
+			Assert::AreEqual(1000, emitters);
+			assertFuzzyEqual(m_emitted * 4.f, emitterIntensity, 1e-3f);
+			Assert::IsTrue(integrator.vpls().size() > 1000);
+		}
+
+		TEST_METHOD(TestSeeLight)
+		{
+			makeScene();
+			InstantRadiosityIntegrator integrator(m_world, m_lights, InstantRadiosityIntegrator::Settings(), 2, 1);
+			IndependentSampler sampler;
+			Ray ray(glm::vec3(0.f, 2.f, 0.f), glm::vec3(0.f, 1.f, 0.f));
+			Assert::AreEqual(m_emitted, integrator.radiance(ray, sampler));
+		}
+
+		TEST_METHOD(TestExactCut)
+		{
+			makeScene();
+			InstantRadiosityIntegrator::Settings settings;
+			settings.lightPaths = 200;
+			settings.clampDistance = 0.5f;
+			settings.errorThreshold = 0.f;
+			settings.maxCutSize = 1 << 20;
+			InstantRadiosityIntegrator integrator(m_world, m_lights, settings, 1, 1);
+
+			// with no error allowed the cut reaches every VPL, and the result is their plain sum
+			const glm::vec3 point(0.5f, 0.f, 1.f);
+			const glm::vec3 normal(0.f, 1.f, 0.f);
+			glm::vec3 expected = glm::vec3(0.f);
+			for (const InstantRadiosityIntegrator::VPL& vpl : integrator.vpls()) {
+				glm::vec3 d = vpl.point - point;
+				float dist2 = glm::dot(d, d);
+				glm::vec3 wi = glm::normalize(d);
+				float g = glm::max(glm::dot(wi, normal), 0.f) * glm::abs(glm::dot(wi, vpl.normal)) / glm::max(dist2, 0.25f);
+				expected += m_albedo / pi * vpl.intensity * g;
+			}
+
+			IndependentSampler sampler;
+			Ray ray(glm::vec3(0.5f, 2.f, 1.f), glm::vec3(0.f, -1.f, 0.f));
+			glm::vec3 result = integrator.radiance(ray, sampler);
+			assertFuzzyEqual(expected, result, 1e-4f);
+			Assert::IsTrue(result.x > 0.f);
+		}
+	};
+}
@@ -0,0 +1,95 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+
+#include <cstdio>
+
+#include "test_common.h"
+#include "../src/mapped_framebuffer.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTest
+{
+	TEST_CLASS(TestMappedFramebuffer)
+	{
+		static bool exists(const char* file) {
+			std::FILE* f = std::fopen(file, "rb");
+			if (f != nullptr) std::fclose(f);
+			return f != nullptr;
+		}
+	public:
+		TEST_METHOD(TestConstructor)
+		{
+			MappedFramebuffer framebuffer("test_mapped_framebuffer.bin", 37, 20, 16);
+			Assert::IsTrue(framebuffer.valid());
+			Assert::AreEqual(37, framebuffer.width());
+			Assert::AreEqual(20, framebuffer.height());
+			// 3 x 2 blocks, each at least 16 * 16 pixels
+			Assert::IsTrue(framebuffer.size() >= 6 * 16 * 16 * 16);
+			Assert::AreEqual(0, framebuffer.count(36, 19));
+			Assert::AreEqual(glm::vec3(0.f), framebuffer.mean(36, 19));
+		}
+
+		TEST_METHOD(TestAdd)
+		{
+			// blocks through (5, 3), so the image starts and ends with partial blocks
+			MappedFramebuffer framebuffer("test_mapped_framebuffer.bin", 20, 12, 4, glm::ivec2(5, 3));
+			Assert::IsTrue(framebuffer.valid());
+			for (int y = 0; y < 12; ++y) {
+				for (int x = 0; x < 20; ++x) {
+					framebuffer.add(x, y, glm::vec3(static_cast<float>(x), static_cast<float>(y), 1.f));
+				}
+			}
+			framebuffer.add(19, 11, glm::vec3(21.f, 13.f, 3.f));
+			for (int y = 0; y < 11; ++y) {
+				for (int x = 0; x < 20; ++x) {
+					Assert::AreEqual(1, framebuffer.count(x, y));
+					Assert::AreEqual(glm::vec3(static_cast<float>(x), static_cast<float>(y), 1.f), framebuffer.mean(x, y));
+				}
+			}
+			Assert::AreEqual(2, framebuffer.count(19, 11));
+			Assert::AreEqual(glm::vec3(20.f, 12.f, 2.f), framebuffer.mean(19, 11));
+		}
+
+		TEST_METHOD(TestRelease)
+		{
+			MappedFramebuffer framebuffer("test_mapped_framebuffer.bin", 40, 40, 16);
+			framebuffer.add(3, 4, glm::vec3(1.f, 2.f, 3.f));
+			framebuffer.add(20, 30, glm::vec3(4.f));
+			// released blocks read back from the file, and the rest is untouched
+			framebuffer.release(PixelRect(glm::ivec2(0), glm::ivec2(16)));
+			framebuffer.release(PixelRect(glm::ivec2(-8), glm::ivec2(100)));
+			Assert::AreEqual(glm::vec3(1.f, 2.f, 3.f), framebuffer.mean(3, 4));
+			Assert::AreEqual(glm::vec3(4.f), framebuffer.mean(20, 30));
+			Assert::AreEqual(0, framebuffer.count(4, 3));
+			framebuffer.add(3, 4, glm::vec3(3.f, 2.f, 1.f));
+			Assert::AreEqual(glm::vec3(2.f), framebuffer.mean(3, 4));
+		}
+
+		TEST_METHOD(TestResolveTile)
+		{
+			MappedFramebuffer framebuffer("test_mapped_framebuffer.bin", 8, 8, 4);
+			framebuffer.add(5, 6, glm::vec3(2.f));
+			framebuffer.add(5, 6, glm::vec3(4.f));
+			Image tile(3, 3);
+			tile.set(0, 0, glm::vec3(9.f));
+			framebuffer.resolveTile(tile, PixelRect(glm::ivec2(4, 5), glm::ivec2(7, 8)));
+			Assert::AreEqual(glm::vec3(3.f), tile.get(1, 1));
+			Assert::AreEqual(glm::vec3(0.f), tile.get(0, 0));
+		}
+
+		TEST_METHOD(TestFile)
+		{
+			{
+				MappedFramebuffer framebuffer("test_mapped_framebuffer.bin", 4, 4);
+				Assert::IsTrue(framebuffer.valid());
+				Assert::IsTrue(exists("test_mapped_framebuffer.bin"));
+			}
+			Assert::IsFalse(exists("test_mapped_framebuffer.bin"));
+			// a directory can't be mapped
+			MappedFramebuffer invalid("C:\\Users\\markf\\GitHub\\raytracer\\data\\", 4, 4);
+			Assert::IsFalse(invalid.valid());
+			Assert::AreEqual(size_t(0), invalid.size());
+		}
+	};
+}
@@ -0,0 +1,66 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+
+#include <vector>
+
+#include "test_common.h"
+#include "../src/mipmap.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTest
+{
+	TEST_CLASS(TestMipMap)
+	{
+		// checkerboard of single black and white texels, 16-bit so that averages are exact
+		static CompactImage checkerboard(int width, int height) {
+			std::vector<uint16_t> rgb(width * height * 3);
+			for (int y = 0; y < height; ++y) {
+				for (int x = 0; x < width; ++x) {
+					for (int c = 0; c < 3; ++c) {
+						rgb[(y * width + x) * 3 + c] = (x + y) % 2 == 0 ? 65535 : 0;
+					}
+				}
+			}
+			return CompactImage(width, height, rgb.data(), 1.f);
+		}
+	public:
+		TEST_METHOD(TestLevels)
+		{
+			MipMap mipmap(checkerboard(13, 10), 2);
+			const glm::ivec2 sizes[] = { glm::ivec2(13, 10), glm::ivec2(7, 5), glm::ivec2(4, 3), glm::ivec2(2, 2), glm::ivec2(1, 1) };
+			Assert::AreEqual(5, mipmap.levels());
+			for (int i = 0; i < mipmap.levels(); ++i) {
+				Assert::AreEqual(sizes[i], glm::ivec2(mipmap.level(i).width(), mipmap.level(i).height()));
+			}
+			// every 2x2 block of the checkerboard averages to gray
+			for (int y = 0; y < 5; ++y) {
+				for (int x = 0; x < 6; ++x) {
+					assertFuzzyEqual(glm::vec3(0.5f), mipmap.level(1).get(x, y), 1e-4f);
+				}
+			}
+		}
+
+		TEST_METHOD(TestLookup)
+		{
+			MipMap mipmap(checkerboard(64, 64));
+			const float texel = 1.f / 64.f;
+			const glm::vec2 st(10.5f * texel, 20.5f * texel);
+
+			// at the center of a white texel, with no footprint, every filter returns the texel
+			for (MipMap::Filter filter : { MipMap::Filter::Nearest, MipMap::Filter::Trilinear, MipMap::Filter::EWA }) {
+				assertFuzzyEqual(glm::vec3(1.f), mipmap.lookup(filter, st, glm::vec2(0.f), glm::vec2(0.f)), 1e-4f);
+			}
+			// halfway between two texel centers
+			assertFuzzyEqual(glm::vec3(0.5f), mipmap.bilinear(0, st + glm::vec2(0.5f * texel, 0.f)), 1e-4f);
+
+			// footprints of a few texels average the checkerboard away, for square and long thin ones
+			for (MipMap::Filter filter : { MipMap::Filter::Trilinear, MipMap::Filter::EWA }) {
+				assertFuzzyEqual(glm::vec3(0.5f), mipmap.lookup(filter, st, glm::vec2(4.f * texel, 0.f), glm::vec2(0.f, 4.f * texel)), 0.02f);
+				assertFuzzyEqual(glm::vec3(0.5f), mipmap.lookup(filter, st, glm::vec2(16.f * texel, 0.f), glm::vec2(0.f, 2.f * texel)), 0.02f);
+			}
+			// a footprint larger than the texture is its average
+			assertFuzzyEqual(glm::vec3(0.5f), mipmap.trilinear(st, 2.f), 1e-4f);
+		}
+	};
+}
@@ -0,0 +1,73 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+
+#include <vector>
+
+#include "test_common.h"
+#include "../src/mlt.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTest
+{
+	TEST_CLASS(TestMLTSampler)
+	{
+		static std::vector<float> draw(Sampler& sampler, int count) {
+			std::vector<float> values;
+			for (int i = 0; i < count; ++i) {
+				values.push_back(sampler.get1D());
+			}
+			return values;
+		}
+	public:
+		TEST_METHOD(TestReplay)
+		{
+			// same seed, same paths
+			MLTSampler a(7, 0.01f, 0.3f);
+			MLTSampler b(7, 0.01f, 0.3f);
+			Assert::IsTrue(draw(a, 10) == draw(b, 10));
+			for (int i = 0; i < 20; ++i) {
+				a.startIteration();
+				b.startIteration();
+				Assert::IsTrue(draw(a, 10) == draw(b, 10));
+				a.accept();
+				b.accept();
+			}
+
+			// different seeds, different paths
+			MLTSampler c(7, 0.01f, 0.3f);
+			MLTSampler d(8, 0.01f, 0.3f);
+			Assert::IsFalse(draw(c, 10) == draw(d, 10));
+		}
+
+		TEST_METHOD(TestRange)
+		{
+			MLTSampler sampler(3, 0.5f, 0.3f);
+			for (int i = 0; i < 200; ++i) {
+				sampler.startIteration();
+				for (float value : draw(sampler, 8)) {
+					Assert::IsTrue(0.f <= value && value < 1.f);
+				}
+				if (i % 2 == 0) sampler.accept(); else sampler.reject();
+			}
+		}
+
+		TEST_METHOD(TestSmallStepsAndReject)
+		{
+			// only small steps: every mutation of the accepted state stays close to it (on the circle)
+			MLTSampler sampler(11, 0.01f, 0.f);
+			const std::vector<float> initial = draw(sampler, 6);
+			for (int i = 0; i < 100; ++i) {
+				sampler.startIteration();
+				const std::vector<float> mutated = draw(sampler, 6);
+				Assert::IsFalse(mutated == initial);
+				for (size_t k = 0; k < initial.size(); ++k) {
+					float d = glm::abs(mutated[k] - initial[k]);
+					Assert::IsTrue(glm::min(d, 1.f - d) < 0.1f);
+				}
+				// rejecting returns to the initial state, so mutations never drift away from it
+				sampler.reject();
+			}
+		}
+	};
+}
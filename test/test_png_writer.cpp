@@ -0,0 +1,67 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+
+#include <atomic>
+#include <vector>
+
+#include "test_common.h"
+#include "../src/image.h"
+#include "../src/png_writer.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTest
+{
+	TEST_CLASS(TestPngWriter)
+	{
+	public:
+		// smooth enough for matches and filters to pay off, with some noise for literals
+		static uint8_t value(int x, int y, int c) {
+			return static_cast<uint8_t>(x * (c + 1) + y * 3 + (x * 7919 + y * 104729 + c) % 5);
+		}
+
+		TEST_METHOD(TestRoundTrip)
+		{
+			// TODO: avoid using absolute path on my machine
+			const std::string path = "C:\\Users\\markf\\GitHub\\raytracer\\data\\testWritePng.png";
+			// one pixel; one group; many groups, with threads left over in the last batch
+			const glm::ivec2 sizes[] = { glm::ivec2(1, 1), glm::ivec2(31, 7), glm::ivec2(300, 1000) };
+			for (const glm::ivec2& size : sizes) {
+				for (int threadCount : { 1, 3 }) {
+					const int width = size.x;
+					std::vector<std::atomic<int>> requests(size.y);
+					for (std::atomic<int>& count : requests) count = 0;
+					Assert::IsTrue(writePng(path, size.x, size.y, [width, &requests](int y, uint8_t* row) {
+						++requests[y];
+						for (int x = 0; x < width; ++x) {
+							for (int c = 0; c < 3; ++c) row[x * 3 + c] = value(x, y, c);
+						}
+					}, threadCount));
+					// each row once, even at the groups' edges
+					for (const std::atomic<int>& count : requests) {
+						Assert::AreEqual(1, count.load());
+					}
+
+					// read, without gamma decoding
+					Image image(path, 1.f);
+					Assert::AreEqual(size.x, image.width());
+					Assert::AreEqual(size.y, image.height());
+					for (int y = 0; y < size.y; ++y) {
+						for (int x = 0; x < size.x; ++x) {
+							const glm::vec3 expected(value(x, y, 0), value(x, y, 1), value(x, y, 2));
+							assertFuzzyEqual(expected / 255.f, image.get(x, y), 0.001f);
+						}
+					}
+				}
+			}
+		}
+
+		TEST_METHOD(TestWriteFails)
+		{
+			// a directory, which can't be opened as a file
+			const std::string path = "C:\\Users\\markf\\GitHub\\raytracer\\data\\";
+			Assert::IsFalse(writePng(path, 4, 4, [](int, uint8_t* row) { std::fill(row, row + 12, static_cast<uint8_t>(0)); }));
+			Assert::IsFalse(writePng(path, 0, 4, [](int, uint8_t*) {}));
+		}
+	};
+}
@@ -342,5 +342,32 @@ namespace UnitTest
 				Interval::positive
 			);
 		}
+	
+		TEST_METHOD(TestSampleSurface)
+		{
+			const glm::vec3 corner(-1.f, 1.f, 1.f);
+			const glm::vec3 side1(1.f, 1.f, 1.f);
+			const glm::vec3 side2(2.f, -1.f, -1.f);
+			const Quad quad(corner, side1, side2, dummyMaterial);
+			const float tolerance = 1e-4f;
+
+			Assert::AreEqual(glm::length(glm::cross(side1, side2)), quad.area(), tolerance);
+
+			const glm::vec2 samples[5] = { glm::vec2(0.1f, 0.2f), glm::vec2(0.9f, 0.05f), glm::vec2(0.01f, 0.99f), glm::vec2(0.5f), glm::vec2(0.25f, 0.9f) };
+			for (const glm::vec2& u : samples) {
+				Hittable::HitRecord sample;
+				Assert::IsTrue(quad.sampleSurface(u, sample));
+				assertFuzzyEqual(corner + u.x * side1 + u.y * side2, sample.point, tolerance);
+				assertFuzzyEqual(quad.planeNormal(), sample.normal, tolerance);
+				assertFuzzyEqual(u, sample.uv, tolerance);
+				assertSharedPtrEqual(dummyMaterial, sample.material);
+
+				// sampled point can be hit, with the same uv
+				const glm::vec3 origin = sample.point + quad.planeNormal();
+				Hittable::HitRecord hit;
+				Assert::IsTrue(quad.hit(Ray(origin, sample.point - origin), Interval(0.5f, 1.5f), hit));
+				assertFuzzyEqual(sample.uv, hit.uv, tolerance);
+			}
+		}
 	};
 }
\ No newline at end of file
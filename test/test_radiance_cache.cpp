@@ -0,0 +1,116 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+
+#include <thread>
+#include <vector>
+
+#include "test_common.h"
+#include "../src/radiance_cache.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTest
+{
+	TEST_CLASS(TestRadianceCache)
+	{
+	public:
+		TEST_METHOD(TestEmpty)
+		{
+			RadianceCache cache(1.f, 64, 1);
+			glm::vec3 radiance;
+			Assert::IsFalse(cache.lookup(glm::vec3(0.5f), glm::vec3(0.f, 1.f, 0.f), radiance));
+		}
+
+		TEST_METHOD(TestAddLookup)
+		{
+			RadianceCache cache(1.f, 64, 2);
+			const glm::vec3 normal(0.f, 1.f, 0.f);
+			glm::vec3 radiance;
+
+			cache.add(glm::vec3(0.2f, 0.f, 0.3f), normal, glm::vec3(1.f, 2.f, 3.f));
+			Assert::IsFalse(cache.lookup(glm::vec3(0.2f, 0.f, 0.3f), normal, radiance));	// below minSamples
+
+			// same cell, slightly different normal
+			cache.add(glm::vec3(0.9f, 0.5f, 0.1f), glm::normalize(glm::vec3(0.1f, 1.f, 0.f)), glm::vec3(3.f, 0.f, 1.f));
+			Assert::IsTrue(cache.lookup(glm::vec3(0.5f), normal, radiance));
+			Assert::AreEqual(glm::vec3(2.f, 1.f, 2.f), radiance);
+		}
+
+		TEST_METHOD(TestBounces)
+		{
+			RadianceCache::Settings settings;
+			settings.startBounce = 2;
+			// the last bounce's radiance is only its emission, and the bounces after startBounce have fewer left than
+			// lookups expect
+			Assert::IsFalse(settings.adds(5, 5));
+			Assert::IsFalse(settings.adds(3, 5));
+			Assert::IsTrue(settings.adds(2, 5));
+			Assert::IsTrue(settings.adds(0, 5));
+			// no path gets as far as the lookups
+			Assert::IsFalse(settings.adds(0, 1));
+			Assert::IsFalse(settings.looksUp(1));
+			Assert::IsTrue(settings.looksUp(2));
+			Assert::IsTrue(settings.looksUp(5));
+		}
+
+		TEST_METHOD(TestSeparateCells)
+		{
+			RadianceCache cache(0.5f, 64, 1);
+			glm::vec3 radiance;
+
+			cache.add(glm::vec3(0.1f), glm::vec3(0.f, 0.f, 1.f), glm::vec3(1.f));
+			cache.add(glm::vec3(0.1f), glm::vec3(0.f, 0.f, -1.f), glm::vec3(2.f));
+			cache.add(glm::vec3(0.6f, 0.1f, 0.1f), glm::vec3(0.f, 0.f, 1.f), glm::vec3(3.f));
+
+			Assert::IsTrue(cache.lookup(glm::vec3(0.2f), glm::vec3(0.f, 0.f, 1.f), radiance));
+			Assert::AreEqual(glm::vec3(1.f), radiance);
+			Assert::IsTrue(cache.lookup(glm::vec3(0.2f), glm::vec3(0.f, 0.f, -1.f), radiance));
+			Assert::AreEqual(glm::vec3(2.f), radiance);
+			Assert::IsTrue(cache.lookup(glm::vec3(0.9f, 0.2f, 0.2f), glm::vec3(0.f, 0.f, 1.f), radiance));
+			Assert::AreEqual(glm::vec3(3.f), radiance);
+			Assert::IsFalse(cache.lookup(glm::vec3(-0.2f), glm::vec3(0.f, 0.f, 1.f), radiance));
+		}
+
+		TEST_METHOD(TestFull)
+		{
+			// more cells than slots: extra cells are dropped, not stored over existing ones
+			RadianceCache cache(1.f, 4, 1);
+			for (int i = 0; i < 16; ++i) {
+				cache.add(glm::vec3(i + 0.5f, 0.f, 0.f), glm::vec3(0.f, 1.f, 0.f), glm::vec3(static_cast<float>(i)));
+			}
+			int found = 0;
+			for (int i = 0; i < 16; ++i) {
+				glm::vec3 radiance;
+				if (cache.lookup(glm::vec3(i + 0.5f, 0.f, 0.f), glm::vec3(0.f, 1.f, 0.f), radiance)) {
+					Assert::AreEqual(glm::vec3(static_cast<float>(i)), radiance);
+					++found;
+				}
+			}
+			Assert::AreEqual(4, found);
+		}
+
+		TEST_METHOD(TestConcurrentAdd)
+		{
+			RadianceCache cache(1.f, 1024, 1);
+			const int threadCount = 8, addsPerThread = 10000, cells = 16;
+
+			std::vector<std::thread> threads;
+			for (int t = 0; t < threadCount; ++t) {
+				threads.emplace_back([&cache]() {
+					for (int i = 0; i < addsPerThread; ++i) {
+						cache.add(glm::vec3(i % cells + 0.5f, 0.f, 0.f), glm::vec3(1.f, 0.f, 0.f), glm::vec3(1.f, 0.f, 2.f));
+					}
+				});
+			}
+			for (std::thread& thread : threads) {
+				thread.join();
+			}
+
+			for (int i = 0; i < cells; ++i) {
+				glm::vec3 radiance;
+				Assert::IsTrue(cache.lookup(glm::vec3(i + 0.5f, 0.f, 0.f), glm::vec3(1.f, 0.f, 0.f), radiance));
+				Assert::AreEqual(glm::vec3(1.f, 0.f, 2.f), radiance);
+			}
+		}
+	};
+}
@@ -0,0 +1,121 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+
+#include "test_common.h"
+#include "../src/radiosity.h"
+#include "../src/hittable_list.h"
+#include "../src/quad.h"
+#include "../src/sphere.h"
+#include "../src/lambertian.h"
+#include "../src/metal.h"
+#include "../src/emissive.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTest
+{
+	TEST_CLASS(TestRadiosity)
+	{
+		// 0.1 x 0.1 light 10 units above the center of a 1 x 1 floor, whose side 0 faces down
+		static HittableList makeScene(const glm::vec3& emitted, float albedo) {
+			HittableList world;
+			world.add(std::make_shared<Quad>(glm::vec3(0.45f, 10.f, 0.45f), glm::vec3(0.1f, 0.f, 0.f), glm::vec3(0.f, 0.f, 0.1f), std::make_shared<DiffuseEmissive>(emitted)));
+			world.add(std::make_shared<Quad>(glm::vec3(0.f), glm::vec3(1.f, 0.f, 0.f), glm::vec3(0.f, 0.f, 1.f), std::make_shared<Lambertian>(glm::vec3(albedo))));
+			return world;
+		}
+	public:
+		TEST_METHOD(TestValid)
+		{
+			HittableList quads = makeScene(glm::vec3(1.f), 0.5f);
+			Assert::IsTrue(RadiositySolver(quads, RadiositySolver::Settings(), 1).valid());
+
+			HittableList withSphere = makeScene(glm::vec3(1.f), 0.5f);
+			withSphere.add(std::make_shared<Sphere>(glm::vec3(0.f, 5.f, 0.f), 1.f, std::make_shared<Lambertian>(glm::vec3(0.5f))));
+			Assert::IsFalse(RadiositySolver(withSphere, RadiositySolver::Settings(), 1).valid());
+
+			HittableList withMetal = makeScene(glm::vec3(1.f), 0.5f);
+			withMetal.add(std::make_shared<Quad>(glm::vec3(0.f, 5.f, 0.f), glm::vec3(1.f, 0.f, 0.f), glm::vec3(0.f, 1.f, 0.f), std::make_shared<Metal>(glm::vec3(0.5f), 0.f)));
+			Assert::IsFalse(RadiositySolver(withMetal, RadiositySolver::Settings(), 1).valid());
+		}
+
+		TEST_METHOD(TestPatches)
+		{
+			HittableList world = makeScene(glm::vec3(1.f), 0.5f);
+			RadiositySolver::Settings settings;
+			settings.patchSize = 0.25f;
+			RadiositySolver solver(world, settings, 1);
+
+			// 1 patch for the light, 4 x 4 for the floor
+			Assert::AreEqual(17, solver.patchCount());
+			Assert::AreEqual(0, solver.patchAt(0, glm::vec2(0.5f)));
+			Assert::AreEqual(1, solver.patchAt(1, glm::vec2(0.1f, 0.1f)));
+			Assert::AreEqual(1 + 4 * 2 + 3, solver.patchAt(1, glm::vec2(0.9f, 0.6f)));
+			Assert::AreEqual(16, solver.patchAt(1, glm::vec2(1.f, 1.f)));
+
+			// before solving, only the light has radiance, on both sides
+			Assert::AreEqual(glm::vec3(1.f), solver.radiance(0, 0));
+			Assert::AreEqual(glm::vec3(1.f), solver.radiance(0, 1));
+			Assert::AreEqual(glm::vec3(0.f), solver.radiance(1, 1));
+			Assert::AreEqual(1.f, solver.unshotFraction());
+		}
+
+		TEST_METHOD(TestSolve)
+		{
+			const glm::vec3 emitted(100.f, 200.f, 300.f);
+			const float albedo = 0.5f;
+			HittableList world = makeScene(emitted, albedo);
+			RadiositySolver::Settings settings;
+			settings.patchSize = 2.f;
+			settings.formFactorSamples = 64;
+			RadiositySolver solver(world, settings, 1);
+			Assert::IsTrue(solver.solve() > 0);
+			Assert::IsTrue(solver.unshotFraction() <= settings.convergenceThreshold);
+
+			// the light is small and far away: irradiance = emitted * light area / distance^2
+			glm::vec3 expected = albedo / pi * emitted * 0.01f / 100.f;
+			assertFuzzyEqual(expected, solver.radiance(1, 1), 0.02f * expected.z);
+			Assert::AreEqual(glm::vec3(0.f), solver.radiance(1, 0));
+
+			// the solution is shown from the lit side only
+			std::shared_ptr<Hittable> scene = solver.scene();
+			Hittable::HitRecord hit;
+			Assert::IsTrue(scene->hit(Ray(glm::vec3(0.3f, 1.f, 0.6f), glm::vec3(0.f, -1.f, 0.f)), Interval(0.f, infinity), hit));
+			assertFuzzyEqual(solver.radiance(1, 1), hit.material->emitted(hit.uv, hit.point), 1e-4f * expected.z);
+			Assert::IsTrue(scene->hit(Ray(glm::vec3(0.3f, -1.f, 0.6f), glm::vec3(0.f, 1.f, 0.f)), Interval(0.f, infinity), hit));
+			Assert::AreEqual(glm::vec3(0.f), hit.material->emitted(hit.uv, hit.point));
+		}
+
+		TEST_METHOD(TestWriteRead)
+		{
+			HittableList world = makeScene(glm::vec3(100.f), 0.5f);
+			RadiositySolver::Settings settings;
+			settings.patchSize = 0.25f;
+			// on threads kept for the whole solve
+			RadiositySolver solver(world, settings, 3);
+			Assert::IsTrue(solver.solve() > 0);
+			const std::string file = "test_radiosity.bin";
+			Assert::IsTrue(solver.write(file));
+
+			// another run on the same scene starts from the solution, with nothing left to shoot
+			RadiositySolver read(world, settings, 1);
+			Assert::IsTrue(read.read(file));
+			for (int patch = 0; patch < solver.patchCount(); ++patch) {
+				Assert::AreEqual(solver.radiance(patch, 0), read.radiance(patch, 0));
+				Assert::AreEqual(solver.radiance(patch, 1), read.radiance(patch, 1));
+			}
+			Assert::AreEqual(solver.unshotFraction(), read.unshotFraction());
+			Assert::AreEqual(0, read.solve());
+
+			// solutions for other patches or materials are rejected
+			settings.patchSize = 0.5f;
+			RadiositySolver coarser(world, settings, 1);
+			Assert::IsFalse(coarser.read(file));
+			Assert::AreEqual(glm::vec3(0.f), coarser.radiance(1, 1));
+			settings.patchSize = 0.25f;
+			HittableList darker = makeScene(glm::vec3(100.f), 0.25f);
+			Assert::IsFalse(RadiositySolver(darker, settings, 1).read(file));
+			std::remove(file.c_str());
+			Assert::IsFalse(RadiositySolver(world, settings, 1).read(file));
+		}
+	};
+}
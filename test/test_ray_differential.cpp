@@ -0,0 +1,57 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+
+#include "test_common.h"
+#include "../src/camera.h"
+#include "../src/lambertian.h"
+#include "../src/quad.h"
+#include "../src/ray_differential.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTest
+{
+	TEST_CLASS(TestRayDifferential)
+	{
+	public:
+		TEST_METHOD(TestSurfaceDifferentials)
+		{
+			// a 2x2 quad one unit in front of a camera with a 90 degree field of view fills the 100 pixel wide image,
+			// so one pixel is 1/100 of the quad's uv range
+			const Camera camera(Camera::Frame(glm::vec3(0.f), glm::vec3(0.f, 0.f, -1.f)), Camera::Projection(glm::ivec2(100, 100), 90.f, 1.f));
+			const Quad quad(glm::vec3(-1.f, -1.f, -1.f), glm::vec3(2.f, 0.f, 0.f), glm::vec3(0.f, 2.f, 0.f), std::make_shared<Lambertian>(glm::vec3(1.f)));
+
+			StratifiedSampler sampler(1);
+			sampler.startPixelSample(glm::ivec2(30, 60), 0);
+			RayDifferential differential;
+			Ray ray = camera.getRay(30, 60, sampler, differential);
+			Assert::IsTrue(differential.valid);
+
+			Hittable::HitRecord hit;
+			Assert::IsTrue(quad.hit(ray, Interval(0.f, infinity), hit));
+			surfaceDifferentials(differential, hit);
+			// image y goes down, v goes up
+			assertFuzzyEqual(glm::vec2(0.01f, 0.f), hit.dUVdx, 1e-4f);
+			assertFuzzyEqual(glm::vec2(0.f, -0.01f), hit.dUVdy, 1e-4f);
+
+			// scaled to a quarter pixel
+			differential.scale(ray, 0.25f);
+			surfaceDifferentials(differential, hit);
+			assertFuzzyEqual(glm::vec2(0.0025f, 0.f), hit.dUVdx, 1e-4f);
+
+			// a mirror halfway along the ray's path leaves the footprint at the end of the path the same size
+			Hittable::HitRecord mirror;
+			mirror.point = ray.at(0.5f);
+			mirror.normal = glm::vec3(0.f, 0.f, 1.f);
+			Ray reflected(mirror.point, glm::reflect(ray.direction(), mirror.normal));
+			RayDifferential reflectedDifferential = reflectDifferential(differential, mirror, reflected);
+			Assert::IsTrue(reflectedDifferential.valid);
+			const glm::vec3 end = reflected.at(0.5f);
+			Hittable::HitRecord back;
+			back.point = end;
+			back.normal = glm::vec3(0.f, 0.f, -1.f);
+			const float straight = glm::length(tangentPlaneCrossing(differential.dx, hit) - hit.point);
+			Assert::AreEqual(straight, glm::length(tangentPlaneCrossing(reflectedDifferential.dx, back) - end), 1e-4f);
+		}
+	};
+}
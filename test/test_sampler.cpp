@@ -0,0 +1,160 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+
+#include <vector>
+
+#include "test_common.h"
+#include "../src/sampler.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTest
+{
+	TEST_CLASS(TestSampler)
+	{
+		// Checks that the samples of one pixel fall one per cell of a cellsX x cellsY grid, for a few pixels
+		static void testStratified2D(Sampler& sampler, int samples, int cellsX, int cellsY) {
+			for (int pixel = 0; pixel < 4; ++pixel) {
+				std::vector<int> counts(cellsX * cellsY, 0);
+				for (int s = 0; s < samples; ++s) {
+					sampler.startPixelSample(glm::ivec2(pixel, 7), s);
+					glm::vec2 u = sampler.getPixel2D();
+					Assert::IsTrue(u.x >= 0.f && u.x < 1.f && u.y >= 0.f && u.y < 1.f);
+					++counts[static_cast<int>(u.y * cellsY) * cellsX + static_cast<int>(u.x * cellsX)];
+				}
+				for (int count : counts) {
+					Assert::AreEqual(samples / (cellsX * cellsY), count);
+				}
+			}
+		}
+
+		static void testStratified1D(Sampler& sampler, int samples) {
+			for (int pixel = 0; pixel < 4; ++pixel) {
+				std::vector<int> counts(samples, 0);
+				for (int s = 0; s < samples; ++s) {
+					sampler.startPixelSample(glm::ivec2(3, pixel), s);
+					sampler.startBounce(2);
+					float u = sampler.getLobe1D();
+					Assert::IsTrue(u >= 0.f && u < 1.f);
+					++counts[static_cast<int>(u * samples)];
+				}
+				for (int count : counts) {
+					Assert::AreEqual(1, count);
+				}
+			}
+		}
+	public:
+		TEST_METHOD(TestIndependent)
+		{
+			IndependentSampler sampler;
+			for (int i = 0; i < 1000; ++i) {
+				glm::vec2 u = sampler.get2D();
+				Assert::IsTrue(u.x >= 0.f && u.x < 1.f && u.y >= 0.f && u.y < 1.f);
+			}
+		}
+
+		TEST_METHOD(TestStratified)
+		{
+			StratifiedSampler sampler(12);
+			testStratified2D(sampler, 12, 3, 4);
+			testStratified1D(sampler, 12);
+
+			StratifiedSampler squareSampler(16, 5);
+			testStratified2D(squareSampler, 16, 4, 4);
+		}
+
+		TEST_METHOD(TestSobol)
+		{
+			// every elementary interval of a 16 point (0, 4, 2)-net holds one point
+			SobolSampler sampler;
+			testStratified2D(sampler, 16, 4, 4);
+			testStratified2D(sampler, 16, 16, 1);
+			testStratified2D(sampler, 16, 1, 16);
+			testStratified2D(sampler, 16, 2, 8);
+			testStratified1D(sampler, 16);
+
+			// the next 16 samples form another net
+			for (int s = 16; s < 32; ++s) {
+				sampler.startPixelSample(glm::ivec2(0), s);
+				glm::vec2 u = sampler.getPixel2D();
+				Assert::IsTrue(u.x >= 0.f && u.x < 1.f && u.y >= 0.f && u.y < 1.f);
+			}
+		}
+
+		TEST_METHOD(TestDimensions)
+		{
+			SobolSampler sampler(3);
+			sampler.startPixelSample(glm::ivec2(5, 6), 2);
+			glm::vec2 pixel = sampler.getPixel2D();
+			float first = sampler.get1D();
+			sampler.startBounce(1);
+			glm::vec2 direction = sampler.getDirection2D();
+			float lobe = sampler.getLobe1D();
+			sampler.startBounce(0);
+			glm::vec2 direction0 = sampler.getDirection2D();
+
+			// same pixel and sample: same numbers, whatever else was drawn in between
+			sampler.startPixelSample(glm::ivec2(5, 6), 2);
+			Assert::AreEqual(first, sampler.get1D());
+			Assert::AreEqual(pixel, sampler.getPixel2D());
+			sampler.startBounce(1);
+			sampler.get2D();
+			Assert::AreEqual(lobe, sampler.getLobe1D());
+			Assert::AreEqual(direction, sampler.getDirection2D());
+
+			// bounces, pixels and seeds are decorrelated
+			Assert::AreNotEqual(direction, direction0);
+			sampler.startPixelSample(glm::ivec2(6, 5), 2);
+			Assert::AreNotEqual(pixel, sampler.getPixel2D());
+			SobolSampler other(4);
+			other.startPixelSample(glm::ivec2(5, 6), 2);
+			Assert::AreNotEqual(pixel, other.getPixel2D());
+
+			// other draws don't repeat the next bounce's dimensions
+			for (int s = 0; s < 8; ++s) {
+				sampler.startPixelSample(glm::ivec2(5, 6), s);
+				sampler.startBounce(0);
+				const float generic = sampler.get1D();
+				sampler.startBounce(1);
+				Assert::AreNotEqual(generic, sampler.getLobe1D());
+			}
+		}
+
+		TEST_METHOD(TestBlueNoise)
+		{
+			// one sample per pixel: neighboring pixels get dissimilar values
+			BlueNoiseSampler sampler(2);
+			float difference = 0.f;
+			const int size = 32;
+			for (int y = 0; y < size; ++y) {
+				for (int x = 0; x < size; ++x) {
+					sampler.startPixelSample(glm::ivec2(x, y), 0);
+					sampler.startBounce(0);
+					float u = sampler.getLobe1D();
+					Assert::IsTrue(u >= 0.f && u < 1.f);
+					sampler.startPixelSample(glm::ivec2(x + 1, y), 0);
+					sampler.startBounce(0);
+					difference += glm::abs(u - sampler.getLobe1D());
+				}
+			}
+			Assert::IsTrue(difference / (size * size) > 0.38f);
+
+			// deterministic, and the samples of one pixel are stratified
+			sampler.startPixelSample(glm::ivec2(4, 9), 3);
+			glm::vec2 pixel = sampler.getPixel2D();
+			sampler.startPixelSample(glm::ivec2(4, 9), 3);
+			Assert::AreEqual(pixel, sampler.getPixel2D());
+			testStratified1D(sampler, 16);
+
+			// past the blue-noise dimensions it is a Sobol sampler
+			BlueNoiseSampler few(2, 1);
+			SobolSampler sobol(2);
+			few.startPixelSample(glm::ivec2(4, 9), 3);
+			sobol.startPixelSample(glm::ivec2(4, 9), 3);
+			Assert::AreNotEqual(sobol.getPixel2D(), few.getPixel2D());
+			few.startBounce(1);
+			sobol.startBounce(1);
+			Assert::AreEqual(sobol.getDirection2D(), few.getDirection2D());
+		}
+	};
+}
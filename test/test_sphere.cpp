@@ -130,6 +130,28 @@ namespace UnitTest
 			}
 		}
 
+		TEST_METHOD(TestSphereDerivatives)
+		{
+			// against central differences of the point at uv, the inverse of getSphereUV()
+			const float radius = 2.f;
+			auto pointAt = [&](float u, float v) {
+				float phi = 2.f * pi * u - pi;
+				float theta = pi * v;
+				return radius * glm::vec3(glm::sin(theta) * glm::cos(phi), -glm::cos(theta), -glm::sin(theta) * glm::sin(phi));
+			};
+			const float h = 1e-3f;
+			for (float u : { 0.1f, 0.4f, 0.8f }) {
+				for (float v : { 0.2f, 0.5f, 0.9f }) {
+					glm::vec3 p = pointAt(u, v);
+					assertFuzzyEqual(glm::vec2(u, v), Sphere::getSphereUV(p / radius), 1e-4f);
+					glm::vec3 dpdu, dpdv;
+					Sphere::getSphereDerivatives(p / radius, radius, dpdu, dpdv);
+					assertFuzzyEqual((pointAt(u + h, v) - pointAt(u - h, v)) / (2.f * h), dpdu, 1e-2f);
+					assertFuzzyEqual((pointAt(u, v + h) - pointAt(u, v - h)) / (2.f * h), dpdv, 1e-2f);
+				}
+			}
+		}
+
 		TEST_METHOD(TestHit)
 		{
 			// unit sphere
@@ -257,5 +279,34 @@ namespace UnitTest
 				Interval::positive
 			);
 		}
+	
+		TEST_METHOD(TestSampleSurface)
+		{
+			const glm::vec3 center(1.f, 2.f, 3.f);
+			const float radius = 1.5f;
+			const Sphere sphere(center, radius, dummyMaterial);
+			const float tolerance = 1e-4f;
+
+			Assert::AreEqual(4.f * pi * radius * radius, sphere.area(), tolerance);
+
+			const glm::vec2 samples[5] = { glm::vec2(0.f), glm::vec2(1.f, 0.f), glm::vec2(0.5f, 0.f), glm::vec2(0.5f), glm::vec2(0.25f, 0.9f) };
+			for (const glm::vec2& u : samples) {
+				Hittable::HitRecord sample;
+				Assert::IsTrue(sphere.sampleSurface(u, sample));
+				Assert::AreEqual(radius, glm::length(sample.point - center), tolerance);
+				assertFuzzyEqual((sample.point - center) / radius, sample.normal, tolerance);
+				assertFuzzyEqual(Sphere::getSphereUV(sample.normal), sample.uv, tolerance);
+				assertSharedPtrEqual(dummyMaterial, sample.material);
+			}
+
+			// samples are spread evenly: u.x maps linearly to height
+			{
+				Hittable::HitRecord sample;
+				sphere.sampleSurface(glm::vec2(0.25f, 0.3f), sample);
+				Assert::AreEqual(0.5f, sample.normal.z, tolerance);
+				sphere.sampleSurface(glm::vec2(0.75f, 0.3f), sample);
+				Assert::AreEqual(-0.5f, sample.normal.z, tolerance);
+			}
+		}
 	};
 }
\ No newline at end of file
@@ -0,0 +1,77 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+
+#include <thread>
+#include <vector>
+
+#include "test_common.h"
+#include "../src/splat_image.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTest
+{
+	TEST_CLASS(TestSplatImage)
+	{
+	public:
+		TEST_METHOD(TestConstructor)
+		{
+			const int width = 9, height = 16;
+			SplatImage image(width, height);
+			Assert::AreEqual(width, image.width());
+			Assert::AreEqual(height, image.height());
+			for (int x = 0; x < width; ++x) {
+				for (int y = 0; y < height; ++y) {
+					Assert::AreEqual(glm::vec3(0.f), image.get(x, y));
+				}
+			}
+		}
+
+		TEST_METHOD(TestAdd)
+		{
+			SplatImage image(4, 3);
+			image.add(3, 2, glm::vec3(1.f, 2.f, 3.f));
+			image.add(3, 2, glm::vec3(0.5f, 0.f, -1.f));
+			image.add(0, 1, glm::vec3(0.25f));
+
+			Assert::AreEqual(glm::vec3(1.5f, 2.f, 2.f), image.get(3, 2));
+			Assert::AreEqual(glm::vec3(0.25f), image.get(0, 1));
+			Assert::AreEqual(glm::vec3(0.f), image.get(1, 1));
+			Assert::AreEqual(glm::vec3(0.f), image.get(3, 1));
+		}
+
+		TEST_METHOD(TestConcurrentAdd)
+		{
+			SplatImage image(2, 2);
+			const int threadCount = 8, addsPerThread = 10000;
+
+			std::vector<std::thread> threads;
+			for (int t = 0; t < threadCount; ++t) {
+				threads.emplace_back([&image]() {
+					for (int i = 0; i < addsPerThread; ++i) {
+						image.add(1, 0, glm::vec3(1.f, 0.f, 2.f));
+					}
+				});
+			}
+			for (std::thread& thread : threads) {
+				thread.join();
+			}
+
+			Assert::AreEqual(glm::vec3(threadCount * addsPerThread, 0.f, 2.f * threadCount * addsPerThread), image.get(1, 0));
+		}
+
+		TEST_METHOD(TestAddTo)
+		{
+			SplatImage splats(3, 2);
+			splats.add(1, 1, glm::vec3(4.f, 2.f, 0.f));
+
+			Image image(3, 2);
+			image.set(1, 1, glm::vec3(1.f));
+			image.set(0, 0, glm::vec3(0.5f));
+			splats.addTo(image, 0.25f);
+
+			Assert::AreEqual(glm::vec3(2.f, 1.5f, 1.f), image.get(1, 1));
+			Assert::AreEqual(glm::vec3(0.5f), image.get(0, 0));
+		}
+	};
+}
@@ -0,0 +1,75 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+
+#include "test_common.h"
+#include "../src/texture.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTest
+{
+	TEST_CLASS(TestTextureProgram)
+	{
+		static std::shared_ptr<Texture> solid(const glm::vec3& color) {
+			return std::make_shared<SolidColorTexture>(color);
+		}
+	public:
+		TEST_METHOD(TestFolding)
+		{
+			const glm::vec3 red(1.f, 0.f, 0.f), blue(0.f, 0.f, 1.f);
+			TextureProgram color(*solid(red));
+			Assert::AreEqual(size_t(1), color.ops().size());
+			Assert::AreEqual(red, color.value(glm::vec2(0.f), glm::vec3(0.f)));
+
+			// a checker of one color is that color
+			TextureProgram same(CheckerTexture(1.f, solid(red), solid(red)));
+			Assert::AreEqual(size_t(1), same.ops().size());
+			Assert::IsTrue(same.ops()[0].kind == TextureProgram::Op::Kind::Constant);
+
+			// the inner checkers have the outer one's scale, so they take the same branch and fold away
+			std::shared_ptr<Texture> inner = std::make_shared<CheckerTexture>(2.f, solid(red), solid(blue));
+			TextureProgram nested(CheckerTexture(2.f, inner, inner));
+			Assert::AreEqual(size_t(3), nested.ops().size());
+			Assert::AreEqual(red, nested.value(glm::vec2(0.f), glm::vec3(0.5f, 0.5f, 0.5f)));
+			Assert::AreEqual(blue, nested.value(glm::vec2(0.f), glm::vec3(2.5f, 0.5f, 0.5f)));
+			// and then the outer one may have the same color in both branches
+			std::shared_ptr<Texture> swapped = std::make_shared<CheckerTexture>(2.f, solid(blue), solid(red));
+			Assert::AreEqual(size_t(1), TextureProgram(CheckerTexture(2.f, inner, swapped)).ops().size());
+		}
+
+		TEST_METHOD(TestMatchesTextures)
+		{
+			// checkers of different scales don't fold, and evaluate as the textures do
+			std::shared_ptr<Texture> fine = std::make_shared<CheckerTexture>(0.5f, solid(glm::vec3(0.1f)), solid(glm::vec3(0.2f)));
+			std::shared_ptr<Texture> coarse = std::make_shared<CheckerTexture>(3.f, fine, solid(glm::vec3(0.9f)));
+			CheckerTexture texture(1.f, coarse, fine);
+			TextureProgram program(texture);
+			for (int i = 0; i < 100; ++i) {
+				const glm::vec3 p(0.37f * i - 10.f, 0.71f * i - 20.f, 0.13f * i);
+				Assert::AreEqual(texture.value(glm::vec2(0.f), p), program.value(glm::vec2(0.f), p));
+			}
+		}
+	};
+
+	TEST_CLASS(TestImageTexture)
+	{
+	public:
+		TEST_METHOD(TestLoadImageTextures)
+		{
+			// TODO: avoid using absolute path on my machine
+			const std::string path = "C:\\Users\\markf\\GitHub\\raytracer\\data\\test.png";
+			const std::string missing = "C:\\Users\\markf\\GitHub\\raytracer\\data\\test_nonexistent.png";
+			std::vector<std::shared_ptr<ImageTexture>> textures = loadImageTextures({ path, missing, path }, TextureFilter::Nearest, 4);
+			Assert::AreEqual(size_t(3), textures.size());
+			Assert::IsTrue(textures[0] == textures[2]);
+			Assert::AreEqual(ImageTexture::emptyColor, textures[1]->value(glm::vec2(0.5f), glm::vec3(0.f)));
+
+			// the same texels as a texture loaded on its own
+			ImageTexture single(path, TextureFilter::Nearest, 1);
+			for (int i = 0; i <= 10; ++i) {
+				const glm::vec2 uv(0.1f * i, 1.f - 0.1f * i);
+				Assert::AreEqual(single.value(uv, glm::vec3(0.f)), textures[0]->value(uv, glm::vec3(0.f)));
+			}
+		}
+	};
+}
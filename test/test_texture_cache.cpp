@@ -0,0 +1,43 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+
+#include "../src/texture_cache.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTest
+{
+	TEST_CLASS(TestTextureCache)
+	{
+	public:
+		TEST_METHOD(TestEviction)
+		{
+			// one shard holding three 100-byte pages
+			TextureCache cache(300, 1);
+			Assert::IsTrue(cache.find(1) == nullptr);
+			for (uint64_t key = 1; key <= 3; ++key) {
+				cache.insert(key, TextureCache::Page(100, static_cast<uint8_t>(key)));
+			}
+			Assert::AreEqual(size_t(300), cache.bytes());
+
+			// using page 1 makes page 2 the least recently used, and the one evicted for page 4
+			Assert::AreEqual(uint8_t(1), (*cache.find(1))[0]);
+			cache.insert(4, TextureCache::Page(100, 4));
+			Assert::AreEqual(size_t(300), cache.bytes());
+			Assert::IsTrue(cache.find(2) == nullptr);
+			Assert::IsTrue(cache.find(1) != nullptr);
+			Assert::IsTrue(cache.find(3) != nullptr);
+
+			// a page inserted twice keeps the first copy
+			cache.insert(4, TextureCache::Page(100, 9));
+			Assert::AreEqual(uint8_t(4), (*cache.find(4))[0]);
+
+			TextureCacheStats stats = cache.stats();
+			Assert::AreEqual(uint64_t(4), stats.hits);
+			Assert::AreEqual(uint64_t(2), stats.misses);
+			Assert::AreEqual(uint64_t(500), stats.bytesRead);
+			Assert::AreEqual(uint64_t(1), stats.evictions);
+			Assert::AreEqual(4.f / 6.f, stats.hitRate(), 1e-6f);
+		}
+	};
+}
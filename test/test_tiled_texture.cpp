@@ -0,0 +1,87 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+
+#include <cstdio>
+#include <vector>
+
+#include "test_common.h"
+#include "../src/tiled_texture.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTest
+{
+	TEST_CLASS(TestTiledTexture)
+	{
+		// a different color for every texel
+		static CompactImage gradient(int width, int height) {
+			std::vector<uint8_t> rgb(width * height * 3);
+			for (int y = 0; y < height; ++y) {
+				for (int x = 0; x < width; ++x) {
+					rgb[(y * width + x) * 3] = static_cast<uint8_t>(x * 7);
+					rgb[(y * width + x) * 3 + 1] = static_cast<uint8_t>(y * 5);
+					rgb[(y * width + x) * 3 + 2] = static_cast<uint8_t>(x * y);
+				}
+			}
+			return CompactImage(width, height, rgb.data());
+		}
+	public:
+		TEST_METHOD(TestLookup)
+		{
+			MipMap mipmap(gradient(37, 21), 1);
+			const std::string file = "test_tiled_texture.rttx";
+			Assert::IsTrue(writeTiledTexture(mipmap, file, 8));
+
+			std::shared_ptr<TextureCache> cache = std::make_shared<TextureCache>(1 << 20);
+			TiledMipMap tiled(cache, file);
+			Assert::AreEqual(mipmap.levels(), tiled.levels());
+			for (int i = 0; i < tiled.levels(); ++i) {
+				Assert::AreEqual(mipmap.levelSize(i), tiled.levelSize(i));
+			}
+
+			// lookups match those in memory, as both hold the same texels
+			const glm::vec2 points[] = { glm::vec2(0.f), glm::vec2(0.3f, 0.7f), glm::vec2(0.99f, 0.5f), glm::vec2(1.f) };
+			for (const glm::vec2& st : points) {
+				for (TextureFilter filter : { TextureFilter::Nearest, TextureFilter::Trilinear, TextureFilter::EWA }) {
+					const glm::vec2 dstdx(0.05f, 0.01f), dstdy(-0.01f, 0.02f);
+					assertFuzzyEqual(mipmap.lookup(filter, st, dstdx, dstdy), tiled.lookup(filter, st, dstdx, dstdy), 1e-5f);
+				}
+			}
+			// with room for every page, none is read twice
+			uint64_t pages = 0;
+			for (int i = 0; i < tiled.levels(); ++i) {
+				pages += (tiled.levelSize(i).x + 7) / 8 * ((tiled.levelSize(i).y + 7) / 8);
+			}
+			TextureCacheStats stats = cache->stats();
+			Assert::AreEqual(uint64_t(0), stats.evictions);
+			Assert::IsTrue(stats.misses <= pages);
+			Assert::AreEqual(stats.misses * 8 * 8 * 3, stats.bytesRead);
+
+			TiledMipMap missing(cache, "no_such_file.rttx");
+			Assert::AreEqual(0, missing.levels());
+			std::remove(file.c_str());
+		}
+
+		TEST_METHOD(TestBudget)
+		{
+			MipMap mipmap(gradient(64, 64), 1);
+			const std::string file = "test_tiled_texture_budget.rttx";
+			Assert::IsTrue(writeTiledTexture(mipmap, file, 8));
+
+			// room for four of the 64 pages of the first level
+			std::shared_ptr<TextureCache> cache = std::make_shared<TextureCache>(4 * 8 * 8 * 3, 1);
+			{
+				TiledMipMap tiled(cache, file);
+				for (int y = 0; y < 64; ++y) {
+					for (int x = 0; x < 64; ++x) {
+						const glm::vec2 st((x + 0.5f) / 64.f, (y + 0.5f) / 64.f);
+						assertFuzzyEqual(mipmap.level(0).get(x, y), tiled.nearest(st), 1e-6f);
+					}
+				}
+			}
+			Assert::IsTrue(cache->bytes() <= cache->budget());
+			Assert::IsTrue(cache->stats().evictions > 0);
+			std::remove(file.c_str());
+		}
+	};
+}
@@ -0,0 +1,148 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+
+#include <vector>
+
+#include "test_common.h"
+#include "../src/tiles.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTest
+{
+	TEST_CLASS(TestTiles)
+	{
+		// Checks that tiles cover area once and nothing outside it
+		static void testCover(const std::vector<PixelRect>& tiles, const PixelRect& area, const glm::ivec2& imageSize) {
+			std::vector<int> covered(imageSize.x * imageSize.y, 0);
+			for (const PixelRect& tile : tiles) {
+				for (int y = tile.min.y; y < tile.max.y; ++y) {
+					for (int x = tile.min.x; x < tile.max.x; ++x) {
+						++covered[y * imageSize.x + x];
+					}
+				}
+			}
+			for (int y = 0; y < imageSize.y; ++y) {
+				for (int x = 0; x < imageSize.x; ++x) {
+					Assert::AreEqual(area.contains(x, y) ? 1 : 0, covered[y * imageSize.x + x]);
+				}
+			}
+		}
+	public:
+		TEST_METHOD(TestPixelRect)
+		{
+			PixelRect rect(glm::ivec2(1, 2), glm::ivec2(4, 6));
+			Assert::AreEqual(12, rect.area());
+			Assert::IsTrue(rect.contains(1, 2));
+			Assert::IsFalse(rect.contains(4, 2));
+			Assert::IsTrue(PixelRect().empty());
+
+			PixelRect overlap = rect.intersect(PixelRect(glm::ivec2(3, 0), glm::ivec2(10, 3)));
+			Assert::AreEqual(glm::ivec2(3, 2), overlap.min);
+			Assert::AreEqual(glm::ivec2(4, 3), overlap.max);
+			Assert::IsTrue(rect.intersect(PixelRect(glm::ivec2(5, 5), glm::ivec2(6, 6))).empty());
+		}
+
+		TEST_METHOD(TestMakeTiles)
+		{
+			PixelRect crop(glm::ivec2(3, 5), glm::ivec2(40, 21));
+			std::vector<PixelRect> tiles = makeTiles(crop, 16);
+			Assert::AreEqual(3, static_cast<int>(tiles.size()));
+			Assert::AreEqual(glm::ivec2(3, 5), tiles[0].min);
+			Assert::AreEqual(glm::ivec2(19, 21), tiles[0].max);
+			testCover(tiles, crop, glm::ivec2(48, 32));
+
+			Assert::IsTrue(makeTiles(PixelRect(), 16).empty());
+		}
+
+		TEST_METHOD(TestHilbert)
+		{
+			// every cell once, and consecutive cells are neighbors
+			const uint32_t size = 8;
+			std::vector<glm::ivec2> cells(size * size, glm::ivec2(-1));
+			for (uint32_t y = 0; y < size; ++y) {
+				for (uint32_t x = 0; x < size; ++x) {
+					uint32_t index = hilbertIndex(x, y, size);
+					Assert::IsTrue(index < size * size);
+					Assert::AreEqual(glm::ivec2(-1), cells[index]);
+					cells[index] = glm::ivec2(x, y);
+				}
+			}
+			for (uint32_t i = 1; i < size * size; ++i) {
+				glm::ivec2 step = glm::abs(cells[i] - cells[i - 1]);
+				Assert::AreEqual(1, step.x + step.y);
+			}
+		}
+
+		TEST_METHOD(TestOrder)
+		{
+			const PixelRect area(glm::ivec2(0), glm::ivec2(80, 48));
+			const int tileSize = 16;
+			const std::vector<PixelRect> scanline = makeTiles(area, tileSize);
+
+			// spiral: starts at the center tile, and distances from the center never shrink by a whole ring
+			std::vector<PixelRect> spiral = scanline;
+			orderTiles(spiral, area, tileSize, TileOrder::Spiral);
+			testCover(spiral, area, area.max);
+			Assert::IsTrue(spiral[0].contains(40, 24));
+			int lastRing = 0;
+			for (const PixelRect& tile : spiral) {
+				glm::ivec2 offset = glm::abs(tile.min / tileSize - glm::ivec2(2, 1));
+				int ring = glm::max(offset.x, offset.y);
+				Assert::IsTrue(ring >= lastRing - 1 && ring <= lastRing + 1);
+				lastRing = glm::max(lastRing, ring);
+			}
+
+			// importance: the tile with the bright spot first, ties in scanline order
+			std::vector<PixelRect> important = scanline;
+			orderTiles(important, area, tileSize, TileOrder::Importance, [](int x, int y) { return x >= 64 && y >= 32 ? 1.f : 0.f; });
+			testCover(important, area, area.max);
+			Assert::AreEqual(glm::ivec2(64, 32), important[0].min);
+			Assert::AreEqual(glm::ivec2(0, 0), important[1].min);
+
+			// Hilbert: consecutive tiles are neighbors
+			std::vector<PixelRect> hilbert = makeTiles(PixelRect(glm::ivec2(0), glm::ivec2(64, 64)), tileSize);
+			orderTiles(hilbert, PixelRect(glm::ivec2(0), glm::ivec2(64, 64)), tileSize, TileOrder::Hilbert);
+			for (size_t i = 1; i < hilbert.size(); ++i) {
+				glm::ivec2 step = glm::abs(hilbert[i].min - hilbert[i - 1].min) / tileSize;
+				Assert::AreEqual(1, step.x + step.y);
+			}
+		}
+
+		TEST_METHOD(TestPixelOrder)
+		{
+			// every order visits each pixel of a tile once, also for sizes that are not a power of two
+			const int tileSize = 12;
+			for (PixelOrder order : { PixelOrder::RowMajor, PixelOrder::Morton, PixelOrder::Hilbert }) {
+				std::vector<glm::ivec2> offsets = tilePixelOrder(tileSize, order);
+				Assert::AreEqual(tileSize * tileSize, static_cast<int>(offsets.size()));
+				std::vector<int> visits(tileSize * tileSize, 0);
+				for (const glm::ivec2& offset : offsets) {
+					++visits[offset.y * tileSize + offset.x];
+				}
+				for (int v : visits) {
+					Assert::AreEqual(1, v);
+				}
+			}
+
+			// Hilbert offsets of a power-of-two tile are neighbors; Morton goes by quadrant
+			std::vector<glm::ivec2> hilbert = tilePixelOrder(16, PixelOrder::Hilbert);
+			for (size_t i = 1; i < hilbert.size(); ++i) {
+				glm::ivec2 step = glm::abs(hilbert[i] - hilbert[i - 1]);
+				Assert::AreEqual(1, step.x + step.y);
+			}
+			std::vector<glm::ivec2> morton = tilePixelOrder(16, PixelOrder::Morton);
+			Assert::AreEqual(glm::ivec2(1, 1), morton[3]);
+			Assert::AreEqual(glm::ivec2(7, 7), morton[63]);
+			Assert::AreEqual(5u, mortonIndex(3, 0));
+
+			// an edge tile only gets the pixels inside it
+			int count = 0;
+			forEachPixel(PixelRect(glm::ivec2(32, 16), glm::ivec2(37, 19)), morton, [&](int x, int y) {
+				Assert::IsTrue(x >= 32 && x < 37 && y >= 16 && y < 19);
+				++count;
+			});
+			Assert::AreEqual(15, count);
+		}
+	};
+}
@@ -0,0 +1,152 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+
+#include "test_common.h"
+#include "../src/warp.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTest
+{
+	TEST_CLASS(TestWarp)
+	{
+		static const int gridSize = 64;
+
+		// Cell centers of a gridSize x gridSize grid over the unit square
+		static glm::vec2 gridPoint(int i) {
+			return (glm::vec2(static_cast<float>(i % gridSize), static_cast<float>(i / gridSize)) + 0.5f) / static_cast<float>(gridSize);
+		}
+
+		static WarpBatch2 gridBatch(int first) {
+			WarpBatch2 batch;
+			for (int i = 0; i < warpBatchSize; ++i) {
+				glm::vec2 u = gridPoint(first + i);
+				batch.x[i] = u.x;
+				batch.y[i] = u.y;
+			}
+			return batch;
+		}
+	public:
+		TEST_METHOD(TestOrthonormalBasis)
+		{
+			glm::vec3 normals[] = { glm::vec3(0.f, 0.f, 1.f), glm::vec3(0.f, 0.f, -1.f), glm::normalize(glm::vec3(1.f, -2.f, 3.f)), glm::normalize(glm::vec3(-1.f, 0.f, -0.1f)) };
+			for (const glm::vec3& normal : normals) {
+				glm::vec3 tangent, bitangent;
+				orthonormalBasis(normal, tangent, bitangent);
+				Assert::AreEqual(1.f, glm::length(tangent), 1e-5f);
+				Assert::AreEqual(1.f, glm::length(bitangent), 1e-5f);
+				Assert::AreEqual(0.f, glm::dot(tangent, normal), 1e-5f);
+				Assert::AreEqual(0.f, glm::dot(bitangent, normal), 1e-5f);
+				Assert::AreEqual(0.f, glm::dot(tangent, bitangent), 1e-5f);
+				assertFuzzyEqual(normal, fromLocal(glm::vec3(0.f, 0.f, 1.f), normal), 1e-6f);
+			}
+		}
+
+		TEST_METHOD(TestSphereAndHemisphere)
+		{
+			// uniform: zero mean; cosine-weighted: E[cos] = 2 / 3
+			const int count = gridSize * gridSize;
+			glm::vec3 sphereSum(0.f), hemisphereSum(0.f);
+			for (int i = 0; i < count; ++i) {
+				glm::vec3 onSphere = uniformSphere(gridPoint(i));
+				Assert::AreEqual(1.f, glm::length(onSphere), 1e-5f);
+				sphereSum += onSphere;
+
+				glm::vec3 onHemisphere = cosineHemisphere(gridPoint(i));
+				Assert::AreEqual(1.f, glm::length(onHemisphere), 1e-5f);
+				Assert::IsTrue(onHemisphere.z >= 0.f);
+				hemisphereSum += onHemisphere;
+			}
+			assertFuzzyEqual(glm::vec3(0.f), sphereSum / static_cast<float>(count), 1e-3f);
+			assertFuzzyEqual(glm::vec3(0.f, 0.f, 2.f / 3.f), hemisphereSum / static_cast<float>(count), 2e-3f);
+			Assert::AreEqual(1.f / (4.f * pi), uniformSpherePdf());
+			Assert::AreEqual(0.5f / pi, cosineHemispherePdf(0.5f), 1e-6f);
+		}
+
+		TEST_METHOD(TestDiskAndTriangle)
+		{
+			// disk: E[r^2] = 1 / 2; triangle: mean barycentric weights are 1 / 3
+			const int count = gridSize * gridSize;
+			float radiusSquaredSum = 0.f;
+			glm::vec2 weightSum(0.f);
+			for (int i = 0; i < count; ++i) {
+				glm::vec2 onDisk = uniformDisk(gridPoint(i));
+				Assert::IsTrue(glm::dot(onDisk, onDisk) <= 1.f + 1e-6f);
+				radiusSquaredSum += glm::dot(onDisk, onDisk);
+
+				glm::vec2 weights = uniformTriangle(gridPoint(i));
+				Assert::IsTrue(weights.x >= 0.f && weights.y >= 0.f && weights.x + weights.y <= 1.f);
+				weightSum += weights;
+			}
+			Assert::AreEqual(0.5f, radiusSquaredSum / count, 1e-3f);
+			assertFuzzyEqual(glm::vec2(1.f / 3.f), weightSum / static_cast<float>(count), 1e-3f);
+			assertFuzzyEqual(glm::vec2(0.f), uniformDisk(glm::vec2(0.5f)), 0.f);
+		}
+
+		TEST_METHOD(TestCone)
+		{
+			// E[cos] is halfway between cosThetaMax and 1
+			const float cosThetaMax = 0.8f;
+			const int count = gridSize * gridSize;
+			float cosSum = 0.f;
+			for (int i = 0; i < count; ++i) {
+				glm::vec3 direction = uniformCone(gridPoint(i), cosThetaMax);
+				Assert::AreEqual(1.f, glm::length(direction), 1e-5f);
+				Assert::IsTrue(direction.z >= cosThetaMax - 1e-6f);
+				cosSum += direction.z;
+			}
+			Assert::AreEqual(0.9f, cosSum / count, 1e-4f);
+			Assert::AreEqual(1.f / (2.f * pi * 0.2f), uniformConePdf(cosThetaMax), 1e-4f);
+		}
+
+		TEST_METHOD(TestGGX)
+		{
+			// the pdf integrates to one: estimate with uniformly distributed directions...
+			const float alpha = 0.5f;
+			const int count = gridSize * gridSize;
+			float integral = 0.f;
+			for (int i = 0; i < count; ++i) {
+				glm::vec3 direction = uniformSphere(gridPoint(i));
+				integral += ggxPdf(direction.z, alpha) / uniformSpherePdf();
+			}
+			Assert::AreEqual(1.f, integral / count, 0.02f);
+
+			// ...and samples follow it: the fraction within 30 degrees of z matches the integral of the pdf over that cone
+			const float cosCone = glm::cos(glm::radians(30.f));
+			float inCone = 0.f, coneIntegral = 0.f;
+			for (int i = 0; i < count; ++i) {
+				glm::vec3 h = ggxNormal(gridPoint(i), alpha);
+				Assert::AreEqual(1.f, glm::length(h), 1e-5f);
+				if (h.z >= cosCone) inCone += 1.f;
+				glm::vec3 direction = uniformCone(gridPoint(i), cosCone);
+				coneIntegral += ggxPdf(direction.z, alpha) / uniformConePdf(cosCone);
+			}
+			Assert::AreEqual(coneIntegral / count, inCone / count, 0.01f);
+		}
+
+		TEST_METHOD(TestBatch)
+		{
+			// batches match the scalar warps
+			for (int first = 0; first < gridSize * gridSize; first += warpBatchSize) {
+				WarpBatch2 u = gridBatch(first);
+				WarpBatch3 sphere, hemisphere, cone, ggx;
+				WarpBatch2 disk, triangle;
+				uniformSphere(u, sphere);
+				cosineHemisphere(u, hemisphere);
+				uniformCone(u, 0.3f, cone);
+				ggxNormal(u, 0.2f, ggx);
+				uniformDisk(u, disk);
+				uniformTriangle(u, triangle);
+				for (int i = 0; i < warpBatchSize; ++i) {
+					glm::vec2 point = gridPoint(first + i);
+					assertFuzzyEqual(uniformSphere(point), glm::vec3(sphere.x[i], sphere.y[i], sphere.z[i]), 1e-5f);
+					assertFuzzyEqual(cosineHemisphere(point), glm::vec3(hemisphere.x[i], hemisphere.y[i], hemisphere.z[i]), 1e-4f);
+					assertFuzzyEqual(uniformCone(point, 0.3f), glm::vec3(cone.x[i], cone.y[i], cone.z[i]), 1e-5f);
+					assertFuzzyEqual(ggxNormal(point, 0.2f), glm::vec3(ggx.x[i], ggx.y[i], ggx.z[i]), 1e-5f);
+					assertFuzzyEqual(uniformDisk(point), glm::vec2(disk.x[i], disk.y[i]), 1e-5f);
+					assertFuzzyEqual(uniformTriangle(point), glm::vec2(triangle.x[i], triangle.y[i]), 0.f);
+				}
+			}
+		}
+	};
+}